@@ -0,0 +1,273 @@
+/* Asset packer
+ *
+ * Deployment step for OpenGLSample: writes the textures, scenes and other files the program reads
+ * into one pack, so a deployment is a single file and a cold start reads it in one sequential sweep.
+ *
+ * Usage: AssetPacker <output.pak> [--base <dir>] <file or dir>...
+ *
+ *   --base     files under this directory are stored relative to it (default: the working
+ *              directory); other files keep their path as given, e.g. the absolute texture paths
+ *              of the scene files, so the program finds them under the same name
+ *   dir        every file below it, in name order
+ *
+ * The pack is an ordinary zip archive (any zip tool can list or extract it) with two properties the
+ * program's VirtualFileSystem relies on for zero-copy reads: every entry is stored uncompressed, and
+ * every entry's data starts on a 64-byte boundary, padded through an extra field like zipalign does.
+ * Files are written in the order given, so list them in the order the program loads them.
+ */
+#include <iostream>         // cout, cerr
+#include <cstdlib>          // EXIT_FAILURE
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <set>
+#include <filesystem>
+#include <algorithm>        // sort
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace
+{
+    const size_t DATA_ALIGNMENT = 64;
+    const uint16_t PADDING_EXTRA_ID = 0xD935;   // the alignment extra field zipalign uses
+
+    struct PackEntry
+    {
+        string name;            // '/' separated, as the program asks for it
+        fs::path source;
+        uint32_t crc;
+        uint32_t size;
+        uint32_t localOffset;
+    };
+}
+
+void UCollect(const fs::path& path, const fs::path& base, vector<PackEntry>& entries, set<string>& names);
+string UEntryName(const fs::path& path, const fs::path& base);
+bool UReadFile(const fs::path& path, string& contents);
+uint32_t UCrc32(const string& data);
+void UPut16(string& out, uint16_t value);
+void UPut32(string& out, uint32_t value);
+
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        cerr << "usage: " << argv[0] << " <output.pak> [--base <dir>] <file or dir>..." << endl;
+        return EXIT_FAILURE;
+    }
+
+    fs::path output = argv[1];
+    fs::path base = fs::current_path();
+    vector<PackEntry> entries;
+    set<string> names;
+
+    for (int i = 2; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if (arg == "--base" && i + 1 < argc)
+            base = fs::absolute(argv[++i]);
+        else if (!fs::exists(arg))
+        {
+            cout << arg << "(1): error: file not found" << endl;
+            return EXIT_FAILURE;
+        }
+        else
+            UCollect(arg, base, entries, names);
+    }
+
+    // Local headers with their data, then the central directory and its end record
+    string pack;
+    for (PackEntry& entry : entries)
+    {
+        string data;
+        if (!UReadFile(entry.source, data) || data.size() > 0xFFFFFFFFu)
+        {
+            cout << entry.source.string() << "(1): error: cannot read the file (or it is 4 GB or larger)" << endl;
+            return EXIT_FAILURE;
+        }
+        entry.crc = UCrc32(data);
+        entry.size = (uint32_t)data.size();
+        entry.localOffset = (uint32_t)pack.size();
+
+        // Pad the extra field so the data starts aligned; the padding field needs at least its 4-byte header
+        const size_t headerSize = 30;
+        size_t dataStart = pack.size() + headerSize + entry.name.size() + 4;
+        size_t padding = (DATA_ALIGNMENT - dataStart % DATA_ALIGNMENT) % DATA_ALIGNMENT;
+
+        UPut32(pack, 0x04034b50);
+        UPut16(pack, 10);               // version needed: 1.0, stored
+        UPut16(pack, 0);                // flags
+        UPut16(pack, 0);                // method: stored
+        UPut16(pack, 0);                // time and date fixed, so packing the same files gives the same bytes
+        UPut16(pack, 0x0021);
+        UPut32(pack, entry.crc);
+        UPut32(pack, entry.size);
+        UPut32(pack, entry.size);
+        UPut16(pack, (uint16_t)entry.name.size());
+        UPut16(pack, (uint16_t)(4 + padding));
+        pack += entry.name;
+        UPut16(pack, PADDING_EXTRA_ID);
+        UPut16(pack, (uint16_t)padding);
+        pack.append(padding, '\0');
+        pack += data;
+    }
+
+    size_t directoryOffset = pack.size();
+    for (const PackEntry& entry : entries)
+    {
+        UPut32(pack, 0x02014b50);
+        UPut16(pack, 20);               // made by: 2.0
+        UPut16(pack, 10);
+        UPut16(pack, 0);
+        UPut16(pack, 0);
+        UPut16(pack, 0);
+        UPut16(pack, 0x0021);
+        UPut32(pack, entry.crc);
+        UPut32(pack, entry.size);
+        UPut32(pack, entry.size);
+        UPut16(pack, (uint16_t)entry.name.size());
+        UPut16(pack, 0);                // extra
+        UPut16(pack, 0);                // comment
+        UPut16(pack, 0);                // disk
+        UPut16(pack, 0);                // internal attributes
+        UPut32(pack, 0);                // external attributes
+        UPut32(pack, entry.localOffset);
+        pack += entry.name;
+    }
+    size_t directorySize = pack.size() - directoryOffset;
+
+    if (entries.size() > 0xFFFF || pack.size() > 0xFFFFFFFFu)
+    {
+        cout << output.string() << "(1): error: too many files or too large for a zip without ZIP64" << endl;
+        return EXIT_FAILURE;
+    }
+
+    UPut32(pack, 0x06054b50);
+    UPut16(pack, 0);
+    UPut16(pack, 0);
+    UPut16(pack, (uint16_t)entries.size());
+    UPut16(pack, (uint16_t)entries.size());
+    UPut32(pack, (uint32_t)directorySize);
+    UPut32(pack, (uint32_t)directoryOffset);
+    UPut16(pack, 0);
+
+    // Leave the pack untouched when nothing changed
+    string existing;
+    if (!(UReadFile(output, existing) && existing == pack))
+    {
+        ofstream out(output, ios::binary | ios::trunc);
+        if (!out)
+        {
+            cout << output.string() << "(1): error: cannot write the pack" << endl;
+            return EXIT_FAILURE;
+        }
+        out.write(pack.data(), pack.size());
+    }
+
+    cout << "AssetPacker: " << entries.size() << " file(s), " << pack.size() << " bytes" << endl;
+    return 0;
+}
+
+
+// Adds a file, or every file below a directory in name order. A name already packed is skipped
+void UCollect(const fs::path& path, const fs::path& base, vector<PackEntry>& entries, set<string>& names)
+{
+    if (fs::is_directory(path))
+    {
+        vector<fs::path> children;
+        for (const fs::directory_entry& child : fs::directory_iterator(path))
+            children.push_back(child.path());
+        sort(children.begin(), children.end());
+        for (const fs::path& child : children)
+            UCollect(child, base, entries, names);
+        return;
+    }
+
+    string name = UEntryName(path, base);
+    if (!names.insert(name).second)
+        return;
+
+    PackEntry entry = {};
+    entry.name = name;
+    entry.source = path;
+    entries.push_back(entry);
+}
+
+
+// The path relative to base when it lies below it, otherwise as given; '/' separated without
+// repeated separators, the form VirtualFileSystem::Normalize gives the program's paths
+string UEntryName(const fs::path& path, const fs::path& base)
+{
+    fs::path absolute = fs::absolute(path).lexically_normal();
+    fs::path relative = absolute.lexically_relative(base.lexically_normal());
+    string name = (!relative.empty() && *relative.begin() != "..") ? relative.generic_string() : path.generic_string();
+
+    string result;
+    for (char c : name)
+    {
+        if (c == '\\')
+            c = '/';
+        if (c == '/' && !result.empty() && result.back() == '/')
+            continue;
+        result += c;
+    }
+    if (result.compare(0, 2, "./") == 0)
+        result.erase(0, 2);
+    return result;
+}
+
+
+bool UReadFile(const fs::path& path, string& contents)
+{
+    ifstream in(path, ios::binary);
+    if (!in)
+        return false;
+
+    stringstream stream;
+    stream << in.rdbuf();
+    contents = stream.str();
+    return true;
+}
+
+
+// CRC-32 as zip defines it (reflected polynomial 0xEDB88320)
+uint32_t UCrc32(const string& data)
+{
+    static uint32_t table[256];
+    static bool initialized = false;
+    if (!initialized)
+    {
+        for (uint32_t i = 0; i < 256; ++i)
+        {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        initialized = true;
+    }
+
+    uint32_t crc = 0xFFFFFFFFu;
+    for (unsigned char c : data)
+        crc = table[(crc ^ c) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFu;
+}
+
+
+// zip fields are little-endian
+void UPut16(string& out, uint16_t value)
+{
+    out += (char)(value & 0xFF);
+    out += (char)(value >> 8);
+}
+
+
+void UPut32(string& out, uint32_t value)
+{
+    UPut16(out, (uint16_t)(value & 0xFFFF));
+    UPut16(out, (uint16_t)(value >> 16));
+}
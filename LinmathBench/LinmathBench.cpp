@@ -0,0 +1,314 @@
+/* linmath.h microbenchmark
+ *
+ * Times the SIMD and scalar versions of the linmath.h matrix and quaternion routines, and the
+ * glm equivalents when glm is on the include path, and checks that the SIMD results match the
+ * scalar ones.
+ *
+ * Usage: LinmathBench [iterations]
+ *
+ * The backend is whatever linmath.h picks for the compiler flags: SSE2 by default on x64,
+ * AVX2 with /arch:AVX2 (or -mavx2 -mfma), NEON on ARM64. Build with LINMATH_NO_SIMD defined
+ * to time the scalar code on both sides.
+ */
+#include <iostream>         // cout
+#include <iomanip>          // setw, setprecision
+#include <cstdlib>          // atoi, rand
+#include <cmath>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <cstring>        // memcpy
+
+#include "../OpenGLSample/linmath.h"
+
+#if defined(__has_include)
+#if __has_include(<glm/glm.hpp>)
+#define LINMATH_BENCH_GLM
+#endif
+#endif
+
+#ifdef LINMATH_BENCH_GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#endif
+
+using namespace std;
+
+namespace
+{
+    // Inputs cycle through a working set small enough for L1, so the timings measure arithmetic
+    const int WORKING_SET = 256;
+
+    struct Inputs
+    {
+        mat4x4 a[WORKING_SET];
+        mat4x4 b[WORKING_SET];
+        vec4 v[WORKING_SET];
+        quat p[WORKING_SET];
+        quat q[WORKING_SET];
+        vec3 eye[WORKING_SET];
+        vec3 center[WORKING_SET];
+    };
+
+    // Results are summed into this so the compiler cannot drop the timed loops
+    volatile float gSink = 0.0f;
+
+    float URandom()
+    {
+        return (rand() % 2000 - 1000) / 250.0f;
+    }
+}
+
+void UFillInputs(Inputs& in);
+template <typename F> double UTime(int iterations, F body);
+void UReport(const string& name, double scalarNs, double simdNs, double glmNs, float maxError);
+float URelativeError(const float* a, const float* b, int n);
+
+
+int main(int argc, char* argv[])
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 2000000;
+    if (iterations < WORKING_SET)
+        iterations = WORKING_SET;
+
+    static Inputs in;
+    UFillInputs(in);
+
+#if defined(LINMATH_AVX2)
+    const char* backend = "AVX2";
+#elif defined(LINMATH_SSE)
+    const char* backend = "SSE2";
+#elif defined(LINMATH_NEON)
+    const char* backend = "NEON";
+#else
+    const char* backend = "scalar";
+#endif
+    cout << "linmath.h backend: " << backend << ", " << iterations << " iterations per routine" << endl;
+#ifndef LINMATH_BENCH_GLM
+    cout << "glm not found on the include path, skipping the glm column" << endl;
+#endif
+    cout << endl;
+    cout << left << setw(20) << "routine" << right << setw(12) << "scalar ns" << setw(12) << "simd ns"
+        << setw(12) << "glm ns" << setw(10) << "speedup" << setw(14) << "max rel err" << endl;
+
+    mat4x4 out;
+    mat4x4 check;
+    vec4 outVec;
+    vec4 checkVec;
+    quat outQuat;
+    quat checkQuat;
+    float error;
+    double glmNs;
+
+    // mat4x4_mul
+    double scalarNs = UTime(iterations, [&](int i) { mat4x4_mul_scalar(out, in.a[i], in.b[i]); gSink = gSink + out[3][3]; });
+    double simdNs = UTime(iterations, [&](int i) { mat4x4_mul(out, in.a[i], in.b[i]); gSink = gSink + out[3][3]; });
+    error = 0.0f;
+    for (int i = 0; i < WORKING_SET; ++i)
+    {
+        mat4x4_mul(out, in.a[i], in.b[i]);
+        mat4x4_mul_scalar(check, in.a[i], in.b[i]);
+        error = fmaxf(error, URelativeError(out[0], check[0], 16));
+    }
+    glmNs = -1.0;
+#ifdef LINMATH_BENCH_GLM
+    {
+        vector<glm::mat4> ga(WORKING_SET), gb(WORKING_SET);
+        for (int i = 0; i < WORKING_SET; ++i)
+        {
+            memcpy(&ga[i], in.a[i], sizeof(mat4x4));
+            memcpy(&gb[i], in.b[i], sizeof(mat4x4));
+        }
+        glmNs = UTime(iterations, [&](int i) { glm::mat4 r = ga[i] * gb[i]; gSink = gSink + r[3][3]; });
+    }
+#endif
+    UReport("mat4x4_mul", scalarNs, simdNs, glmNs, error);
+
+    // mat4x4_mul_vec4
+    scalarNs = UTime(iterations, [&](int i) { mat4x4_mul_vec4_scalar(outVec, in.a[i], in.v[i]); gSink = gSink + outVec[3]; });
+    simdNs = UTime(iterations, [&](int i) { mat4x4_mul_vec4(outVec, in.a[i], in.v[i]); gSink = gSink + outVec[3]; });
+    error = 0.0f;
+    for (int i = 0; i < WORKING_SET; ++i)
+    {
+        mat4x4_mul_vec4(outVec, in.a[i], in.v[i]);
+        mat4x4_mul_vec4_scalar(checkVec, in.a[i], in.v[i]);
+        error = fmaxf(error, URelativeError(outVec, checkVec, 4));
+    }
+    glmNs = -1.0;
+#ifdef LINMATH_BENCH_GLM
+    {
+        vector<glm::mat4> ga(WORKING_SET);
+        vector<glm::vec4> gv(WORKING_SET);
+        for (int i = 0; i < WORKING_SET; ++i)
+        {
+            memcpy(&ga[i], in.a[i], sizeof(mat4x4));
+            memcpy(&gv[i], in.v[i], sizeof(vec4));
+        }
+        glmNs = UTime(iterations, [&](int i) { glm::vec4 r = ga[i] * gv[i]; gSink = gSink + r.w; });
+    }
+#endif
+    UReport("mat4x4_mul_vec4", scalarNs, simdNs, glmNs, error);
+
+    // mat4x4_invert
+    scalarNs = UTime(iterations, [&](int i) { mat4x4_invert_scalar(out, in.a[i]); gSink = gSink + out[3][3]; });
+    simdNs = UTime(iterations, [&](int i) { mat4x4_invert(out, in.a[i]); gSink = gSink + out[3][3]; });
+    error = 0.0f;
+    for (int i = 0; i < WORKING_SET; ++i)
+    {
+        mat4x4_invert(out, in.a[i]);
+        mat4x4_invert_scalar(check, in.a[i]);
+        error = fmaxf(error, URelativeError(out[0], check[0], 16));
+    }
+    glmNs = -1.0;
+#ifdef LINMATH_BENCH_GLM
+    {
+        vector<glm::mat4> ga(WORKING_SET);
+        for (int i = 0; i < WORKING_SET; ++i)
+            memcpy(&ga[i], in.a[i], sizeof(mat4x4));
+        glmNs = UTime(iterations, [&](int i) { glm::mat4 r = glm::inverse(ga[i]); gSink = gSink + r[3][3]; });
+    }
+#endif
+    UReport("mat4x4_invert", scalarNs, simdNs, glmNs, error);
+
+    // mat4x4_look_at
+    vec3 up = { 0.0f, 1.0f, 0.0f };
+    scalarNs = UTime(iterations, [&](int i) { mat4x4_look_at_scalar(out, in.eye[i], in.center[i], up); gSink = gSink + out[3][2]; });
+    simdNs = UTime(iterations, [&](int i) { mat4x4_look_at(out, in.eye[i], in.center[i], up); gSink = gSink + out[3][2]; });
+    error = 0.0f;
+    for (int i = 0; i < WORKING_SET; ++i)
+    {
+        mat4x4_look_at(out, in.eye[i], in.center[i], up);
+        mat4x4_look_at_scalar(check, in.eye[i], in.center[i], up);
+        error = fmaxf(error, URelativeError(out[0], check[0], 16));
+    }
+    glmNs = -1.0;
+#ifdef LINMATH_BENCH_GLM
+    {
+        vector<glm::vec3> ge(WORKING_SET), gc(WORKING_SET);
+        for (int i = 0; i < WORKING_SET; ++i)
+        {
+            ge[i] = glm::vec3(in.eye[i][0], in.eye[i][1], in.eye[i][2]);
+            gc[i] = glm::vec3(in.center[i][0], in.center[i][1], in.center[i][2]);
+        }
+        glmNs = UTime(iterations, [&](int i) { glm::mat4 r = glm::lookAt(ge[i], gc[i], glm::vec3(0.0f, 1.0f, 0.0f)); gSink = gSink + r[3][2]; });
+    }
+#endif
+    UReport("mat4x4_look_at", scalarNs, simdNs, glmNs, error);
+
+    // quat_mul
+    scalarNs = UTime(iterations, [&](int i) { quat_mul_scalar(outQuat, in.p[i], in.q[i]); gSink = gSink + outQuat[3]; });
+    simdNs = UTime(iterations, [&](int i) { quat_mul(outQuat, in.p[i], in.q[i]); gSink = gSink + outQuat[3]; });
+    error = 0.0f;
+    for (int i = 0; i < WORKING_SET; ++i)
+    {
+        quat_mul(outQuat, in.p[i], in.q[i]);
+        quat_mul_scalar(checkQuat, in.p[i], in.q[i]);
+        error = fmaxf(error, URelativeError(outQuat, checkQuat, 4));
+    }
+    glmNs = -1.0;
+#ifdef LINMATH_BENCH_GLM
+    {
+        // glm::quat is stored (x, y, z, w) like linmath's quat unless GLM_FORCE_QUAT_DATA_WXYZ is set
+        vector<glm::quat> gp(WORKING_SET), gq(WORKING_SET);
+        for (int i = 0; i < WORKING_SET; ++i)
+        {
+            gp[i] = glm::quat(in.p[i][3], in.p[i][0], in.p[i][1], in.p[i][2]);
+            gq[i] = glm::quat(in.q[i][3], in.q[i][0], in.q[i][1], in.q[i][2]);
+        }
+        glmNs = UTime(iterations, [&](int i) { glm::quat r = gp[i] * gq[i]; gSink = gSink + r.w; });
+    }
+#endif
+    UReport("quat_mul", scalarNs, simdNs, glmNs, error);
+
+    // batches: one view-projection times every model matrix, one matrix times every vertex
+    static mat4x4 batchOut[WORKING_SET];
+    static vec4 batchOutVec[WORKING_SET];
+    int batches = iterations / WORKING_SET;
+    scalarNs = UTime(batches, [&](int) { for (int i = 0; i < WORKING_SET; ++i) mat4x4_mul_scalar(batchOut[i], in.a[0], in.b[i]); gSink = gSink + batchOut[7][3][3]; }) / WORKING_SET;
+    simdNs = UTime(batches, [&](int) { mat4x4_mul_batch(batchOut, in.a[0], in.b, WORKING_SET); gSink = gSink + batchOut[7][3][3]; }) / WORKING_SET;
+    error = 0.0f;
+    for (int i = 0; i < WORKING_SET; ++i)
+    {
+        mat4x4_mul_scalar(check, in.a[0], in.b[i]);
+        error = fmaxf(error, URelativeError(batchOut[i][0], check[0], 16));
+    }
+    UReport("mat4x4_mul_batch", scalarNs, simdNs, -1.0, error);
+
+    scalarNs = UTime(batches, [&](int) { for (int i = 0; i < WORKING_SET; ++i) mat4x4_mul_vec4_scalar(batchOutVec[i], in.a[0], in.v[i]); gSink = gSink + batchOutVec[7][3]; }) / WORKING_SET;
+    simdNs = UTime(batches, [&](int) { mat4x4_mul_vec4_batch(batchOutVec, in.a[0], in.v, WORKING_SET); gSink = gSink + batchOutVec[7][3]; }) / WORKING_SET;
+    error = 0.0f;
+    for (int i = 0; i < WORKING_SET; ++i)
+    {
+        mat4x4_mul_vec4_scalar(checkVec, in.a[0], in.v[i]);
+        error = fmaxf(error, URelativeError(batchOutVec[i], checkVec, 4));
+    }
+    UReport("mat4x4_mul_vec4_batch", scalarNs, simdNs, -1.0, error);
+
+    return 0;
+}
+
+
+void UFillInputs(Inputs& in)
+{
+    srand(330);
+
+    for (int i = 0; i < WORKING_SET; ++i)
+    {
+        for (int c = 0; c < 4; ++c)
+        {
+            for (int r = 0; r < 4; ++r)
+            {
+                in.a[i][c][r] = URandom() + (c == r ? 5.0f : 0.0f); // diagonally dominant, so invertible
+                in.b[i][c][r] = URandom();
+            }
+            in.v[i][c] = URandom();
+            in.p[i][c] = URandom();
+            in.q[i][c] = URandom();
+        }
+        for (int k = 0; k < 3; ++k)
+        {
+            in.eye[i][k] = URandom();
+            in.center[i][k] = URandom() + 10.0f; // never equal to eye
+        }
+    }
+}
+
+
+// Average nanoseconds per call of body(i), with i cycling through the working set
+template <typename F>
+double UTime(int iterations, F body)
+{
+    // warm up caches and branch predictors
+    for (int i = 0; i < WORKING_SET; ++i)
+        body(i);
+
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+        body(i & (WORKING_SET - 1));
+    auto end = chrono::steady_clock::now();
+
+    return chrono::duration<double, nano>(end - start).count() / iterations;
+}
+
+
+void UReport(const string& name, double scalarNs, double simdNs, double glmNs, float maxError)
+{
+    cout << left << setw(20) << name << right << fixed << setprecision(2)
+        << setw(12) << scalarNs << setw(12) << simdNs;
+    if (glmNs >= 0.0)
+        cout << setw(12) << glmNs;
+    else
+        cout << setw(12) << "-";
+    cout << setw(9) << scalarNs / simdNs << "x" << setw(14) << scientific << setprecision(1) << maxError << defaultfloat << endl;
+}
+
+
+// Largest difference relative to the reference value's magnitude
+float URelativeError(const float* a, const float* b, int n)
+{
+    float error = 0.0f;
+    for (int i = 0; i < n; ++i)
+        error = fmaxf(error, fabsf(a[i] - b[i]) / (1.0f + fabsf(b[i])));
+    return error;
+}
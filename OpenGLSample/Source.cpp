@@ -1,5 +1,11 @@
 ﻿#include <iostream>         // cout, cerr
-#include <cstdlib>          // EXIT_FAILURE
+#include <cstdlib>          // EXIT_FAILURE, strtol
+#include <cstring>          // memcmp
+#include <thread>
+#include <atomic>
+#include <memory>           // shared_ptr
+#include <algorithm>        // sort
+#include <random>           // mt19937
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #define STB_IMAGE_IMPLEMENTATION
@@ -11,15 +17,29 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include "camera.h"
+#include "programCache.h"
+#include "programBatch.h"
+#include "shaderVariants.h"
+#include "vfs.h"
+#include "jobSystem.h"
+#include "sceneFormat.h"
+#include "entityStore.h"
+#include "sceneGraph.h"
+#include "transformPipeline.h"
+#include "inputSystem.h"
+#include "framePacer.h"
+#include "frameMailbox.h"
+#include "uploadThread.h"
+#include "geometryPool.h"
+#include "drawCuller.h"
+#include "renderPassStats.h"
+#include "gBuffer.h"
+#include "lightGrid.h"
+#include "simulation.h"
+#include "embeddedShaders.h"   // generated from shaders/ by the ShaderPreprocessor pre-build step
 
 using namespace std;
 
-/*Shader program Macro*/
-#ifndef GLSL
-#define GLSL(Version, Source) "#version " #Version " core \n" #Source
-#endif
-
-
 namespace
 {
     const char* const WINDOW_TITLE = "Window of Justice";
@@ -27,87 +47,112 @@ namespace
     const int WINDOW_HEIGHT = 800;
 
     // Stores the GL data relative to a given mesh
+    // A mesh is a vertex range and an index range in gGeometry's shared buffers
     struct GLMesh
     {
-        GLuint vao;         // Handle for the vertex array object
-        GLuint vbos[2];         // Handle for the vertex buffer object
+        bool resident;      // false until the upload has finished
+        GLuint layout;      // SceneFormat::VertexLayout, selects the vertex buffer and the vertex array
+        GLint baseVertex;   // first vertex in the layout's vertex buffer
+        GLuint firstIndex;  // first index in the index buffer
         GLuint nVertices;
-        GLuint nIndices;
+        GLuint nIndices;    // 0 for a non-indexed mesh
+        glm::vec3 boundsCenter;     // bounding sphere of the vertices
+        GLfloat boundsRadius;
     };
 
-    //Store coordinates for points
-    struct GLCoord {
-        GLfloat x;
-        GLfloat y;
-        GLfloat z;
-    };
-
-    #define PI 3.14159265359
-    // Main GLFW window
+    // Main GLFW window. Its GL context belongs to the render thread while the main loop runs
     GLFWwindow* gWindow = nullptr;
+    // Framebuffer size, updated by the resize callback and applied by the render thread
+    int gFramebufferWidth = WINDOW_WIDTH;
+    int gFramebufferHeight = WINDOW_HEIGHT;
     
-    ////////////////// Create basil mesh and assign all necessary values   //////////////////
-    GLMesh basilMesh;
-    GLuint basilTextureId;
     GLint gTexWrapMode = GL_REPEAT;
-    // Position and scale
-    glm::vec3 gBasilPosition(-3.0f, -0.2f, 0.0f);
-    glm::vec3 gBasilScale(2.0f);
-    glm::vec2 gUVScale(1.0f, 1.0f);
-    GLMesh basilLidMesh;
-    GLuint basilLidTextureId;
-    glm::vec3 gBasilLidPosition(-3.0f, 2.2f, 0.0f);
-    //////////////////
-    
-    // Create Pyramid mesh and assign all necessary values
-    GLMesh pyrMesh;
-    GLuint pyrTextureId;
-    // Pyramid position and scale
-    glm::vec3 gPyramidPosition(3.0f, -0.2f, 0.0f);
-    glm::vec3 gPyramidScale(2.0f);
-    glm::vec2 gPyramidUVScale(6.0f, 6.0f);
-
-    // Create Mug mesh and assign all necessary values
-    GLMesh mugMesh;
-    glm::vec3 gMugPosition(3.0f, -0.2f, 5.0f);
-    glm::vec3 gMugScale(2.0f);
-    glm::vec2 gMugUVScale(1.0f, 1.0f);
-
-
-    // Cayenne jar
-    GLMesh cayenneMesh;
-    GLuint cayenneTextureId;
-    glm::vec3 gCayennePosition(-3.0f, -0.2f, 3.0f);
-    glm::vec3 gCayenneScale(2.0f);
-    glm::vec2 gCayenneUVScale(1.0f, 1.0f);
-
-    // Hot pad
-    GLMesh padMesh;
-    GLuint padTextureId;
-    glm::vec3 gPadPosition(0.0f, -0.18f, 4.0f);
-    glm::vec3 gPadScale(2.0f);
-
-
-    GLMesh cayenneLidMesh;
-    GLuint cayenneLidTextureId;
-    glm::vec3 gCayenneLidPosition(-3.0f, 2.2f, 3.0f);
-
-    // Table
-    GLMesh tableMesh;
-    GLuint tableTextureId;
-    glm::vec3 gTablePosition(-3.0f, -0.2f, 3.0f);
-    glm::vec3 gTableScale(2.0f);
-    glm::vec2 gTableUVScale(6.0f, 6.0f);
-
-    // Shader programs
-    GLuint gCubeProgramId;
+
+    // Assets are read through the virtual file system: the pack is mounted when it exists,
+    // --mount <archive or directory> adds mounts that take precedence over it
+    const char* const DEFAULT_PACK = "assets.pak";
+    VirtualFileSystem gFileSystem(stbi_zlib_decode_noheader_buffer);
+    // The scene file loaded by default; --scene <file> loads another one
+    const char* const DEFAULT_SCENE = "scenes/kitchen.scene";
+    // Textures of the scene file, in its texture table order; 0 until the upload has finished
+    vector<GLuint> gTextures;
+
+    // Shader programs. The GLSL sources live in shaders/ and are embedded through embeddedShaders.h
     GLuint gLampProgramId;
+    GLuint gDepthProgramId = 0;
+    // Linked program binaries from previous runs
+    ProgramCache gProgramCache;
+    // Programs compiling in the background while the first frames render
+    ProgramBatch gProgramBatch(&gProgramCache);
+    double gShaderStartTime = -1.0;
+    // Cube shader permutations, compiled on first use
+    ShaderVariants gCubeShaders("cube", EmbeddedShaders::cube_vert, EmbeddedShaders::cube_frag, gProgramBatch);
+
+    // Per-frame camera and lights, laid out like the std140 FrameData block in shaders/include/frame_data.glsl
+    struct FrameData
+    {
+        glm::mat4 view;
+        glm::mat4 projection;
+        glm::vec4 viewPosition;
+        glm::vec4 lightPositions[ShaderVariants::MAX_LIGHTS];
+        glm::vec4 lightColors[ShaderVariants::MAX_LIGHTS];
+        glm::vec4 frustumPlanes[Camera::PLANE_COUNT];
+        glm::mat4 inverseViewProjection;
+        glm::vec4 clusterParameters;
+    };
+    // Per-draw instance and material, laid out like the std430 DrawData struct in shaders/include/draw_data.glsl
+    struct DrawData
+    {
+        glm::vec4 objectColor;
+        glm::vec2 uvScale;
+        GLfloat ambientStrength;
+        GLfloat specularIntensity;
+        GLfloat highlightSize;
+        GLint instance;
+        GLfloat padding[2];
+    };
+    // A point light with a range, laid out like the std430 PointLight struct in shaders/include/point_lights.glsl
+    struct PointLight
+    {
+        glm::vec4 positionRadius;
+        glm::vec4 color;
+    };
+    // FrameData, the instance matrices and the draw data of the frames in flight, written in place.
+    // Sized for the scene once it is loaded
+    RingBuffer gFrameRing;
+
+    // Creates buffers and textures in a second context while the render thread draws. Declared before
+    // gJobs, like the counter of the texture decodes: decode jobs still queued at exit upload through it
+    UploadThread gUploader;
+    JobSystem::Counter gTextureDecodes;
+    double gSceneStartTime = -1.0;
+
+    // Worker threads for the CPU-heavy work, one per core besides the main thread
+    JobSystem gJobs;
+
+    // Model, model-view-projection and normal matrices of every entity, one Instances entry each
+    TransformPipeline gTransforms;
+    // Parent/child placement of the entities; the lids hang off their jars
+    SceneGraph gSceneGraph;
 
     // camera
     Camera gCamera(glm::vec3(0.0f, 0.0f, 7.0f));
-    float gLastX = WINDOW_WIDTH / 2.0f;
-    float gLastY = WINDOW_HEIGHT / 2.0f;
-    bool gFirstMouse = true;
+
+    // Keyboard and mouse events gathered between frames
+    InputSystem gInput;
+    // Keeps the render thread at most two frames ahead of the GPU
+    FramePacer gFramePacer(2);
+    // Input-to-present latency reporting, toggled with F2 on the main thread
+    bool gMeasureLatency = false;
+    // Frustum culling in a compute pass instead of on the main thread, toggled with F3
+    bool gGpuCulling = true;
+    // Occlusion culling against the previous frame's depth in that pass, toggled with F4
+    bool gOcclusionCulling = true;
+    // Depth-only pass before the shading pass, toggled with F5
+    bool gDepthPrepass = false;
+    // How the point lights are shaded, cycled with F6: not at all (forward), with the G-buffer and light
+    // volumes (deferred), or in the shading pass through the light grid (clustered forward)
+    ShaderVariants::Path gLightingPath = ShaderVariants::PATH_FORWARD;
 
     // timing
     float gDeltaTime = 0.0f; // time between current frame and last frame
@@ -115,19 +160,182 @@ namespace
 
     
 
-    // Cube and lights color
-    glm::vec3 gObjectColor(1.0f, 0.7f, 0.7f);
-    glm::vec3 gLightColor(1.0f, 1.0f, 1.0f);
-    glm::vec3 gFillLightColor(1.0f, 0.0f, 1.0f);
+    // Surface parameters for the cube shader; textured and specular also select its variant
+    struct GLMaterial
+    {
+        bool textured;
+        bool specular;
+        glm::vec3 color;            // used instead of the texture by untextured variants
+        float ambientStrength;
+        float specularIntensity;
+        float highlightSize;
+    };
+
+    // Components of the scene's entities, each type densely packed in its own array
+    struct TransformComponent
+    {
+        int node;           // in gSceneGraph
+        int instance;       // in gTransforms, the Instances entry the shaders read
+    };
+    struct MeshRef
+    {
+        int mesh;           // in gMeshes
+    };
+    struct MaterialComponent
+    {
+        GLMaterial surface;
+        int texture;        // in gTextures, -1 for none
+        glm::vec2 uvScale;
+    };
+    struct Bounds
+    {
+        glm::vec3 center;   // bounding sphere in the entity's local space
+        float radius;
+    };
+    struct Light
+    {
+        glm::vec3 color;    // the position is the entity's world position
+    };
+
+    // Pixels of an image file, decoded and flipped on a worker thread, waiting for the GL upload
+    struct DecodedImage
+    {
+        unsigned char* pixels;
+        int width;
+        int height;
+        int channels;
+    };
 
-    // Lights position and scale
+    EntityStore gEntities;
+    ComponentArray<TransformComponent> gTransformComponents;
+    ComponentArray<MeshRef> gMeshRefs;
+    ComponentArray<MaterialComponent> gMaterials;
+    ComponentArray<Bounds> gBounds;
+    ComponentArray<Light> gLights;
+    vector<GLMesh> gMeshes;
+    // Vertex and index buffers all meshes are suballocated from, one vertex array per vertex layout
+    GeometryPool gGeometry;
+    // Entities with a mesh and a material whose bounds passed this frame's frustum test
+    vector<Entity> gVisibleEntities;
+
+    // The key lamp, the scene's first light, follows the simulated light position
+    Entity gKeyLamp;
     glm::vec3 gLightPosition(1.5f, 0.8f, 2.0f);
-    glm::vec3 gLightScale(0.4f);
-    glm::vec3 gFillLightPosition(8.5f, 0.5f, 1.0f);
-    glm::vec3 gFillLightScale(0.1f);
 
-    // Lamp animation
-    bool gIsLampOrbiting = true;
+    // Scene state advanced by the fixed-step simulation: the lamp orbit, the keyboard camera motion and
+    // the point lights' circling. Rendering interpolates between the previous and the current state
+    struct SimulationState
+    {
+        glm::vec3 lightPosition;
+        glm::vec3 cameraPosition;
+        bool isLampOrbiting;
+        float pointLightAngle;      // radians in [0, 2 pi), added to each point light's phase
+    };
+    FixedTimestep gSimulationClock(120.0);
+    SimulationState gPreviousState;
+    SimulationState gCurrentState;
+    // --record / --replay of the per-step input, for reproducible benchmark runs
+    InputRecording gInputRecording;
+    double gReplayStartTime = 0.0;
+    unsigned int gReplayFrames = 0;
+
+    // Light entities the cube shader loops over, in creation order: 1 = key light only, F toggles all
+    int gActiveLightCount = 1;
+
+    // Small point lights scattered over the scene at load, each circling its anchor. Only the deferred
+    // and clustered paths light with them; --lights sets how many
+    struct PointLightSource
+    {
+        glm::vec3 anchor;
+        float radius;
+        glm::vec3 color;
+        float phase;        // radians, where on its circle the light starts
+    };
+    vector<PointLightSource> gPointLights;
+    int gPointLightCount = 256;
+    // --lights limit: every ring region reserves room for all the lights, 2 MB at this count
+    const int MAX_POINT_LIGHTS = 65536;
+    float gPointLightAngle = 0.0f;      // interpolated from the simulation state
+    // Clustered path: the point lights of each cluster of the view frustum, built by the main thread,
+    // and its build time and load over the frames that used it
+    LightGrid gLightGrid;
+    double gLightGridTime = 0.0;
+    unsigned long long gLightGridBuilds = 0;
+    unsigned long long gLightGridLights = 0;
+    unsigned long long gLightGridIndices = 0;
+    unsigned long long gLightGridDropped = 0;
+
+    // One mesh to draw: the lamps use mesh and instance only
+    struct DrawItem
+    {
+        int mesh;
+        int instance;
+        MaterialComponent material;
+        uint64_t batchKey;  // draws with equal keys share a shader variant, a texture and a vertex layout
+    };
+
+    // Everything the render thread needs for a frame, built by the main thread. The main thread
+    // simulates, culls and computes the matrices of frame N+1 while the render thread submits frame N
+    struct FrameSnapshot
+    {
+        FrameData frameData;
+        GLintptr instanceOffset;        // in gFrameRing, where the main thread computed the matrices; -1 for none
+        int instanceCount;
+        int lightCount;                 // lights in frameData
+        vector<DrawItem> lamps;
+        vector<DrawItem> draws;         // the entities inside the view frustum
+        vector<DrawData> drawData;      // lamps first, then draws
+        vector<PointLight> pointLights; // the point lights that reach into the view frustum
+        vector<LightGrid::Cluster> clusters;    // clustered path: the range of clusterLightIndices of every cluster
+        vector<GLuint> clusterLightIndices;     // into pointLights
+        int viewportWidth;
+        int viewportHeight;
+        double inputTime;               // oldest input event the frame is based on, for the latency report
+        bool measureLatency;
+        bool gpuCulling;                // draws holds every drawable entity, the GPU culls them
+        bool occlusionCulling;          // the GPU also culls what the last frame's depth hides
+        bool depthPrepass;              // lay down the draws' depth before shading them
+        ShaderVariants::Path lightingPath;  // how the point lights are shaded
+    };
+    // The render thread hands back the start of the ring region each next frame is drawn from, reserved
+    // for its matrices
+    FrameMailbox<FrameSnapshot, RingBuffer::Allocation> gFrameMailbox;
+    // Set by the render thread when a shader program failed; the main loop then stops
+    atomic<bool> gRenderFailed(false);
+
+    // Render thread state: what the GL side last saw, to skip redundant updates
+    int gViewportWidth = 0;
+    int gViewportHeight = 0;
+    GLuint gBoundVertexArray = 0;
+    // Render thread: the frame's runs of draws that share a shader variant, a texture and a vertex layout
+    struct DrawBatch
+    {
+        size_t first;               // in FrameSnapshot::draws
+        size_t last;
+        GLuint programId;
+        GLuint textureId;
+        GLuint firstCommand;        // in the indirect buffer
+        GLsizei commandCount;
+        bool unindexed;             // has resident meshes without indices, drawn one by one
+    };
+    vector<DrawBatch> gDrawBatches;
+    // GPU culling pass and its compute program
+    DrawCuller gCuller;
+    GLuint gCullProgramId = 0;
+    // Depth pyramid of the last frame, for the occlusion test of the cull pass
+    HiZPyramid gHiZ;
+    GLuint gHiZProgramId = 0;
+    // GPU time and overdraw of the depth pre-pass and the shading pass
+    RenderPassStats gPassStats;
+    // Deferred path: the G-buffer, its lighting programs and the vertex array of the draws that read no vertex
+    GBuffer gGBuffer;
+    GLuint gResolveProgramId = 0;
+    GLuint gLightVolumeProgramId = 0;
+    GLuint gEmptyVertexArray = 0;
+    // Render thread: draw calls and objects submitted through UDrawObjects, for the submission report
+    unsigned long long gDrawCalls = 0;
+    unsigned long long gDrawnObjects = 0;
+    unsigned long long gDrawFrames = 0;
 }
 
 /* User-defined Function prototypes to:
@@ -140,129 +348,45 @@ void UResizeWindow(GLFWwindow* window, int width, int height);
 void UProcessInput(GLFWwindow* window);
 void UMousePositionCallback(GLFWwindow* window, double xpos, double ypos);
 void UMouseScrollCallback(GLFWwindow* window, double xoffset, double yoffset);
-void UCreatePlaneMesh(GLMesh& mesh, GLCoord bl, GLCoord br, GLCoord fl, GLCoord fr);
-void UCreatePyramidMesh(GLMesh& mesh, GLCoord top, GLfloat height, GLfloat width);
-void UCreateCubeMesh(GLMesh& mesh, GLCoord top, GLfloat height, GLfloat width);
-void UCreateCylinderMesh(GLMesh& mesh, GLfloat radius, GLfloat height, GLCoord base);
-void UCreateCircleMesh(GLMesh& mesh, GLfloat radius, GLCoord center);
+void UKeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
+void ULatchCamera();
+bool UGatherStepInput(StepInput& input);
+void USimulate(const StepInput& input, float dt);
+void UInterpolateState(float alpha);
+uint64_t UHashSimulationState();
+void UReportJobStats();
+void ULoadMesh(int meshIndex, const shared_ptr<FileData>& file, const SceneFormat::SceneView& scene, const SceneFormat::MeshRecord& record);
+void UBindMesh(const GLMesh& mesh);
+void UDrawMesh(const GLMesh& mesh, GLuint drawIndex);
+void UCompactGeometry();
+void UReportGeometryStats();
 void UDestroyMesh(GLMesh& mesh);
-bool UCreateTexture(const char* filename, GLuint& textureId);
+bool UDecodeImage(const FileData& file, DecodedImage& image);
+bool UCreateTexture(const char* filename, const DecodedImage& image, GLuint& textureId);
+void ULoadTexture(int textureIndex, const string& path, const shared_ptr<FileData>& file);
 void UDestroyTexture(GLuint textureId);
-void URender();
-bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId);
+int UAddInstance();
+Entity UCreateEntity(int node);
+void UAddRenderable(Entity entity, int mesh, const GLMaterial& surface, int texture, const glm::vec2& uvScale);
+bool ULoadScene(const char* path);
+void UScatterPointLights(int count);
+void UUpdateSceneTransforms();
+void UCullEntities(bool frustumCull);
+void UBuildFrame(FrameSnapshot& frame, const RingBuffer::Allocation& instanceRegion);
+RingBuffer::Allocation UReserveInstances();
+void URenderThread();
+void URender(const FrameSnapshot& frame);
+uint64_t UBatchKey(int mesh, const MaterialComponent& material);
+void UDrawLamps(const FrameSnapshot& frame);
+bool UCubeVariantsReady(const FrameSnapshot& frame, ShaderVariants::Path path);
+void UDrawObjects(const FrameSnapshot& frame, ShaderVariants::Path path);
+void UDrawDepthPrepass(const FrameSnapshot& frame, GLintptr indirectOffset);
+void ULightGBuffer(const FrameSnapshot& frame, GLsizei pointLightCount);
+void UReportDrawStats();
+void UReportLightGridStats();
 void UDestroyShaderProgram(GLuint programId);
 
 
-////////////////////////////////////////////////Shaders//////////////////////////////////////////////
-/* Cube Vertex Shader Source Code*/
-const GLchar* cubeVertexShaderSource = GLSL(440,
-
-layout(location = 0) in vec3 position; // VAP position 0 for vertex position data
-layout(location = 1) in vec3 normal; // VAP position 1 for normals
-layout(location = 2) in vec2 textureCoordinate;
-
-out vec3 vertexNormal; // For outgoing normals to fragment shader
-out vec3 vertexFragmentPos; // For outgoing color / pixels to fragment shader
-out vec2 vertexTextureCoordinate;
-
-//Uniform / Global variables for the  transform matrices
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-
-void main()
-{
-    gl_Position = projection * view * model * vec4(position, 1.0f); // Transforms vertices into clip coordinates
-
-    vertexFragmentPos = vec3(model * vec4(position, 1.0f)); // Gets fragment / pixel position in world space only (exclude view and projection)
-
-    vertexNormal = mat3(transpose(inverse(model))) * normal; // get normal vectors in world space only and exclude normal translation properties
-    vertexTextureCoordinate = textureCoordinate;
-}
-);
-
-
-/* Cube Fragment Shader Source Code*/
-const GLchar* cubeFragmentShaderSource = GLSL(440,
-
-in vec3 vertexNormal; // For incoming normals
-in vec3 vertexFragmentPos; // For incoming fragment position
-in vec2 vertexTextureCoordinate;
-
-out vec4 fragmentColor; // For outgoing cube color to the GPU
-
-// Uniform / Global variables for object color, light color, light position, and camera/view position
-uniform vec3 objectColor;
-uniform vec3 lightColor;
-uniform vec3 lightPos;
-uniform vec3 viewPosition;
-uniform sampler2D uTexture; // Useful when working with multiple textures
-uniform vec2 uvScale;
-
-void main()
-{
-    /*Phong lighting model calculations to generate ambient, diffuse, and specular components*/
-
-    //Calculate Ambient lighting*/
-    float ambientStrength = 0.3f; // Set ambient or global lighting strength
-    vec3 ambient = ambientStrength * lightColor; // Generate ambient light color
-
-    //Calculate Diffuse lighting*/
-    vec3 norm = normalize(vertexNormal); // Normalize vectors to 1 unit
-    vec3 lightDirection = normalize(lightPos - vertexFragmentPos); // Calculate distance (light direction) between light source and fragments/pixels on cube
-    float impact = max(dot(norm, lightDirection), 0.0);// Calculate diffuse impact by generating dot product of normal and light
-    vec3 diffuse = impact * lightColor; // Generate diffuse light color
-
-    //Calculate Specular lighting*/
-    float specularIntensity = 0.8f; // Set specular light strength
-    float highlightSize = 16.0f; // Set specular highlight size
-    vec3 viewDir = normalize(viewPosition - vertexFragmentPos); // Calculate view direction
-    vec3 reflectDir = reflect(-lightDirection, norm);// Calculate reflection vector
-    //Calculate specular component
-    float specularComponent = pow(max(dot(viewDir, reflectDir), 0.0), highlightSize);
-    vec3 specular = specularIntensity * specularComponent * lightColor;
-
-    // Texture holds the color to be used for all three components
-    vec4 textureColor = texture(uTexture, vertexTextureCoordinate * uvScale);
-
-    // Calculate phong result
-    vec3 phong = (ambient + diffuse + specular) * textureColor.xyz;
-
-    fragmentColor = vec4(phong, 1.0); // Send lighting results to GPU
-}
-);
-
-
-/* Lamp Shader Source Code*/
-const GLchar* lampVertexShaderSource = GLSL(440,
-
-    layout(location = 0) in vec3 position; // VAP position 0 for vertex position data
-
-//Uniform / Global variables for the  transform matrices
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-
-void main()
-{
-    gl_Position = projection * view * model * vec4(position, 1.0f); // Transforms vertices into clip coordinates
-}
-);
-
-
-/* Fragment Shader Source Code*/
-const GLchar* lampFragmentShaderSource = GLSL(440,
-
-    out vec4 fragmentColor; // For outgoing lamp color (smaller cube) to the GPU
-
-void main()
-{
-    fragmentColor = vec4(0.8f, 1.0f, 1.0f, 1.0f); // Set color and alpha of lamps
-}
-);
-/////////////////////////////////// ^^ Shaders ^^ /////////////////////////////////////////////////
-
-
 // Images are loaded with Y axis going down, but OpenGL's Y axis goes up, so let's flip it
 void flipImageVertically(unsigned char* image, int width, int height, int channels)
 {
@@ -288,75 +412,119 @@ int main(int argc, char* argv[])
     if (!UInitialize(argc, argv, &gWindow))
         return EXIT_FAILURE;
 
-    // Create the mesh
-    UCreateCubeMesh(basilMesh, { -3.0f, 2.0f, 0.0f }, 2.0f, 1.0f);
-    UCreatePyramidMesh(pyrMesh, { 3.0f, 1.0f, 3.0f }, 1.0f, 1.0f);
-    UCreateCubeMesh(cayenneMesh, { -3.0f, 2.0f, 3.0f }, 2.0f, 1.0f);
-    UCreatePlaneMesh(tableMesh, { -13.0f, 0.0f, -13.0f }, { 13.0f, 0.0f, -13.0f }, { -13.0f, 0.0f, 13.0f }, { 13.0f, 0.0f, 13.0f });
-    UCreateCylinderMesh(basilLidMesh, 0.6f, 0.3f, { -3.0f, 2.01f, 0.0f });
-    UCreateCylinderMesh(cayenneLidMesh, 0.6f, 0.3f, { -3.0f, 2.01f, 3.0f });
-    UCreateCylinderMesh(mugMesh, 0.7f, 1.4f, { 3.0f, -0.2f, 5.0f });
-    UCreateCircleMesh(padMesh, 1.0f, { 0.0f, 0.01f, -4.0f });
-
-    // Create the shader programs
-    if (!UCreateShaderProgram(cubeVertexShaderSource, cubeFragmentShaderSource, gCubeProgramId))
-        return EXIT_FAILURE;
-
-    if (!UCreateShaderProgram(lampVertexShaderSource, lampFragmentShaderSource, gLampProgramId))
-        return EXIT_FAILURE;
+    // Workers for decoding, inflating and the transform pass
+    gJobs.Initialize();
+    cout << "INFO: Job system: " << gJobs.WorkerCount() << " worker thread(s)" << endl;
 
-    // Load textures
-    const char* texFilename = "C://Users//encor//Downloads//basilLabel.jpeg";
-    if (!UCreateTexture(texFilename, basilTextureId))
+    // Meshes and textures go to the GPU from the upload thread while the first frames render
+    if (!gUploader.Initialize(gWindow))
     {
-        cout << "Failed to load texture " << texFilename << endl;
+        cout << "ERROR::UPLOAD::CONTEXT_NOT_CREATED" << endl;
         return EXIT_FAILURE;
     }
-    const char* pyrTexFilename = "C://Users//encor//OneDrive//Pictures//theStones.jpg";
-if (!UCreateTexture(pyrTexFilename, pyrTextureId))
-	{
-		cout << "Failed to load texture " << pyrTexFilename << endl;
-		return EXIT_FAILURE;
-	}
-	const char* cayenneTexFilename = "C://Users//encor//OneDrive//Pictures//cayenneLabel.jpg";
-    if (!UCreateTexture(cayenneTexFilename, cayenneTextureId))
-    {
-		cout << "Failed to load texture " << cayenneTexFilename << endl;
-		return EXIT_FAILURE;
-	}
-    const char* tableTexFilename = "C://Users//encor//Downloads//table.jpeg";
-    if (!UCreateTexture(tableTexFilename, tableTextureId))
-    {
-		cout << "Failed to load texture " << tableTexFilename << endl;
-		return EXIT_FAILURE;
-	}
-    const char* lidTexFilename = "C://Users//encor//Downloads//black.jpeg";
-    if (!UCreateTexture(lidTexFilename, basilLidTextureId))
-        {
-        cout << "Failed to load texture " << lidTexFilename << endl;
-			return EXIT_FAILURE;
-		}
-    const char* padTexFilename = "C://Users//encor//Downloads//cork.jpeg";
-    if (!UCreateTexture(padTexFilename, padTextureId))
-    {
-		cout << "Failed to load texture " << padTexFilename << endl;
-		return EXIT_FAILURE;
-	}
-   
 
+    // Submit the shader programs; they compile while the textures load and the first frames render.
+    // The cube shader variants are submitted lazily the first time an object needs them.
+    // Timed so cold and warm cache starts can be compared
+    gShaderStartTime = glfwGetTime();
+    gProgramBatch.EnableParallelCompile();
+    gProgramBatch.Submit("lamp", EmbeddedShaders::lamp_vert, EmbeddedShaders::lamp_frag, gLampProgramId);
+    gProgramBatch.Submit("depth", EmbeddedShaders::depth_vert, EmbeddedShaders::depth_frag, gDepthProgramId);
+    gProgramBatch.Submit("resolve", EmbeddedShaders::fullscreen_vert, EmbeddedShaders::deferred_resolve_frag, gResolveProgramId);
+    gProgramBatch.Submit("light volume", EmbeddedShaders::light_volume_vert, EmbeddedShaders::light_volume_frag, gLightVolumeProgramId);
+    gProgramBatch.SubmitCompute("cull", EmbeddedShaders::cull_comp, gCullProgramId);
+    gProgramBatch.SubmitCompute("hiz", EmbeddedShaders::hiz_comp, gHiZProgramId);
+
+    // Record the session's input or replay a recording instead of live input, and pick the scene and mounts
+    const char* scenePath = DEFAULT_SCENE;
+    string error;
+    if (!gFileSystem.Mount(DEFAULT_PACK, error) && error != "NOT_FOUND")
+        cout << "ERROR::VFS::" << error << " " << DEFAULT_PACK << endl;
+    for (int i = 1; i + 1 < argc; ++i)
+    {
+        string arg = argv[i];
+        if (arg == "--record")
+            gInputRecording.StartRecording(argv[++i], gSimulationClock.StepSeconds());
+        else if (arg == "--replay")
+        {
+            if (!gInputRecording.StartReplay(argv[++i], gSimulationClock.StepSeconds()))
+                return EXIT_FAILURE;
+        }
+        else if (arg == "--scene")
+            scenePath = argv[++i];
+        else if (arg == "--lights")
+        {
+            char* end = nullptr;
+            long count = strtol(argv[++i], &end, 10);
+            if (end == argv[i] || *end != '\0' || count < 0 || count > MAX_POINT_LIGHTS)
+            {
+                cout << "ERROR::LIGHTS::BAD_COUNT " << argv[i] << " (0 to " << MAX_POINT_LIGHTS << ")" << endl;
+                return EXIT_FAILURE;
+            }
+            gPointLightCount = (int)count;
+        }
+        else if (arg == "--mount")
+        {
+            if (!gFileSystem.Mount(argv[++i], error))
+            {
+                cout << "ERROR::VFS::" << error << " " << argv[i] << endl;
+                return EXIT_FAILURE;
+            }
+        }
+    }
 
-    // tell opengl for each sampler to which texture unit it belongs to (only has to be done once)
-    glUseProgram(gCubeProgramId);
-    // We set the texture as texture unit 0
-    glUniform1i(glGetUniformLocation(gCubeProgramId, "uTexture"), 0);
+    // Entities of the scene. Component removal follows entity destruction for every array
+    gEntities.Register(gTransformComponents);
+    gEntities.Register(gMeshRefs);
+    gEntities.Register(gMaterials);
+    gEntities.Register(gBounds);
+    gEntities.Register(gLights);
+    gSceneStartTime = glfwGetTime();
+    if (!ULoadScene(scenePath))
+        return EXIT_FAILURE;
+    cout << "INFO: Scene " << scenePath << " loaded in " << (glfwGetTime() - gSceneStartTime) * 1000.0 << " ms, uploading" << endl;
+    UScatterPointLights(gPointLightCount);
+    gLightGrid.Initialize(LightGrid::CLUSTER_COUNT * 32);
+
+    // One ring region holds a frame's FrameData, the matrices of every object and the draw data and
+    // indirect commands of up to two draws per object (lamp and body), the point lights and the light
+    // grid, plus room for streamed vertices and the alignment between blocks
+    GLsizeiptr regionSize = sizeof(FrameData)
+        + (GLsizeiptr)gTransforms.Capacity() * (sizeof(TransformPipeline::InstanceData) + 2 * (sizeof(DrawData) + sizeof(DrawElementsIndirectCommand)))
+        + (GLsizeiptr)gPointLights.size() * sizeof(PointLight)
+        + LightGrid::CLUSTER_COUNT * sizeof(LightGrid::Cluster) + (GLsizeiptr)gLightGrid.IndexCapacity() * sizeof(GLuint)
+        + 64 * 1024;
+    gFrameRing.Initialize(regionSize);
+    gFrameMailbox.SetFirstReply(UReserveInstances());
+    gCuller.Initialize(2 * gTransforms.Capacity(), 2 * gTransforms.Capacity());
+    // attribute-less draws (full-screen triangle, light volumes) still need a vertex array in a core context
+    glGenVertexArrays(1, &gEmptyVertexArray);
 
     // Sets the background color of the window to black (it will be implicitely used by glClear)
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 
-    // render loop
+    gCurrentState = { gLightPosition, gCamera.Position, true, 0.0f };
+    gPreviousState = gCurrentState;
+    gLastFrame = glfwGetTime(); // don't simulate the loading time on the first frame
+    gReplayStartTime = gLastFrame;
+    gJobs.ResetStats();     // report the workers' share of the frames, not of the loading
+
+    // The render thread takes the GL context and draws the frames the main loop publishes; this thread
+    // keeps the window events, the simulation, the culling and the transform pass
+    glfwMakeContextCurrent(NULL);
+    thread renderThread(URenderThread);
+
+    // main loop
     // -----------
     while (!glfwWindowShouldClose(gWindow))
     {
+        // Wait until the render thread has taken the last frame, then gather input, so the next frame is
+        // built from fresh events while that one is submitted
+        RingBuffer::Allocation instanceRegion;
+        if (!gFrameMailbox.WaitForPickup(instanceRegion))
+            break;
+        glfwPollEvents();
+
         // per-frame timing
         // --------------------
         float currentFrame = glfwGetTime();
@@ -365,35 +533,80 @@ if (!UCreateTexture(pyrTexFilename, pyrTextureId))
 
         UProcessInput(gWindow);
 
-        // Render this frame
-        URender();
+        // Run the fixed simulation steps this frame covers, then place the scene between the last two states
+        int steps = gSimulationClock.Advance(gDeltaTime);
+        for (int i = 0; i < steps; ++i)
+        {
+            StepInput input;
+            if (!UGatherStepInput(input))
+                break;
+            gPreviousState = gCurrentState;
+            USimulate(input, gSimulationClock.StepSeconds());
+        }
+        UInterpolateState(gSimulationClock.Alpha());
 
-        glfwPollEvents();
+        if (gInputRecording.IsFinished())
+        {
+            double elapsed = glfwGetTime() - gReplayStartTime;
+            cout << "INFO: Replay finished: " << gReplayFrames << " frames in " << elapsed * 1000.0 << " ms ("
+                << elapsed * 1000.0 / (gReplayFrames > 0 ? gReplayFrames : 1) << " ms per frame), state hash "
+                << hex << UHashSimulationState() << dec << endl;
+            UReportJobStats();
+            break;
+        }
+
+        // Hand this frame to the render thread
+        UBuildFrame(gFrameMailbox.Back(), instanceRegion);
+        gFrameMailbox.Publish();
+        ++gReplayFrames;
     }
 
+    // Stop the render thread and take the context back for the cleanup, then let the uploads in flight
+    // finish; their completions hand the last textures to gTextures, so the loop below deletes them
+    gFrameMailbox.Close();
+    renderThread.join();
+    glfwMakeContextCurrent(gWindow);
+    gJobs.Wait(gTextureDecodes);
+    gUploader.Destroy();
+    UReportDrawStats();
+    UReportLightGridStats();
+
+    if (gInputRecording.IsRecording())
+    {
+        cout << "INFO: Simulation state hash " << hex << UHashSimulationState() << dec << endl;
+        gInputRecording.Save();
+    }
+    if (!gInputRecording.IsReplaying())
+        UReportJobStats();
+
     // Release mesh data. Who knows what will happen if we keep it?
-    UDestroyMesh(basilMesh);
-    UDestroyMesh(pyrMesh);
-	UDestroyMesh(cayenneMesh);
-    UDestroyMesh(tableMesh);
-    UDestroyMesh(basilLidMesh);
-    UDestroyMesh(mugMesh);
-    UDestroyMesh(cayenneLidMesh);
-    UDestroyMesh(padMesh);
+    for (GLMesh& mesh : gMeshes)
+        UDestroyMesh(mesh);
+    gGeometry.Destroy();
 
     // Release texture
-    UDestroyTexture(basilTextureId);
-    UDestroyTexture(pyrTextureId);
-    UDestroyTexture(cayenneTextureId);
-    UDestroyTexture(tableTextureId);
-    UDestroyTexture(basilLidTextureId);
-    UDestroyTexture(padTextureId);
+    for (GLuint textureId : gTextures)
+        UDestroyTexture(textureId);
 
     // Release shader programs
-    UDestroyShaderProgram(gCubeProgramId);
+    gCubeShaders.Destroy();
     UDestroyShaderProgram(gLampProgramId);
-
-    exit(EXIT_SUCCESS); // Terminates the program successfully
+    UDestroyShaderProgram(gDepthProgramId);
+    UDestroyShaderProgram(gResolveProgramId);
+    UDestroyShaderProgram(gLightVolumeProgramId);
+    gGBuffer.Destroy();
+    glDeleteVertexArrays(1, &gEmptyVertexArray);
+    cout << "INFO: Frame ring peak " << gFrameRing.PeakUsage() / 1024 << " of " << gFrameRing.RegionSize() / 1024 << " KB per frame" << endl;
+    gFrameRing.Destroy();
+    gCuller.Destroy();
+    UDestroyShaderProgram(gCullProgramId);
+    gHiZ.Destroy();
+    UDestroyShaderProgram(gHiZProgramId);
+    gPassStats.Destroy();
+    gFramePacer.Destroy();
+    gJobs.Destroy();
+
+    exit(gRenderFailed ? EXIT_FAILURE : EXIT_SUCCESS); // Terminates the program successfully, unless a shader failed
 }
 
 
@@ -410,6 +623,9 @@ bool UInitialize(int argc, char* argv[], GLFWwindow** window)
 #ifdef __APPLE__
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
+    // The deferred path blits its depth into the window's, which needs the formats to match (GBuffer)
+    glfwWindowHint(GLFW_DEPTH_BITS, 24);
+    glfwWindowHint(GLFW_STENCIL_BITS, 8);
 
     // GLFW: window creation
     // ---------------------
@@ -424,9 +640,17 @@ bool UInitialize(int argc, char* argv[], GLFWwindow** window)
     glfwSetFramebufferSizeCallback(*window, UResizeWindow);
     glfwSetCursorPosCallback(*window, UMousePositionCallback);
     glfwSetScrollCallback(*window, UMouseScrollCallback);
+    glfwSetKeyCallback(*window, UKeyCallback);
+
+    // The framebuffer can differ from the requested window size (high DPI, window managers)
+    glfwGetFramebufferSize(*window, &gFramebufferWidth, &gFramebufferHeight);
+    if (gFramebufferHeight > 0)
+        gCamera.SetAspectRatio((float)gFramebufferWidth / (float)gFramebufferHeight);
 
     // tell GLFW to capture our mouse
     glfwSetInputMode(*window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    // and to skip the OS pointer acceleration while it is captured
+    gInput.EnableRawMouseMotion(*window);
 
     // GLEW: initialize
     // ----------------
@@ -446,37 +670,56 @@ bool UInitialize(int argc, char* argv[], GLFWwindow** window)
 }
 
 
-// process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
+// process per-frame input: check the key state gathered by the key callback and react accordingly.
+// Mouse look is applied later, in ULatchCamera, right before the camera is uploaded
 void UProcessInput(GLFWwindow* window)
 {
-    static const float cameraSpeed = 1.8f;
-
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+    if (gInput.IsKeyDown(GLFW_KEY_ESCAPE))
         glfwSetWindowShouldClose(window, true);
 
 
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
-        gCamera.ProcessKeyboard(FORWARD, gDeltaTime);
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
-        gCamera.ProcessKeyboard(BACKWARD, gDeltaTime);
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
-        gCamera.ProcessKeyboard(LEFT, gDeltaTime);
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
-        gCamera.ProcessKeyboard(RIGHT, gDeltaTime);
-    if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
-        gCamera.ProcessKeyboard(UP, gDeltaTime);
-    if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
-        gCamera.ProcessKeyboard(DOWN, gDeltaTime);
-   //if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS)
+    // Camera movement (WASD/arrows, Q/E) and the lamp keys (L/K) are read per simulation step in UGatherStepInput
+   //if (gInput.IsKeyDown(GLFW_KEY_SPACE))
         //shootLaser();
 
+    // Toggle the other lights; the first toggle compiles the variants for all light entities
+    if (gInput.WasKeyPressed(GLFW_KEY_F))
+        gActiveLightCount = gActiveLightCount == 1 ? glm::min((int)gLights.Size(), ShaderVariants::MAX_LIGHTS) : 1;
 
-    // Pause and resume lamp orbiting
-    static bool isLKeyDown = false;
-    if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS && !gIsLampOrbiting)
-        gIsLampOrbiting = true;
-    else if (glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS && gIsLampOrbiting)
-        gIsLampOrbiting = false;
+    // Toggle the input-to-present latency report
+    if (gInput.WasKeyPressed(GLFW_KEY_F2))
+    {
+        gMeasureLatency = !gMeasureLatency;
+        cout << "INFO: Latency measurement " << (gMeasureLatency ? "on" : "off") << endl;
+    }
+
+    // Toggle between culling on the GPU and on the main thread
+    if (gInput.WasKeyPressed(GLFW_KEY_F3))
+    {
+        gGpuCulling = !gGpuCulling;
+        cout << "INFO: " << (gGpuCulling ? "GPU" : "CPU") << " culling" << endl;
+    }
+
+    // Toggle the occlusion test of the GPU culling
+    if (gInput.WasKeyPressed(GLFW_KEY_F4))
+    {
+        gOcclusionCulling = !gOcclusionCulling;
+        cout << "INFO: Occlusion culling " << (gOcclusionCulling ? "on" : "off") << endl;
+    }
+
+    // Toggle the depth pre-pass; the pass statistics compare the frames with and without it
+    if (gInput.WasKeyPressed(GLFW_KEY_F5))
+    {
+        gDepthPrepass = !gDepthPrepass;
+        cout << "INFO: Depth pre-pass " << (gDepthPrepass ? "on" : "off") << endl;
+    }
+
+    // Cycle the lighting paths: forward without the point lights, deferred, clustered forward
+    if (gInput.WasKeyPressed(GLFW_KEY_F6))
+    {
+        gLightingPath = (ShaderVariants::Path)((gLightingPath + 1) % ShaderVariants::PATH_COUNT);
+        cout << "INFO: " << ShaderVariants::PathName(gLightingPath) << " shading, " << gPointLights.size() << " point lights" << endl;
+    }
 
 }
 
@@ -484,7 +727,13 @@ void UProcessInput(GLFWwindow* window)
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
 void UResizeWindow(GLFWwindow* window, int width, int height)
 {
-    glViewport(0, 0, width, height);
+    // the render thread sets the viewport with the next frame
+    gFramebufferWidth = width;
+    gFramebufferHeight = height;
+
+    // a minimized window reports 0 x 0; keep the last aspect ratio
+    if (height > 0)
+        gCamera.SetAspectRatio((float)width / (float)height);
 }
 
 
@@ -492,20 +741,8 @@ void UResizeWindow(GLFWwindow* window, int width, int height)
 // -------------------------------------------------------
 void UMousePositionCallback(GLFWwindow* window, double xpos, double ypos)
 {
-    if (gFirstMouse)
-    {
-        gLastX = xpos;
-        gLastY = ypos;
-        gFirstMouse = false;
-    }
-
-    float xoffset = xpos - gLastX;
-    float yoffset = gLastY - ypos; // reversed since y-coordinates go from bottom to top
-
-    gLastX = xpos;
-    gLastY = ypos;
-
-    gCamera.ProcessMouseMovement(xoffset, yoffset);
+    // only accumulated here; ULatchCamera turns the camera once per frame
+    gInput.OnCursorPos(xpos, ypos);
 }
 
 
@@ -517,670 +754,1161 @@ void UMouseScrollCallback(GLFWwindow* window, double xoffset, double yoffset)
 }
 
 
-
-
-void URender()
+// glfw: whenever a key is pressed or released, this callback is called
+// --------------------------------------------------------------------
+void UKeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
-    // Lamp orbits around the origin
-    const float angularVelocity = glm::radians(25.0f);
-    if (gIsLampOrbiting)
-    {
-        glm::vec4 newPosition = glm::rotate(angularVelocity * gDeltaTime, glm::vec3(0.0f, 1.0f, 1.0f)) * glm::vec4(gLightPosition, 1.0f);
-        gLightPosition.x = newPosition.x;
-        gLightPosition.y = newPosition.y;
-        gLightPosition.z = newPosition.z;
-    }
-
-    // Enable z-depth
-    glEnable(GL_DEPTH_TEST);
-
-    // Clear the frame and z buffers
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    // Activate the VAO (used by cubes and lamps)
-    glBindVertexArray(basilMesh.vao);
-
-    // Basil Creation!
-    //----------------
-    // Set the shader to be used
-    glUseProgram(gCubeProgramId);
-
-    // Model matrix: transformations are applied right-to-left order
-    glm::mat4 model = glm::translate(gBasilPosition) * glm::scale(gBasilScale);
-
-    // camera/view transformation
-    glm::mat4 view = gCamera.GetViewMatrix();
-
-    // Creates a perspective projection
-    glm::mat4 projection = glm::perspective(glm::radians(gCamera.Zoom), (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f);
-
-    // Retrieves and passes transform matrices to the Shader program
-    GLint modelLoc = glGetUniformLocation(gCubeProgramId, "model");
-    GLint viewLoc = glGetUniformLocation(gCubeProgramId, "view");
-    GLint projLoc = glGetUniformLocation(gCubeProgramId, "projection");
-
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
-
-    // Reference matrix uniforms from the Cube Shader program for the cub color, light color, light position, and camera position
-    GLint objectColorLoc = glGetUniformLocation(gCubeProgramId, "objectColor");
-    GLint lightColorLoc = glGetUniformLocation(gCubeProgramId, "lightColor");
-    GLint fillLightColorLoc = glGetUniformLocation(gCubeProgramId, "fillLightColor");
-    GLint lightPositionLoc = glGetUniformLocation(gCubeProgramId, "lightPos");
-    GLint fillLightPositionLoc = glGetUniformLocation(gCubeProgramId, "fillLightPos");
-    GLint viewPositionLoc = glGetUniformLocation(gCubeProgramId, "viewPosition");
-
+    gInput.OnKey(key, action);
+}
 
-    // Pass color, light, and camera data to the Cube Shader program's corresponding uniforms
-    glUniform3f(objectColorLoc, gObjectColor.r, gObjectColor.g, gObjectColor.b);
-    glUniform3f(lightColorLoc, gLightColor.r, gLightColor.g, gLightColor.b);
-    glUniform3f(lightPositionLoc, gLightPosition.x, gLightPosition.y, gLightPosition.z);
-    glUniform3f(fillLightColorLoc, gFillLightColor.r, gFillLightColor.g, gFillLightColor.b);
-    glUniform3f(fillLightPositionLoc, gFillLightPosition.x, gFillLightPosition.y, gFillLightPosition.z);
 
-    const glm::vec3 cameraPosition = gCamera.Position;
-    glUniform3f(viewPositionLoc, cameraPosition.x, cameraPosition.y, cameraPosition.z);
+// Applies the newest mouse motion to the camera as late as possible in the frame: events that arrived
+// while the frame was being prepared are picked up, and all of them turn the camera in one step
+void ULatchCamera()
+{
+    glfwPollEvents();
 
-    GLint UVScaleLoc = glGetUniformLocation(gCubeProgramId, "uvScale");
-    glUniform2fv(UVScaleLoc, 1, glm::value_ptr(gUVScale));
+    // a replay drives the camera orientation from the recording
+    float xoffset, yoffset;
+    if (gInput.ConsumeMouseDelta(xoffset, yoffset) && !gInputRecording.IsReplaying())
+        gCamera.ProcessMouseMovement(xoffset, yoffset);
+}
 
-    // bind textures on corresponding texture units
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, basilTextureId);
 
-    // Draws the triangles
-    glDrawArrays(GL_TRIANGLES, 0, basilMesh.nVertices);
+// Reads the input of one simulation step: live key state and camera orientation, or the next recorded step.
+// Returns false when a replay has run out of steps
+bool UGatherStepInput(StepInput& input)
+{
+    if (gInputRecording.IsReplaying())
+        return gInputRecording.Next(input);
+
+    input.keys = 0;
+    if (gInput.IsKeyDown(GLFW_KEY_W) || gInput.IsKeyDown(GLFW_KEY_UP))
+        input.keys |= StepInput::MOVE_FORWARD;
+    if (gInput.IsKeyDown(GLFW_KEY_S) || gInput.IsKeyDown(GLFW_KEY_DOWN))
+        input.keys |= StepInput::MOVE_BACKWARD;
+    if (gInput.IsKeyDown(GLFW_KEY_A) || gInput.IsKeyDown(GLFW_KEY_LEFT))
+        input.keys |= StepInput::MOVE_LEFT;
+    if (gInput.IsKeyDown(GLFW_KEY_D) || gInput.IsKeyDown(GLFW_KEY_RIGHT))
+        input.keys |= StepInput::MOVE_RIGHT;
+    if (gInput.IsKeyDown(GLFW_KEY_Q))
+        input.keys |= StepInput::PITCH_UP;
+    if (gInput.IsKeyDown(GLFW_KEY_E))
+        input.keys |= StepInput::PITCH_DOWN;
+    if (gInput.IsKeyDown(GLFW_KEY_L))
+        input.keys |= StepInput::LAMP_RESUME;
+    if (gInput.IsKeyDown(GLFW_KEY_K))
+        input.keys |= StepInput::LAMP_PAUSE;
+    input.yaw = gCamera.Yaw;
+    input.pitch = gCamera.Pitch;
+
+    if (gInputRecording.IsRecording())
+        gInputRecording.Record(input);
+    return true;
+}
 
-    // LAMP: draw key lamp
-    //----------------
-    glUseProgram(gLampProgramId);
 
-    model = glm::translate(gLightPosition) * glm::scale(gLightScale);
+// Advances the scene by one fixed step. Everything here depends only on the state and the step input,
+// so a replay reproduces the same states bit for bit
+void USimulate(const StepInput& input, float dt)
+{
+    if (gInputRecording.IsReplaying())
+        gCamera.SetOrientation(input.yaw, input.pitch);
+
+    // the camera holds the interpolated position between frames, move it from the simulated one
+    gCamera.SetPosition(gCurrentState.cameraPosition);
+    if (input.keys & StepInput::MOVE_FORWARD)
+        gCamera.ProcessKeyboard(FORWARD, dt);
+    if (input.keys & StepInput::MOVE_BACKWARD)
+        gCamera.ProcessKeyboard(BACKWARD, dt);
+    if (input.keys & StepInput::MOVE_LEFT)
+        gCamera.ProcessKeyboard(LEFT, dt);
+    if (input.keys & StepInput::MOVE_RIGHT)
+        gCamera.ProcessKeyboard(RIGHT, dt);
+    if (input.keys & StepInput::PITCH_UP)
+        gCamera.ProcessKeyboard(UP, dt);
+    if (input.keys & StepInput::PITCH_DOWN)
+        gCamera.ProcessKeyboard(DOWN, dt);
+    gCurrentState.cameraPosition = gCamera.Position;
 
-    // Reference matrix uniforms from the Lamp Shader program
-    modelLoc = glGetUniformLocation(gLampProgramId, "model");
-    viewLoc = glGetUniformLocation(gLampProgramId, "view");
-    projLoc = glGetUniformLocation(gLampProgramId, "projection");
+    // Pause and resume lamp orbiting
+    if ((input.keys & StepInput::LAMP_RESUME) && !gCurrentState.isLampOrbiting)
+        gCurrentState.isLampOrbiting = true;
+    else if ((input.keys & StepInput::LAMP_PAUSE) && gCurrentState.isLampOrbiting)
+        gCurrentState.isLampOrbiting = false;
 
-    // Pass matrix data to the Lamp Shader program's matrix uniforms
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
+    // Lamp orbits around the origin
+    const float angularVelocity = glm::radians(25.0f);
+    if (gCurrentState.isLampOrbiting)
+    {
+        glm::vec4 newPosition = glm::rotate(angularVelocity * dt, glm::vec3(0.0f, 1.0f, 1.0f)) * glm::vec4(gCurrentState.lightPosition, 1.0f);
+        gCurrentState.lightPosition = glm::vec3(newPosition.x, newPosition.y, newPosition.z);
+    }
 
-    glDrawArrays(GL_TRIANGLES, 0, basilMesh.nVertices);
+    // Point lights circle their anchors at a radian per second, wrapped so the angle keeps its precision
+    gCurrentState.pointLightAngle = fmod(gCurrentState.pointLightAngle + dt, 6.2831853f);
+}
 
 
-    // LAMP: draw fill lamp
+// Places the rendered lamp, camera and point lights between the last two simulation states
+void UInterpolateState(float alpha)
+{
+    gLightPosition = glm::mix(gPreviousState.lightPosition, gCurrentState.lightPosition, alpha);
+    gCamera.SetPosition(glm::mix(gPreviousState.cameraPosition, gCurrentState.cameraPosition, alpha));
+
+    // past a wrap the current angle is the smaller one; a turn more keeps the lights going forward
+    float pointLightAngle = gCurrentState.pointLightAngle;
+    if (pointLightAngle < gPreviousState.pointLightAngle)
+        pointLightAngle += 6.2831853f;
+    gPointLightAngle = glm::mix(gPreviousState.pointLightAngle, pointLightAngle, alpha);
+}
 
-    //Transform the smaller cube used as a visual que for the light source
-    model = glm::translate(gFillLightPosition) * glm::scale(gFillLightScale);
 
-    // Reference matrix uniforms from the Lamp Shader program
-    modelLoc = glGetUniformLocation(gLampProgramId, "model");
-    viewLoc = glGetUniformLocation(gLampProgramId, "view");
-    projLoc = glGetUniformLocation(gLampProgramId, "projection");
+// FNV-1a over the simulated state, printed after recording and replaying so runs can be compared
+uint64_t UHashSimulationState()
+{
+    const float values[] = {
+        gCurrentState.lightPosition.x, gCurrentState.lightPosition.y, gCurrentState.lightPosition.z,
+        gCurrentState.cameraPosition.x, gCurrentState.cameraPosition.y, gCurrentState.cameraPosition.z,
+        gCurrentState.pointLightAngle
+    };
+    uint64_t hash = 14695981039346656037ull;
+    const unsigned char* bytes = (const unsigned char*)values;
+    for (size_t i = 0; i < sizeof(values); ++i)
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    hash = (hash ^ (unsigned char)gCurrentState.isLampOrbiting) * 1099511628211ull;
+    return hash;
+}
 
-    // Pass matrix data to the Lamp Shader program's matrix uniforms
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
 
-    glDrawArrays(GL_TRIANGLES, 0, basilMesh.nVertices);
+// Prints how busy each worker was since the main loop started, to see whether the CPU work spreads out
+void UReportJobStats()
+{
+    for (int i = 0; i < gJobs.WorkerCount(); ++i)
+    {
+        JobSystem::WorkerStats stats = gJobs.Stats(i);
+        cout << "INFO: Worker " << i << ": " << stats.utilization * 100.0 << "% busy, " << stats.jobs << " jobs, "
+            << stats.steals << " stolen" << endl;
+    }
+}
 
-    // Deactivate the Vertex Array Object and shader program
-    glBindVertexArray(0);
-    glUseProgram(0);
 
 
-    // Pyramid Creation!
-    glBindVertexArray(pyrMesh.vao);
 
-    // Set the shader to be used
-    glUseProgram(gCubeProgramId);
+// Adds a transform pipeline entry for a scene node that gets an entity, the node's object; -1 when
+// the pipeline is full
+int UAddInstance()
+{
+    int instance = gTransforms.Add(glm::vec3(0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f));
+    if (instance < 0)
+        cout << "ERROR::SCENE::TOO_MANY_ENTITIES (" << gTransforms.Count() << ")" << endl;
+    return instance;
+}
 
-    // Model matrix: transformations are applied right-to-left order
-    glm::mat4 model2 = glm::translate(gPyramidPosition) * glm::scale(gPyramidScale);
 
-    // camera/view transformation
-    glm::mat4 view2 = gCamera.GetViewMatrix();
+// Creates an entity for a scene node added with the transform pipeline entry of UAddInstance()
+Entity UCreateEntity(int node)
+{
+    Entity entity = gEntities.Create();
+    gTransformComponents.Add(entity, { node, gSceneGraph.GetObject(node) });
+    return entity;
+}
 
-    // Creates a perspective projection
-    glm::mat4 projection2 = glm::perspective(glm::radians(gCamera.Zoom), (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f);
 
-    // Retrieves and passes transform matrices to the Shader program
-    GLint modelLoc2 = glGetUniformLocation(gCubeProgramId, "model2");
-    GLint viewLoc2 = glGetUniformLocation(gCubeProgramId, "view2");
-    GLint projLoc2 = glGetUniformLocation(gCubeProgramId, "projection2");
+// Makes an entity drawable with the cube shader; its bounds come from the mesh
+void UAddRenderable(Entity entity, int mesh, const GLMaterial& surface, int texture, const glm::vec2& uvScale)
+{
+    gMeshRefs.Add(entity, { mesh });
+    gMaterials.Add(entity, { surface, texture, uvScale });
+    gBounds.Add(entity, { gMeshes[mesh].boundsCenter, gMeshes[mesh].boundsRadius });
+}
 
-    glUniformMatrix4fv(modelLoc2, 1, GL_FALSE, glm::value_ptr(model2));
-    glUniformMatrix4fv(viewLoc2, 1, GL_FALSE, glm::value_ptr(view2));
-    glUniformMatrix4fv(projLoc2, 1, GL_FALSE, glm::value_ptr(projection2));
 
-    // Reference matrix uniforms from the Cube Shader program for the cub color, light color, light position, and camera position
-    GLint objectColorLoc2 = glGetUniformLocation(gCubeProgramId, "objectColor2");
-    GLint lightColorLoc2 = glGetUniformLocation(gCubeProgramId, "lightColor2");
-    GLint lightPositionLoc2 = glGetUniformLocation(gCubeProgramId, "lightPos2");
-    GLint viewPositionLoc2 = glGetUniformLocation(gCubeProgramId, "viewPosition2");
+// Creates the scene described by a file from the SceneConverter tool. The file is read through the
+// virtual file system and used in place, memory-mapped from a stored pack entry or a loose file:
+// vertex and index ranges go from the mapping straight to the GL buffers and the records are read
+// through pointers, so loading costs the file I/O and one pass over the tables.
+// Meshes and textures reach the GPU through the upload thread after this returns; entities whose
+// mesh or texture is not resident yet are skipped when drawing.
+// Nodes with a mesh or a light become entities, the others only group their children
+bool ULoadScene(const char* path)
+{
+    using namespace SceneFormat;
 
-    // Pass color, light, and camera data to the Cube Shader program's corresponding uniforms
-    glUniform3f(objectColorLoc2, gObjectColor.r, gObjectColor.g, gObjectColor.b);
-    glUniform3f(lightColorLoc2, gLightColor.r, gLightColor.g, gLightColor.b);
-    glUniform3f(lightPositionLoc2, gLightPosition.x, gLightPosition.y, gLightPosition.z);
-    glUniform3f(viewPositionLoc2, cameraPosition.x, cameraPosition.y, cameraPosition.z);
-    glUniform2fv(UVScaleLoc, 1, glm::value_ptr(gPyramidUVScale));
+    // shared with the mesh uploads, which read the vertices and indices from it
+    shared_ptr<FileData> file = make_shared<FileData>();
+    if (!gFileSystem.Read(path, *file))
+    {
+        cout << "ERROR::SCENE::FILE_NOT_FOUND " << path << endl;
+        return false;
+    }
 
-    // bind textures on corresponding texture units
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, pyrTextureId);
+    SceneView scene;
+    string error;
+    if (!scene.Open(file->Data(), file->Size(), error))
+    {
+        cout << "ERROR::SCENE::" << error << " " << path << endl;
+        return false;
+    }
 
-    // Draws the triangles
-    glDrawArrays(GL_TRIANGLES, 0, pyrMesh.nVertices);
-    // ^^ Pyramid Creation ^^
+    // Read every texture in one batch, so compressed pack entries inflate in parallel, then decode
+    // and upload each one in the background
+    vector<string> texturePaths;
+    for (uint32_t i = 0; i < scene.TextureCount(); ++i)
+        texturePaths.push_back(scene.String(scene.Texture(i).path));
+    vector<FileData> textureFiles;
+    gFileSystem.ReadAll(texturePaths, textureFiles, gJobs.ParallelForFunction());
+
+    gTextures.assign(texturePaths.size(), 0);
+    for (size_t i = 0; i < texturePaths.size(); ++i)
+        ULoadTexture((int)i, texturePaths[i], make_shared<FileData>(move(textureFiles[i])));
+
+    // One vertex buffer per layout and one index buffer, sized for every mesh of the scene plus a
+    // quarter for meshes added later. The vertex arrays are created here, in the context that draws
+    GLsizeiptr vertexBytes[GeometryPool::LAYOUT_COUNT] = {};
+    GLsizeiptr indexBytes = 0;
+    for (uint32_t i = 0; i < scene.MeshCount(); ++i)
+    {
+        vertexBytes[scene.Mesh(i).layout] += (GLsizeiptr)scene.VertexBytes(scene.Mesh(i));
+        indexBytes += (GLsizeiptr)scene.IndexBytes(scene.Mesh(i));
+    }
+    for (GLsizeiptr& bytes : vertexBytes)
+        bytes += bytes / 4;
+    // up to two draws per node, lamp and body, like the ring buffer's draw data
+    gGeometry.Initialize(vertexBytes, indexBytes + indexBytes / 4, 2 * scene.NodeCount());
+    // the upload context writes into the buffers right away; they have to exist on the GPU by then
+    glFinish();
+
+    // Sized once: the uploads complete into these entries by index
+    gMeshes.assign(scene.MeshCount(), GLMesh());
+    for (uint32_t i = 0; i < scene.MeshCount(); ++i)
+        ULoadMesh((int)i, file, scene, scene.Mesh(i));
+
+    vector<GLMaterial> materials;
+    for (uint32_t i = 0; i < scene.MaterialCount(); ++i)
+    {
+        const MaterialRecord& record = scene.Material(i);
+        materials.push_back({ (record.flags & MATERIAL_TEXTURED) != 0, (record.flags & MATERIAL_SPECULAR) != 0,
+            glm::make_vec3(record.color), record.ambientStrength, record.specularIntensity, record.highlightSize });
+    }
 
-    // Cayenne Creation!
-    glBindVertexArray(cayenneMesh.vao);
+    // The nodes go into the scene graph in one pass: the converter writes them depth-first, the order
+    // the graph stores them in. Nodes with a mesh or a light become entities with a transform entry
+    gTransforms.Initialize(scene.NodeCount());
+    vector<int> nodeParents(scene.NodeCount());
+    vector<Transform> nodeLocals(scene.NodeCount());
+    vector<int> nodeObjects(scene.NodeCount());
+    for (uint32_t i = 0; i < scene.NodeCount(); ++i)
+    {
+        const NodeRecord& record = scene.Node(i);
+        nodeParents[i] = record.parent;
+        nodeLocals[i] = { glm::make_vec3(record.position),
+            glm::quat(record.rotation[3], record.rotation[0], record.rotation[1], record.rotation[2]), glm::make_vec3(record.scale) };
+        nodeObjects[i] = record.mesh >= 0 || (record.flags & NODE_LIGHT) != 0 ? UAddInstance() : -1;
+    }
+    int firstNode = gSceneGraph.AddNodes(nodeParents.data(), nodeLocals.data(), nodeObjects.data(), (int)scene.NodeCount());
 
-    // Set the shader to be used
-    glUseProgram(gCubeProgramId);
+    bool hasKeyLamp = false;
+    for (uint32_t i = 0; i < scene.NodeCount(); ++i)
+    {
+        const NodeRecord& record = scene.Node(i);
+        bool isLight = (record.flags & NODE_LIGHT) != 0;
+        if (record.mesh < 0 && !isLight)
+            continue;
+
+        Entity entity = UCreateEntity(firstNode + (int)i);
+        if (record.material >= 0)
+            UAddRenderable(entity, record.mesh, materials[record.material], record.texture, glm::make_vec2(record.uvScale));
+        else if (record.mesh >= 0)
+            gMeshRefs.Add(entity, { record.mesh });
+
+        if (isLight)
+        {
+            gLights.Add(entity, { glm::make_vec3(record.lightColor) });
+            if (!hasKeyLamp)
+            {
+                gKeyLamp = entity;
+                gLightPosition = nodeLocals[i].position;
+                hasKeyLamp = true;
+            }
+        }
+    }
 
+    if (!hasKeyLamp)
+    {
+        cout << "ERROR::SCENE::NO_LIGHT " << path << endl;
+        return false;
+    }
+    return true;
+}
 
-    glUniformMatrix4fv(modelLoc2, 1, GL_FALSE, glm::value_ptr(model2));
-    glUniformMatrix4fv(viewLoc2, 1, GL_FALSE, glm::value_ptr(view2));
-    glUniformMatrix4fv(projLoc2, 1, GL_FALSE, glm::value_ptr(projection2));
 
+// Scatters count point lights through the box the renderables span, with ranges of a few percent of
+// its size and colors spread over the hues. The seed is fixed and the lights circle with the simulated
+// time (SimulationState::pointLightAngle), so every run and replay sees the same lights
+void UScatterPointLights(int count)
+{
+    gPointLights.clear();
+    if (count <= 0 || gBounds.Size() == 0)
+        return;
+
+    // World bounds of the renderables' bounding spheres
+    UUpdateSceneTransforms();
+    glm::vec3 low(0.0f);
+    glm::vec3 high(0.0f);
+    const Bounds* bounds = gBounds.Data();
+    const Entity* entities = gBounds.Entities();
+    for (size_t i = 0; i < gBounds.Size(); ++i)
+    {
+        const Transform& world = gSceneGraph.GetWorld(gTransformComponents.Get(entities[i]).node);
+        float radius = bounds[i].radius * glm::max(world.scale.x, glm::max(world.scale.y, world.scale.z));
+        glm::vec3 center = world.position + world.rotation * (world.scale * bounds[i].center);
+        low = i == 0 ? center - radius : glm::min(low, center - radius);
+        high = i == 0 ? center + radius : glm::max(high, center + radius);
+    }
+    glm::vec3 extent = high - low;
+    float size = glm::max(extent.x, glm::max(extent.y, extent.z));
 
-    // Pass color, light, and camera data to the Cube Shader program's corresponding uniforms
-    glUniform3f(objectColorLoc2, gObjectColor.r, gObjectColor.g, gObjectColor.b);
-    glUniform3f(lightColorLoc2, gLightColor.r, gLightColor.g, gLightColor.b);
-    glUniform3f(lightPositionLoc2, gLightPosition.x, gLightPosition.y, gLightPosition.z);
-    glUniform3f(viewPositionLoc2, cameraPosition.x, cameraPosition.y, cameraPosition.z);
-    glUniform2fv(UVScaleLoc, 1, glm::value_ptr(gCayenneUVScale));
+    mt19937 random(330);
+    uniform_real_distribution<float> unit(0.0f, 1.0f);
+    gPointLights.resize(count);
+    for (PointLightSource& light : gPointLights)
+    {
+        light.anchor = low + extent * glm::vec3(unit(random), unit(random), unit(random));
+        light.radius = size * (0.03f + 0.05f * unit(random));
+        float hue = unit(random);
+        light.color = 0.5f + 0.5f * glm::cos(6.2831853f * (hue + glm::vec3(0.0f, 1.0f / 3.0f, 2.0f / 3.0f)));
+        light.phase = 6.2831853f * unit(random);
+    }
+}
 
-    // bind textures on corresponding texture units
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, cayenneTextureId);
 
-    // Draws the triangles
-    glDrawArrays(GL_TRIANGLES, 0, cayenneMesh.nVertices);
-    // ^^ Cayenne Creation ^^
+// Update system: recomputes the scene graph subtrees that moved since the last frame and hands their
+// world transforms to the transform pipeline. Only the orbiting key lamp changes after the first frame
+void UUpdateSceneTransforms()
+{
+    gSceneGraph.SetLocalPosition(gTransformComponents.Get(gKeyLamp).node, gLightPosition);
 
-        // Cayenne Lid Creation!
-    glBindVertexArray(cayenneLidMesh.vao);
+    for (int node : gSceneGraph.Update())
+    {
+        int instance = gSceneGraph.GetObject(node);
+        if (instance < 0)
+            continue;
+        const Transform& world = gSceneGraph.GetWorld(node);
+        gTransforms.Set(instance, world.position, world.rotation, world.scale);
+    }
+}
 
-    // Set the shader to be used
-    glUseProgram(gCubeProgramId);
 
+// Cull system: tests the world-space bounding sphere of every drawable entity against the view frustum,
+// or, when the GPU culls, just lists every drawable entity
+void UCullEntities(bool frustumCull)
+{
+    gVisibleEntities.clear();
 
-    glUniformMatrix4fv(modelLoc2, 1, GL_FALSE, glm::value_ptr(model2));
-    glUniformMatrix4fv(viewLoc2, 1, GL_FALSE, glm::value_ptr(view2));
-    glUniformMatrix4fv(projLoc2, 1, GL_FALSE, glm::value_ptr(projection2));
+    const Bounds* bounds = gBounds.Data();
+    const Entity* entities = gBounds.Entities();
+    for (size_t i = 0; i < gBounds.Size(); ++i)
+    {
+        Entity entity = entities[i];
+        if (!gMaterials.Has(entity) || !gMeshRefs.Has(entity))
+            continue;
+        if (!frustumCull)
+        {
+            gVisibleEntities.push_back(entity);
+            continue;
+        }
 
+        const Transform& world = gSceneGraph.GetWorld(gTransformComponents.Get(entity).node);
+        float maxScale = glm::max(world.scale.x, glm::max(world.scale.y, world.scale.z));
+        glm::vec3 center = world.position + world.rotation * (world.scale * bounds[i].center);
+        if (gCamera.IsSphereVisible(center, bounds[i].radius * maxScale))
+            gVisibleEntities.push_back(entity);
+    }
+}
 
-    // Pass color, light, and camera data to the Cube Shader program's corresponding uniforms
-    glUniform3f(objectColorLoc2, gObjectColor.r, gObjectColor.g, gObjectColor.b);
-    glUniform3f(lightColorLoc2, gLightColor.r, gLightColor.g, gLightColor.b);
-    glUniform3f(lightPositionLoc2, gLightPosition.x, gLightPosition.y, gLightPosition.z);
-    glUniform3f(viewPositionLoc2, cameraPosition.x, cameraPosition.y, cameraPosition.z);
-    glUniform2fv(UVScaleLoc, 1, glm::value_ptr(gCayenneUVScale));
 
-    // bind textures on corresponding texture units
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, tableTextureId);
+// Builds the next frame on the main thread: camera, the matrices of every object, the lights and the
+// list of visible entities. The render thread gets it as a copy, except the matrices: they go straight
+// into instanceRegion, the start of the ring region the frame is drawn from, which the render thread
+// reserved. Nothing here waits for the GPU
+void UBuildFrame(FrameSnapshot& frame, const RingBuffer::Allocation& instanceRegion)
+{
+    ULatchCamera();
+    frame.inputTime = gInput.TakeInputTime();
+    frame.measureLatency = gMeasureLatency;
+    frame.viewportWidth = gFramebufferWidth;
+    frame.viewportHeight = gFramebufferHeight;
+
+    // The camera rebuilds its view and projection only when it moved, zoomed or the framebuffer was resized
+    gCamera.Update();
+    frame.frameData.view = gCamera.GetViewMatrix();
+    frame.frameData.projection = gCamera.GetProjectionMatrix();
+    frame.frameData.viewPosition = glm::vec4(gCamera.Position, 1.0f);
+    const glm::vec4* planes = gCamera.GetFrustumPlanes();
+    for (int i = 0; i < Camera::PLANE_COUNT; ++i)
+        frame.frameData.frustumPlanes[i] = planes[i];
+    frame.frameData.inverseViewProjection = glm::inverse(gCamera.GetViewProjectionMatrix());
+
+    // Model, model-view-projection and normal matrices of every object in one batch
+    UUpdateSceneTransforms();
+    frame.instanceOffset = instanceRegion.data != nullptr ? instanceRegion.offset : -1;
+    frame.instanceCount = gTransforms.Count();
+    if (instanceRegion.data != nullptr)
+        gTransforms.Compute(gCamera.GetViewProjectionMatrix(), (TransformPipeline::InstanceData*)instanceRegion.data, gJobs.ParallelForFunction());
+
+    // Gather the lights the cube shader variants loop over, key light first
+    frame.lightCount = 0;
+    for (size_t i = 0; i < gLights.Size() && frame.lightCount < gActiveLightCount && frame.lightCount < ShaderVariants::MAX_LIGHTS; ++i)
+    {
+        frame.frameData.lightPositions[frame.lightCount] = glm::vec4(gSceneGraph.GetWorld(gTransformComponents.Get(gLights.Entities()[i]).node).position, 1.0f);
+        frame.frameData.lightColors[frame.lightCount] = glm::vec4(gLights.Data()[i].color, 1.0f);
+        ++frame.lightCount;
+    }
 
-    // Draws the triangles
-    glDrawArrays(GL_TRIANGLES, 0, cayenneLidMesh.nVertices);
-    // ^^ Cayenne Lid Creation ^^
+    // Point lights that reach into the view frustum, each on its small circle around its anchor
+    frame.pointLights.clear();
+    for (const PointLightSource& source : gPointLights)
+    {
+        float angle = gPointLightAngle + source.phase;
+        glm::vec3 position = source.anchor + 0.5f * source.radius * glm::vec3(glm::cos(angle), 0.0f, glm::sin(angle));
+        if (gCamera.IsSphereVisible(position, source.radius))
+            frame.pointLights.push_back({ glm::vec4(position, source.radius), glm::vec4(source.color, 1.0f) });
+    }
 
-            // Basil Lid Creation!
-    glBindVertexArray(basilLidMesh.vao);
+    // Clustered path: the lights of every cluster, found on the workers, one depth slice per job
+    frame.lightingPath = gLightingPath;
+    frame.clusters.clear();
+    frame.clusterLightIndices.clear();
+    if (frame.lightingPath == ShaderVariants::PATH_CLUSTERED && !frame.pointLights.empty())
+    {
+        double start = glfwGetTime();
+        gLightGrid.Build(frame.frameData.view, frame.frameData.projection, frame.pointLights.data(), frame.pointLights.size(),
+            sizeof(PointLight), gJobs.ParallelForFunction());
+        gLightGridTime += glfwGetTime() - start;
+        frame.clusters = gLightGrid.Clusters();
+        frame.clusterLightIndices = gLightGrid.LightIndices();
+        ++gLightGridBuilds;
+        gLightGridLights += frame.pointLights.size();
+        gLightGridIndices += frame.clusterLightIndices.size();
+        gLightGridDropped += gLightGrid.DroppedLights();
+    }
+    frame.frameData.clusterParameters = gLightGrid.ShaderParameters(frame.viewportWidth, frame.viewportHeight);
 
-    // Set the shader to be used
-    glUseProgram(gCubeProgramId);
+    // LAMPS: one small cube at every light, as a visual cue for the light source
+    frame.lamps.clear();
+    const Entity* lamps = gLights.Entities();
+    for (size_t i = 0; i < gLights.Size(); ++i)
+    {
+        const MeshRef* meshRef = gMeshRefs.Find(lamps[i]);
+        if (meshRef != nullptr)
+            frame.lamps.push_back({ meshRef->mesh, gTransformComponents.Get(lamps[i]).instance, MaterialComponent(), 0 });
+    }
 
+    // Render system: every drawable entity inside the view frustum, or all of them for the GPU to cull
+    frame.gpuCulling = gGpuCulling;
+    frame.occlusionCulling = gOcclusionCulling;
+    frame.depthPrepass = gDepthPrepass;
+    UCullEntities(!frame.gpuCulling);
+    frame.draws.clear();
+    for (Entity entity : gVisibleEntities)
+    {
+        const MaterialComponent& material = gMaterials.Get(entity);
+        int mesh = gMeshRefs.Get(entity).mesh;
+        frame.draws.push_back({ mesh, gTransformComponents.Get(entity).instance, material, UBatchKey(mesh, material) });
+    }
+    // Draws that share a batch key go out in one multi-draw call, so they have to be neighbours
+    sort(frame.draws.begin(), frame.draws.end(), [](const DrawItem& a, const DrawItem& b) { return a.batchKey < b.batchKey; });
+
+    // The instance and material of every draw, in draw order; the shaders index them with drawIndex
+    frame.drawData.resize(frame.lamps.size() + frame.draws.size());
+    DrawData* drawData = frame.drawData.data();
+    for (const DrawItem& lamp : frame.lamps)
+        *drawData++ = { glm::vec4(0.0f), glm::vec2(0.0f), 0.0f, 0.0f, 0.0f, lamp.instance, { 0.0f, 0.0f } };
+    for (const DrawItem& item : frame.draws)
+    {
+        const GLMaterial& surface = item.material.surface;
+        *drawData++ = { glm::vec4(surface.color, 1.0f), item.material.uvScale, surface.ambientStrength,
+            surface.specularIntensity, surface.highlightSize, item.instance, { 0.0f, 0.0f } };
+    }
+}
 
-    glUniformMatrix4fv(modelLoc2, 1, GL_FALSE, glm::value_ptr(model2));
-    glUniformMatrix4fv(viewLoc2, 1, GL_FALSE, glm::value_ptr(view2));
-    glUniformMatrix4fv(projLoc2, 1, GL_FALSE, glm::value_ptr(projection2));
 
+// The start of the next ring region no frame has begun or reserved, for the matrices of the frame
+// drawn from it; waits until the GPU has finished the frame that used the region last
+RingBuffer::Allocation UReserveInstances()
+{
+    return gFrameRing.Reserve(gTransforms.InstanceBytes());
+}
 
-    // Pass color, light, and camera data to the Cube Shader program's corresponding uniforms
-    glUniform3f(objectColorLoc2, gObjectColor.r, gObjectColor.g, gObjectColor.b);
-    glUniform3f(lightColorLoc2, gLightColor.r, gLightColor.g, gLightColor.b);
-    glUniform3f(lightPositionLoc2, gLightPosition.x, gLightPosition.y, gLightPosition.z);
-    glUniform3f(viewPositionLoc2, cameraPosition.x, cameraPosition.y, cameraPosition.z);
-    glUniform2fv(UVScaleLoc, 1, glm::value_ptr(gUVScale));
 
-    // bind textures on corresponding texture units
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, tableTextureId);
+// Owns the GL context while the main loop runs: draws every frame the main thread publishes and picks up
+// the shader programs as they finish linking
+void URenderThread()
+{
+    glfwMakeContextCurrent(gWindow);
 
-    // Draws the triangles
-    glDrawArrays(GL_TRIANGLES, 0, basilLidMesh.nVertices);
-    // ^^ Basil Lid Creation ^^
+    // Every frame reserves the region of the one after it before it is taken, as the main thread starts
+    // that frame right away. Its wait for the GPU is the one the frame pacer makes for this frame
+    while (const FrameSnapshot* frame = gFrameMailbox.Take(UReserveInstances()))
+    {
+        URender(*frame);
 
+        // Adopt the meshes and textures the upload thread has finished; they are drawn from the next frame
+        int pendingUploads = gUploader.Poll();
+        if (gSceneStartTime >= 0.0 && pendingUploads == 0 && gTextureDecodes.IsDone())
+        {
+            cout << "INFO: Scene resident in " << (glfwGetTime() - gSceneStartTime) * 1000.0 << " ms" << endl;
+            UReportGeometryStats();
+            gSceneStartTime = -1.0;
+        }
+        // Compaction moves ranges the upload thread may be writing into, so only while it is idle
+        if (pendingUploads == 0 && gGeometry.NeedsCompaction(0.25))
+            UCompactGeometry();
 
-                // Mug Creation!
-    glBindVertexArray(mugMesh.vao);
+        // Pick up programs the driver has finished linking, including variants requested by this frame
+        int pendingPrograms = gProgramBatch.Poll();
+        if (gShaderStartTime >= 0.0 && pendingPrograms == 0)
+        {
+            cout << "INFO: Shader programs ready in " << (glfwGetTime() - gShaderStartTime) * 1000.0 << " ms ("
+                << gProgramCache.Hits << " from cache, " << gProgramCache.Misses << " compiled"
+                << (gProgramBatch.IsParallel() ? ", parallel" : "") << ")" << endl;
+            gShaderStartTime = -1.0;
+        }
+        if (gProgramBatch.Failed())
+        {
+            gRenderFailed = true;
+            gFrameMailbox.Close();
+        }
+    }
 
-    // Set the shader to be used
-    glUseProgram(gCubeProgramId);
-    glUniformMatrix4fv(modelLoc2, 1, GL_FALSE, glm::value_ptr(model2));
-    glUniformMatrix4fv(viewLoc2, 1, GL_FALSE, glm::value_ptr(view2));
-    glUniformMatrix4fv(projLoc2, 1, GL_FALSE, glm::value_ptr(projection2));
+    glfwMakeContextCurrent(NULL);
+}
 
-    // Pass color, light, and camera data to the Cube Shader program's corresponding uniforms
-    glUniform3f(objectColorLoc2, gObjectColor.r, gObjectColor.g, gObjectColor.b);
-    glUniform3f(lightColorLoc2, gLightColor.r, gLightColor.g, gLightColor.b);
-    glUniform3f(lightPositionLoc2, gLightPosition.x, gLightPosition.y, gLightPosition.z);
-    glUniform3f(viewPositionLoc2, cameraPosition.x, cameraPosition.y, cameraPosition.z);
-    glUniform2fv(UVScaleLoc, 1, glm::value_ptr(gUVScale));
 
-    // bind textures on corresponding texture units
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, basilLidTextureId);
+void URender(const FrameSnapshot& frame)
+{
+    // Wait while the GPU is two frames behind; this frame's region of the ring buffer is free after that
+    gFramePacer.BeginFrame();
+    gFrameRing.BeginFrame();
+    if (frame.measureLatency != gFramePacer.IsMeasuringLatency())
+        gFramePacer.EnableLatencyMeasurement(frame.measureLatency);
+    gFramePacer.SetInputTime(frame.inputTime);
+
+    if (frame.viewportWidth != gViewportWidth || frame.viewportHeight != gViewportHeight)
+    {
+        glViewport(0, 0, frame.viewportWidth, frame.viewportHeight);
+        gHiZ.Resize(frame.viewportWidth, frame.viewportHeight);
+        if (!gGBuffer.Resize(frame.viewportWidth, frame.viewportHeight) && frame.viewportWidth > 0 && frame.viewportHeight > 0)
+            cout << "ERROR::GBUFFER::INCOMPLETE " << frame.viewportWidth << "x" << frame.viewportHeight << endl;
+        gViewportWidth = frame.viewportWidth;
+        gViewportHeight = frame.viewportHeight;
+    }
 
-    // Draws the triangles
-    glDrawArrays(GL_TRIANGLES, 0, mugMesh.nVertices);
-    // ^^ Mug Creation ^^
+    // The deferred and clustered paths wait for the cube variants of the frame's materials, which
+    // compile in the meantime, and the deferred path for its lighting programs too; the frames until
+    // then are drawn forward
+    ShaderVariants::Path path = frame.lightingPath;
+    if (path != ShaderVariants::PATH_FORWARD && !UCubeVariantsReady(frame, path))
+        path = ShaderVariants::PATH_FORWARD;
+    if (path == ShaderVariants::PATH_DEFERRED && !(gGBuffer.IsComplete()
+        && gProgramBatch.IsReady(gResolveProgramId) && gProgramBatch.IsReady(gLightVolumeProgramId)))
+        path = ShaderVariants::PATH_FORWARD;
+    gPassStats.BeginFrame(gFramePacer.FrameSlot(), frame.viewportWidth * frame.viewportHeight,
+        frame.depthPrepass && gProgramBatch.IsReady(gDepthProgramId), path, ShaderVariants::PathName(path));
 
-    // Table Creation!
-    glBindVertexArray(tableMesh.vao);
+    // Enable z-depth
+    glEnable(GL_DEPTH_TEST);
 
-    // Set the shader to be used
-    glUseProgram(gCubeProgramId);
+    // Clear the frame and z buffers
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+    // The camera, the lights, the matrices and the draw data of the frame are written straight into
+    // this frame's region of the ring buffer and bound from there: no glBufferSubData, no per-draw uniforms
+    // besides the draw index. A frame that does not fit is not drawn
+    bool resident = false;
+    RingBuffer::Allocation frameData = gFrameRing.Allocate(sizeof(FrameData), gFrameRing.UniformAlignment());
+    if (frameData.data != nullptr)
+    {
+        memcpy(frameData.data, &frame.frameData, sizeof(FrameData));
+        glBindBufferRange(GL_UNIFORM_BUFFER, 0, gFrameRing.Buffer(), frameData.offset, frameData.size);
+        resident = frame.instanceOffset >= 0;
+        if (resident)
+            gTransforms.Bind(gFrameRing, frame.instanceOffset, frame.instanceCount);
+    }
+    if (resident && !frame.drawData.empty())
+    {
+        GLsizeiptr size = (GLsizeiptr)(frame.drawData.size() * sizeof(DrawData));
+        RingBuffer::Allocation drawData = gFrameRing.Allocate(size, gFrameRing.StorageAlignment());
+        resident = drawData.data != nullptr;
+        if (resident)
+        {
+            memcpy(drawData.data, frame.drawData.data(), size);
+            glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 2, gFrameRing.Buffer(), drawData.offset, drawData.size);
+        }
+    }
+    // The point lights go out with the deferred and clustered paths only; without room for them the
+    // frame has none
+    GLsizei pointLightCount = 0;
+    if (resident && path != ShaderVariants::PATH_FORWARD && !frame.pointLights.empty())
+    {
+        GLsizeiptr size = (GLsizeiptr)(frame.pointLights.size() * sizeof(PointLight));
+        RingBuffer::Allocation pointLights = gFrameRing.Allocate(size, gFrameRing.StorageAlignment());
+        if (pointLights.data != nullptr)
+        {
+            memcpy(pointLights.data, frame.pointLights.data(), size);
+            glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 6, gFrameRing.Buffer(), pointLights.offset, pointLights.size);
+            pointLightCount = (GLsizei)frame.pointLights.size();
+        }
+    }
+    // and the clustered path their grid; a frame without lights or room for the grid is drawn forward
+    if (resident && path == ShaderVariants::PATH_CLUSTERED)
+    {
+        GLsizeiptr clusterSize = (GLsizeiptr)(frame.clusters.size() * sizeof(LightGrid::Cluster));
+        GLsizeiptr indexSize = (GLsizeiptr)(max<size_t>(frame.clusterLightIndices.size(), 1) * sizeof(GLuint));
+        RingBuffer::Allocation clusters = gFrameRing.Allocate(clusterSize, gFrameRing.StorageAlignment());
+        RingBuffer::Allocation indices = gFrameRing.Allocate(indexSize, gFrameRing.StorageAlignment());
+        if (pointLightCount > 0 && clusterSize > 0 && clusters.data != nullptr && indices.data != nullptr)
+        {
+            memcpy(clusters.data, frame.clusters.data(), clusterSize);
+            memcpy(indices.data, frame.clusterLightIndices.data(), frame.clusterLightIndices.size() * sizeof(GLuint));
+            glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 7, gFrameRing.Buffer(), clusters.offset, clusters.size);
+            glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 8, gFrameRing.Buffer(), indices.offset, indices.size);
+        }
+        else
+            path = ShaderVariants::PATH_FORWARD;
+    }
 
-    glUniformMatrix4fv(modelLoc2, 1, GL_FALSE, glm::value_ptr(model2));
-    glUniformMatrix4fv(viewLoc2, 1, GL_FALSE, glm::value_ptr(view2));
-    glUniformMatrix4fv(projLoc2, 1, GL_FALSE, glm::value_ptr(projection2));
+    if (resident && path == ShaderVariants::PATH_DEFERRED)
+    {
+        // Surfaces into the G-buffer, then its depth into the window for the light volumes and the lamps
+        glBindFramebuffer(GL_FRAMEBUFFER, gGBuffer.Framebuffer());
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        UDrawObjects(frame, ShaderVariants::PATH_DEFERRED);
+        gGBuffer.BlitDepth();
+        ULightGBuffer(frame, pointLightCount);
+        UDrawLamps(frame);
+    }
+    else if (resident)
+    {
+        UDrawLamps(frame);
+        UDrawObjects(frame, path);
+    }
 
+    // Deactivate the Vertex Array Object and shader program
+    glBindVertexArray(0);
+    gBoundVertexArray = 0;
+
+    // Reduce this frame's depth for the occlusion test of the next frame. A pyramid that was not kept
+    // up to date is dropped; the next frame then culls by the frustum only
+    if (frame.gpuCulling && frame.occlusionCulling && gProgramBatch.IsReady(gHiZProgramId))
+        gHiZ.Build(gHiZProgramId, frame.frameData.projection * frame.frameData.view);
+    else
+        gHiZ.Invalidate();
+    glUseProgram(0);
 
-    // Pass color, light, and camera data to the Cube Shader program's corresponding uniforms
-    glUniform3f(objectColorLoc2, gObjectColor.r, gObjectColor.g, gObjectColor.b);
-    glUniform3f(lightColorLoc2, gLightColor.r, gLightColor.g, gLightColor.b);
-    glUniform3f(lightPositionLoc2, gLightPosition.x, gLightPosition.y, gLightPosition.z);
-    glUniform3f(viewPositionLoc2, cameraPosition.x, cameraPosition.y, cameraPosition.z);
-    glUniform2fv(UVScaleLoc, 1, glm::value_ptr(gTableUVScale));
+    // glfw: swap buffers; the main thread polls the IO events
+    glfwSwapBuffers(gWindow);    // Flips the the back buffer with the front buffer every frame.
+    gFramePacer.EndFrame();
+    gFrameRing.EndFrame();
+}
 
-    // bind textures on corresponding texture units
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, tableTextureId);
 
-    // Draws the triangles
-    glDrawArrays(GL_TRIANGLES, 0, tableMesh.nVertices);
-    // ^^ Table Creation ^^
+// LAMPS: draws a small unlit cube at every light. Programs that are still compiling are skipped; their
+// objects show up once they are linked
+void UDrawLamps(const FrameSnapshot& frame)
+{
+    if (!gProgramBatch.IsReady(gLampProgramId))
+        return;
+    glUseProgram(gLampProgramId);
 
-    // Pad Creation!
-    glBindVertexArray(padMesh.vao);
-    // Set the shader to be used
-    glUseProgram(gCubeProgramId);
+    for (size_t i = 0; i < frame.lamps.size(); ++i)
+    {
+        const GLMesh& mesh = gMeshes[frame.lamps[i].mesh];
+        if (!mesh.resident)
+            continue;
 
-    glUniformMatrix4fv(modelLoc2, 1, GL_FALSE, glm::value_ptr(model2));
-    glUniformMatrix4fv(viewLoc2, 1, GL_FALSE, glm::value_ptr(view2));
-    glUniformMatrix4fv(projLoc2, 1, GL_FALSE, glm::value_ptr(projection2));
+        // The lamps come first in the draw data
+        UBindMesh(mesh);
+        UDrawMesh(mesh, (GLuint)i);
+    }
+}
 
-    // Pass color, light, and camera data to the Cube Shader program's corresponding uniforms
-    glUniform3f(objectColorLoc2, gObjectColor.r, gObjectColor.g, gObjectColor.b);
-    glUniform3f(lightColorLoc2, gLightColor.r, gLightColor.g, gLightColor.b);
-    glUniform3f(lightPositionLoc2, gLightPosition.x, gLightPosition.y, gLightPosition.z);
-    glUniform3f(viewPositionLoc2, cameraPosition.x, cameraPosition.y, cameraPosition.z);
-    glUniform2fv(UVScaleLoc, 1, glm::value_ptr(gCayenneUVScale));
 
-    // bind textures on corresponding texture units
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, padTextureId);
+// Sort key of a draw: the cube shader variant first, then the texture, then the vertex layout, so a
+// frame's draws fall into runs that one multi-draw call each can submit
+uint64_t UBatchKey(int mesh, const MaterialComponent& material)
+{
+    const GLMaterial& surface = material.surface;
+    uint64_t texture = surface.textured ? (uint64_t)(uint32_t)(material.texture + 1) : 0;
+    return ((uint64_t)surface.specular << 41) | ((uint64_t)surface.textured << 40) | (texture << 8) | gMeshes[mesh].layout;
+}
 
-    // Draws the triangles
-    glDrawArrays(GL_TRIANGLES, 0, padMesh.nVertices);
-    // ^^ Hot pad Creation ^^
 
+// True when the cube shader variants of all the frame's materials are linked for the path. Asking for
+// them starts the compilation of the missing ones, so they are all under way after the first call
+bool UCubeVariantsReady(const FrameSnapshot& frame, ShaderVariants::Path path)
+{
+    bool ready = true;
+    size_t drawCount = frame.draws.size();
+    for (size_t first = 0, last = 0; first < drawCount; first = last)
+    {
+        while (last < drawCount && frame.draws[last].batchKey == frame.draws[first].batchKey)
+            ++last;
 
-    // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-    glfwSwapBuffers(gWindow);    // Flips the the back buffer with the front buffer every frame.
+        const GLMaterial& material = frame.draws[first].material.surface;
+        if (gCubeShaders.Get(frame.lightCount, material.textured, material.specular, path) == 0)
+            ready = false;
+    }
+    return ready;
 }
 
 
-
-
-void UCreateCubeMesh(GLMesh& mesh, GLCoord top, GLfloat height, GLfloat width)
+// Draws the frame's entities with the cheapest cube shader variants their materials need: one
+// glMultiDrawElementsIndirect call per run of draws with the same batch key, whatever the number of
+// objects. A command's base instance is its draw's DrawData entry. With GPU culling the draws are
+// candidates for the cull pass, which writes the commands of the visible ones; otherwise the commands
+// are written into the frame's region of the ring buffer here. With the depth pre-pass the same
+// commands lay down the depth first, and the shading pass only lights the fragments that are equal to
+// it. Deferred, the variants write the surfaces into the bound G-buffer instead of lighting them;
+// clustered, they add the point lights of the light grid bound with the frame. Entities whose variant
+// is still compiling, or whose mesh or texture is still uploading, are left out for this frame
+void UDrawObjects(const FrameSnapshot& frame, ShaderVariants::Path path)
 {
-    // Position and Texture data
-    GLfloat verts[] = {
-        // ------------------------------------------------------
-        //Back Face                                          //Negative Z Normal  Texture Coords.
-       top.x - (width / 2), top.y - height, top.z - (width/2),  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
-        top.x + (width / 2), top.y - height, top.z - (width / 2),  0.0f,  0.0f, -1.0f,  1.0f, 0.0f,
-        top.x + (width / 2),  top.y, top.z - (width / 2),  0.0f,  0.0f, -1.0f,  0.5f, 1.0f,
-        top.x + (width / 2),  top.y, top.z - (width / 2),  0.0f,  0.0f, -1.0f,  0.5f, 1.0f,
-       top.x - (width / 2),  top.y, top.z - (width / 2),  0.0f,  0.0f, -1.0f,  0.0f, 1.0f,
-       top.x - (width / 2), top.y - height, top.z - (width / 2),  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
-
-       //Front Face                                              //Positive Z Normal
-      top.x - (width / 2), top.y - height,  top.z + (width / 2),  0.0f,  0.0f,  1.0f,  0.0f, 0.0f,
-       top.x + (width / 2), top.y - height,  top.z + (width / 2),  0.0f,  0.0f,  1.0f,  1.0f, 0.0f,
-       top.x + (width / 2),  top.y,  top.z + (width / 2),  0.0f,  0.0f,  1.0f,  0.5f, 1.0f,
-       top.x + (width / 2),  top.y,  top.z + (width / 2),  0.0f,  0.0f,  1.0f,  0.5f, 1.0f,
-      top.x - (width / 2),  top.y,  top.z + (width / 2),  0.0f,  0.0f,  1.0f,  0.0f, 1.0f,
-      top.x - (width / 2), top.y - height,  top.z + (width / 2),  0.0f,  0.0f,  1.0f,  0.0f, 0.0f,
-
-      //Left Face                                                //Negative X Normal
-     top.x - (width / 2),  top.y,  top.z + (width / 2), -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
-     top.x - (width / 2),  top.y, top.z - (width / 2), -1.0f,  0.0f,  0.0f,  0.5f, 1.0f,
-     top.x - (width / 2), top.y - height, top.z - (width / 2), -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
-     top.x - (width / 2), top.y - height, top.z - (width / 2), -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
-     top.x - (width / 2), top.y - height,  top.z + (width / 2), -1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
-     top.x - (width / 2),  top.y,  top.z + (width / 2), -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
-
-     //Right Face                                              //Positive X Normal
-     top.x + (width / 2),  top.y,  top.z + (width / 2),  1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
-     top.x + (width / 2),  top.y, top.z - (width / 2),  1.0f,  0.0f,  0.0f,  0.5f, 1.0f,
-     top.x + (width / 2), top.y - height, top.z - (width / 2),  1.0f,  0.0f,  0.0f,  1.0f, 0.0f,  //Bottom Front?
-     top.x + (width / 2), top.y - height, top.z - (width / 2),  1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
-     top.x + (width / 2), top.y - height,  top.z + (width / 2),  1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
-     top.x + (width / 2),  top.y,  top.z + (width / 2),  1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
-
-     //Bottom Face                                             //Negative Y Normal
-    top.x - (width / 2), top.y - height, top.z - (width / 2),  0.0f, -1.0f,  0.0f,  0.0f, 1.0f,
-     top.x + (width / 2), top.y - height, top.z - (width / 2),  0.0f, -1.0f,  0.0f,  1.0f, 1.0f,
-     top.x + (width / 2), top.y - height,  top.z + (width / 2),  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
-     top.x + (width / 2), top.y - height,  top.z + (width / 2),  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
-    top.x - (width / 2), top.y - height,  top.z + (width / 2),  0.0f, -1.0f,  0.0f,  0.0f, 0.0f,
-    top.x - (width / 2), top.y - height, top.z - (width / 2),  0.0f, -1.0f,  0.0f,  0.0f, 1.0f,
-
-    //Top Face                                                 //Positive Y Normal
-   top.x - (width / 2),  top.y, top.z - (width / 2),  0.0f,  1.0f,  0.0f,  0.0f, 1.0f,
-    top.x + (width / 2),  top.y, top.z - (width / 2),  0.0f,  1.0f,  0.0f,  1.0f, 1.0f,
-    top.x + (width / 2),  top.y,  top.z + (width / 2),  0.0f,  1.0f,  0.0f,  1.0f, 0.0f,
-    top.x + (width / 2),  top.y,  top.z + (width / 2),  0.0f,  1.0f,  0.0f,  1.0f, 0.0f,
-   top.x - (width / 2),  top.y,  top.z + (width / 2),  0.0f,  1.0f,  0.0f,  0.0f, 0.0f,
-   top.x - (width / 2),  top.y, top.z - (width / 2),  0.0f,  1.0f,  0.0f,  0.0f, 1.0f
-    };
-
-    const GLuint floatsPerVertex = 3;
-    const GLuint floatsPerNormal = 3;
-    const GLuint floatsPerUV = 2;
+    size_t drawCount = frame.draws.size();
+    if (drawCount == 0)
+        return;
 
-    mesh.nVertices = sizeof(verts) / (sizeof(verts[0]) * (floatsPerVertex + floatsPerNormal + floatsPerUV));
+    // The batches and the state they need; batches that cannot be drawn yet get no commands
+    gDrawBatches.clear();
+    for (size_t first = 0, last = 0; first < drawCount; first = last)
+    {
+        while (last < drawCount && frame.draws[last].batchKey == frame.draws[first].batchKey)
+            ++last;
+
+        const MaterialComponent& materialComponent = frame.draws[first].material;
+        const GLMaterial& material = materialComponent.surface;
+        GLuint textureId = material.textured && materialComponent.texture >= 0 ? gTextures[materialComponent.texture] : 0;
+        if (material.textured && textureId == 0)
+            continue;
+        GLuint programId = gCubeShaders.Get(frame.lightCount, material.textured, material.specular, path);
+        if (programId != 0)
+            gDrawBatches.push_back({ first, last, programId, textureId, 0, 0, false });
+    }
 
-    glGenVertexArrays(1, &mesh.vao); // we can also generate multiple VAOs or buffers at the same time
-    glBindVertexArray(mesh.vao);
+    // One command slot per draw, in draw order; each batch owns the slots of its draws
+    GLuint firstDrawIndex = (GLuint)frame.lamps.size();    // the lamps come first in the draw data
+    bool gpuCulling = frame.gpuCulling && gProgramBatch.IsReady(gCullProgramId);
+    GLsizeiptr recordSize = gpuCulling ? sizeof(DrawCuller::Candidate) : sizeof(DrawElementsIndirectCommand);
+    RingBuffer::Allocation allocation = gFrameRing.Allocate((GLsizeiptr)drawCount * recordSize, gpuCulling ? gFrameRing.StorageAlignment() : sizeof(GLuint));
+    if (allocation.data == nullptr)
+        return;
+    DrawCuller::Candidate* candidates = (DrawCuller::Candidate*)allocation.data;
+    DrawElementsIndirectCommand* commands = (DrawElementsIndirectCommand*)allocation.data;
+
+    GLuint recordCount = 0;
+    for (size_t b = 0; b < gDrawBatches.size(); ++b)
+    {
+        DrawBatch& batch = gDrawBatches[b];
+        batch.firstCommand = recordCount;
+        for (size_t i = batch.first; i < batch.last; ++i)
+        {
+            const GLMesh& mesh = gMeshes[frame.draws[i].mesh];
+            if (!mesh.resident)
+                continue;
+            if (mesh.nIndices == 0)
+            {
+                // the scene converter indexes every mesh; others are drawn one by one, unculled
+                batch.unindexed = true;
+                continue;
+            }
+            GLuint drawIndex = firstDrawIndex + (GLuint)i;
+            if (gpuCulling)
+                candidates[recordCount++] = { glm::vec4(mesh.boundsCenter, mesh.boundsRadius), mesh.nIndices, mesh.firstIndex, mesh.baseVertex,
+                    drawIndex, (GLuint)frame.draws[i].instance, (GLuint)b, batch.firstCommand, 0 };
+            else
+                commands[recordCount++] = { mesh.nIndices, 1, mesh.firstIndex, mesh.baseVertex, drawIndex };
+        }
+        batch.commandCount = (GLsizei)(recordCount - batch.firstCommand);
+    }
 
-    // Create buffer for vertex data
-    glGenBuffers(1, &mesh.vbos[0]);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbos[0]); // Activates the buffer
-    glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
+    // The cull pass packs each batch's visible draws at the front of its slots and empties the rest
+    GLuint indirectBuffer = gFrameRing.Buffer();
+    GLintptr indirectOffset = allocation.offset;
+    if (gpuCulling && recordCount > 0)
+    {
+        if (!gCuller.Cull(gCullProgramId, gFrameRing.Buffer(), allocation.offset, recordCount, recordCount, (GLuint)gDrawBatches.size(),
+            frame.occlusionCulling ? &gHiZ : nullptr))
+            return;
+        indirectBuffer = gCuller.CommandBuffer();
+        indirectOffset = 0;
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
 
-    // Strides between vertex coordinates is all the data required to plot one vertex
-    GLint stride = sizeof(float) * (floatsPerVertex + floatsPerNormal + floatsPerUV);
+    // The depth is final after the pre-pass, so the shading pass neither writes nor moves it
+    bool depthPrepass = frame.depthPrepass && gProgramBatch.IsReady(gDepthProgramId);
+    if (depthPrepass)
+    {
+        UDrawDepthPrepass(frame, indirectOffset);
+        glDepthFunc(GL_EQUAL);
+        glDepthMask(GL_FALSE);
+    }
 
-    // Create Vertex Attribute Pointers
-    glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
-    glEnableVertexAttribArray(0);
+    gPassStats.Begin(RenderPassStats::SHADING_TIME);
+    gPassStats.Begin(RenderPassStats::SHADED_SAMPLES);
+    for (const DrawBatch& batch : gDrawBatches)
+    {
+        if (batch.commandCount == 0 && !batch.unindexed)
+            continue;
 
-    glVertexAttribPointer(1, floatsPerNormal, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * floatsPerVertex));
-    glEnableVertexAttribArray(1);
+        // Matrices and material come from each draw's DrawData entry, camera and lights from FrameData
+        glUseProgram(batch.programId);
+        UBindMesh(gMeshes[frame.draws[batch.first].mesh]);
+        if (batch.textureId != 0)
+        {
+            // bind textures on corresponding texture units
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, batch.textureId);
+        }
 
-    glVertexAttribPointer(2, floatsPerUV, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * (floatsPerVertex + floatsPerNormal)));
-    glEnableVertexAttribArray(2);
+        // Draws the triangles of the whole run
+        if (batch.commandCount > 0)
+        {
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                (const void*)(indirectOffset + batch.firstCommand * sizeof(DrawElementsIndirectCommand)), batch.commandCount, 0);
+            ++gDrawCalls;
+            gDrawnObjects += batch.commandCount;
+        }
+        if (batch.unindexed)
+        {
+            for (size_t i = batch.first; i < batch.last; ++i)
+            {
+                const GLMesh& mesh = gMeshes[frame.draws[i].mesh];
+                if (mesh.resident && mesh.nIndices == 0)
+                {
+                    UDrawMesh(mesh, firstDrawIndex + (GLuint)i);
+                    ++gDrawCalls;
+                    ++gDrawnObjects;
+                }
+            }
+        }
+    }
+    gPassStats.End(RenderPassStats::SHADED_SAMPLES);
+    gPassStats.End(RenderPassStats::SHADING_TIME);
+    if (depthPrepass)
+    {
+        glDepthFunc(GL_LESS);
+        glDepthMask(GL_TRUE);
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    ++gDrawFrames;
 }
 
 
-void UCreatePyramidMesh(GLMesh& mesh, GLCoord top, GLfloat height, GLfloat width)
+// Writes the depth of the batches UDrawObjects has set up, from the commands bound as the indirect
+// buffer, with the depth program and no color writes. The program does not depend on the material, so
+// neighbouring batches of one vertex layout go out in one multi-draw call, through the layout's depth
+// vertex array, which reads the position stream only
+void UDrawDepthPrepass(const FrameSnapshot& frame, GLintptr indirectOffset)
 {
-    // Position and Texture data
-    GLfloat verts[] = {
-
-        //Back Face                                              //Negative Z Normal  Texture Coords.
-       top.x - (width / 2), top.y - height, top.z - (width / 2),  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
-        top.x + (width / 2), top.y - height, top .z - (width / 2),  0.0f,  0.0f, -1.0f,  1.0f, 0.0f,
-        top.x,  top.y, top.z,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
-
-       //Front Face                                             //Positive Z Normal
-      top.x - (width / 2), top.y - height,  top.z + (width / 2),  0.0f,  0.0f,  1.0f,  0.0f, 0.0f,
-       top.x + (width / 2), top.y - height,  top.z + (width / 2),  0.0f,  0.0f,  1.0f,  1.0f, 0.0f,
-       top.x,  top.y,  top.z,  0.0f,  0.0f,  1.0f,  1.0f, 1.0f,
-
-      //Left Face                          //Negative X Normal
-     top.x,  top.y,  top.z, -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
-     top.x - (width / 2),  top.y - height, top.z + (width / 2), -1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
-     top.x - (width / 2), top.y - height, top.z - (width / 2), -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
-     
-     //Right Face                                           //Positive X Normal
-     top.x + (width / 2), top.y - height, top.z - (width / 2),  1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
-     top.x + (width / 2), top.y - height,  top.z + (width / 2),  1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
-     top.x,  top.y,  top.z,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
-
-     //Bottom Face                                          //Negative Y Normal
-    top.x - (width / 2), top.y - height, top.z - (width / 2),  0.0f, -1.0f,  0.0f,  0.0f, 1.0f,
-     top.x + (width / 2), top.y - height, top.z - (width / 2),  0.0f, -1.0f,  0.0f,  1.0f, 1.0f,
-     top.x + (width / 2), top.y - height,  top.z + (width / 2),  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
-     top.x + (width / 2), top.y - height,  top.z + (width / 2),  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
-    top.x - (width / 2), top.y - height,  top.z + (width / 2),  0.0f, -1.0f,  0.0f,  0.0f, 0.0f,
-    top.x - (width / 2), top.y - height, top.z - (width / 2),  0.0f, -1.0f,  0.0f,  0.0f, 1.0f
-    };
-
-    const GLuint floatsPerVertex = 3;
-    const GLuint floatsPerNormal = 3;
-    const GLuint floatsPerUV = 2;
+    gPassStats.Begin(RenderPassStats::PREPASS_TIME);
+    glUseProgram(gDepthProgramId);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
 
-    mesh.nVertices = sizeof(verts) / (sizeof(verts[0]) * (floatsPerVertex + floatsPerNormal + floatsPerUV));
+    GLuint firstDrawIndex = (GLuint)frame.lamps.size();
+    for (size_t first = 0, last = 0; first < gDrawBatches.size(); first = last)
+    {
+        // the batches' commands follow each other, so a run of batches is one range of commands
+        GLuint layout = gMeshes[frame.draws[gDrawBatches[first].first].mesh].layout;
+        GLsizei commandCount = 0;
+        while (last < gDrawBatches.size() && gMeshes[frame.draws[gDrawBatches[last].first].mesh].layout == layout)
+            commandCount += gDrawBatches[last++].commandCount;
+
+        GLuint vertexArray = gGeometry.DepthVertexArray(layout);
+        if (vertexArray != gBoundVertexArray)
+        {
+            glBindVertexArray(vertexArray);
+            gBoundVertexArray = vertexArray;
+        }
+        if (commandCount > 0)
+        {
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                (const void*)(indirectOffset + gDrawBatches[first].firstCommand * sizeof(DrawElementsIndirectCommand)), commandCount, 0);
+            ++gDrawCalls;
+        }
+        for (size_t b = first; b < last; ++b)
+        {
+            if (!gDrawBatches[b].unindexed)
+                continue;
+            for (size_t i = gDrawBatches[b].first; i < gDrawBatches[b].last; ++i)
+            {
+                const GLMesh& mesh = gMeshes[frame.draws[i].mesh];
+                if (mesh.resident && mesh.nIndices == 0)
+                {
+                    UDrawMesh(mesh, firstDrawIndex + (GLuint)i);
+                    ++gDrawCalls;
+                }
+            }
+        }
+    }
 
-    glGenVertexArrays(1, &mesh.vao); // we can also generate multiple VAOs or buffers at the same time
-    glBindVertexArray(mesh.vao);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    gPassStats.End(RenderPassStats::PREPASS_TIME);
+}
 
-    // Create buffer for the vertex data
-    glGenBuffers(1, &mesh.vbos[0]);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbos[0]); // Activates the buffer
-    glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
 
-    GLint stride = sizeof(float) * (floatsPerVertex + floatsPerNormal + floatsPerUV);
+// Deferred path: lights the G-buffer into the window's framebuffer. A full-screen pass applies the
+// scene's lights, ambient included, to every covered pixel; then each point light adds its share
+// through its volume, the back faces of a cube around its range, drawn where they lie behind the
+// G-buffer's depth and blended additively. A point light costs the pixels its volume covers, whatever
+// the number of objects. Depth clamping keeps the back faces that reach past the far plane
+void ULightGBuffer(const FrameSnapshot& frame, GLsizei pointLightCount)
+{
+    gPassStats.Begin(RenderPassStats::LIGHTING_TIME);
+    gGBuffer.BindTextures();
+    glBindVertexArray(gEmptyVertexArray);
+    gBoundVertexArray = gEmptyVertexArray;
+
+    glDisable(GL_DEPTH_TEST);
+    glUseProgram(gResolveProgramId);
+    glUniform1i(glGetUniformLocation(gResolveProgramId, "lightCount"), frame.lightCount);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glEnable(GL_DEPTH_TEST);
 
-    // Create Vertex Attribute Pointers
-    glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
-    glEnableVertexAttribArray(0);
+    if (pointLightCount > 0)
+    {
+        glDepthFunc(GL_GEQUAL);
+        glDepthMask(GL_FALSE);
+        glEnable(GL_DEPTH_CLAMP);
+        glEnable(GL_CULL_FACE);
+        glCullFace(GL_FRONT);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+
+        glUseProgram(gLightVolumeProgramId);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, 36, pointLightCount);
+        ++gDrawCalls;
+
+        glDisable(GL_BLEND);
+        glCullFace(GL_BACK);
+        glDisable(GL_CULL_FACE);
+        glDisable(GL_DEPTH_CLAMP);
+        glDepthMask(GL_TRUE);
+        glDepthFunc(GL_LESS);
+    }
+    gPassStats.End(RenderPassStats::LIGHTING_TIME);
+}
 
-    glVertexAttribPointer(1, floatsPerNormal, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * floatsPerVertex));
-    glEnableVertexAttribArray(1);
 
-    glVertexAttribPointer(2, floatsPerUV, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * (floatsPerVertex + floatsPerNormal)));
-    glEnableVertexAttribArray(2);
+void UReportDrawStats()
+{
+    if (gDrawFrames == 0)
+        return;
+    // with GPU culling the objects are the candidates; the culled ones draw nothing
+    cout << "INFO: Draw submission: " << (double)gDrawCalls / gDrawFrames << " draw calls for "
+        << (double)gDrawnObjects / gDrawFrames << " objects per frame" << endl;
 }
 
-void UCreatePlaneMesh(GLMesh& mesh, GLCoord bl, GLCoord br, GLCoord fl, GLCoord fr)
+
+// Prints what building the light grid cost the main thread and how full the grid was, over the
+// frames of the clustered path
+void UReportLightGridStats()
 {
-    // Position and Vertex data
-    GLfloat verts[] = {
-       //Coordinates       // Normals         //Texture Coords.
-       bl.x, bl.y, bl.z,  0.0f, -1.0f,  0.0f,  0.0f, 1.0f,    //Back Left
-       br.x, br.y, br.z,  0.0f, -1.0f,  0.0f,  1.0f, 1.0f,    //Back Right
-       fr.x, fr.y,  fr.z,  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,	 //Front Right
-       fr.x, fr.y,  fr.z,  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,	 //Front Right
-       fl.x, fl.y,  fl.z,  0.0f, -1.0f,  0.0f,  0.0f, 0.0f,	 //Front Left
-       bl.x, bl.y, bl.z,  0.0f, -1.0f,  0.0f,  0.0f, 1.0f	 //Back Left
-    };
+    if (gLightGridBuilds == 0)
+        return;
+    cout << "INFO: Light grid: " << gLightGridTime * 1000.0 / gLightGridBuilds << " ms per build for "
+        << (double)gLightGridLights / gLightGridBuilds << " point lights, " << (double)gLightGridIndices / gLightGridBuilds
+        << " light indices in " << LightGrid::CLUSTER_COUNT << " clusters, " << (double)gLightGridDropped / gLightGridBuilds
+        << " dropped per frame" << endl;
+}
 
-    const GLuint floatsPerVertex = 3;
-    const GLuint floatsPerNormal = 3;
-    const GLuint floatsPerUV = 2;
 
-    mesh.nVertices = sizeof(verts) / (sizeof(verts[0]) * (floatsPerVertex + floatsPerNormal + floatsPerUV));
+// Uploads a mesh of a scene file on the upload thread, into ranges of gGeometry's buffers reserved
+// here. The vertex and index bytes are handed to the driver straight from the file mapping, which the
+// upload keeps alive until then. The buffers and vertex arrays already exist, so the render thread only
+// marks the mesh resident once the GPU has the data
+void ULoadMesh(int meshIndex, const shared_ptr<FileData>& file, const SceneFormat::SceneView& scene, const SceneFormat::MeshRecord& record)
+{
+    GLMesh& mesh = gMeshes[meshIndex];
+    mesh.layout = record.layout;
+    mesh.nVertices = record.vertexCount;
+    mesh.nIndices = record.indexCount;
+    mesh.boundsCenter = glm::make_vec3(record.boundsCenter);
+    mesh.boundsRadius = record.boundsRadius;
+
+    GeometryPool::Allocation allocation;
+    if (!gGeometry.Allocate(mesh.layout, mesh.nVertices, mesh.nIndices, allocation))
+    {
+        cout << "ERROR::GEOMETRY::OUT_OF_SPACE mesh " << meshIndex << endl;
+        return;
+    }
+    mesh.baseVertex = allocation.baseVertex;
+    mesh.firstIndex = allocation.firstIndex;
+
+    const void* vertices = scene.Vertices(record);
+    size_t vertexBytes = scene.VertexBytes(record);
+    const void* indices = scene.Indices(record);
+    size_t indexBytes = scene.IndexBytes(record);
+    GLuint vertexBuffer = gGeometry.VertexBuffer(mesh.layout);
+    GLuint indexBuffer = gGeometry.IndexBuffer();
+    GLuint positionBuffer = gGeometry.PositionBuffer(mesh.layout);
+    GLuint floatsPerVertex = SceneFormat::FloatsPerVertex(mesh.layout);
+    GLuint vertexCount = mesh.nVertices;
+
+    gUploader.Submit([file, vertices, vertexBytes, indices, indexBytes, vertexBuffer, indexBuffer, positionBuffer, floatsPerVertex, vertexCount, allocation]()
+    {
+        // GL_COPY_WRITE_BUFFER: the element array binding belongs to a vertex array, and this context has none
+        glBindBuffer(GL_COPY_WRITE_BUFFER, vertexBuffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.vertexOffset, vertexBytes, vertices); // Sends vertex or coordinate data to the GPU
 
-    glGenVertexArrays(1, &mesh.vao); // we can also generate multiple VAOs or buffers at the same time
-    glBindVertexArray(mesh.vao);
+        // The depth pre-pass reads the positions alone, picked out of the interleaved vertices here
+        if (positionBuffer != 0)
+        {
+            vector<float> positions((size_t)vertexCount * 3);
+            const float* vertex = (const float*)vertices;
+            for (GLuint v = 0; v < vertexCount; ++v, vertex += floatsPerVertex)
+                memcpy(&positions[(size_t)v * 3], vertex, 3 * sizeof(float));
+            glBindBuffer(GL_COPY_WRITE_BUFFER, positionBuffer);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.positionOffset, (GLsizeiptr)(positions.size() * sizeof(float)), positions.data());
+        }
 
-    glGenBuffers(1, &mesh.vbos[0]);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbos[0]); // Activates the buffer
-    glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
+        if (indexBytes > 0)
+        {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.indexOffset, indexBytes, indices);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    },
+    [meshIndex]()
+    {
+        gMeshes[meshIndex].resident = true;
+    });
+}
 
-    GLint stride = sizeof(float) * (floatsPerVertex + floatsPerNormal + floatsPerUV);// The number of floats before each
 
-    // Create Vertex Attribute Pointers
-    glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
-    glEnableVertexAttribArray(0);
+// Binds the vertex array of the mesh's layout, unless it is bound already; meshes of one layout share it
+void UBindMesh(const GLMesh& mesh)
+{
+    GLuint vertexArray = gGeometry.VertexArray(mesh.layout);
+    if (vertexArray != gBoundVertexArray)
+    {
+        glBindVertexArray(vertexArray);
+        gBoundVertexArray = vertexArray;
+    }
+}
 
-    glVertexAttribPointer(1, floatsPerNormal, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * floatsPerVertex));
-    glEnableVertexAttribArray(1);
 
-    glVertexAttribPointer(2, floatsPerUV, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * (floatsPerVertex + floatsPerNormal)));
-    glEnableVertexAttribArray(2);
+// Draws a mesh whose vertex array is bound, from its ranges of the shared buffers. The base instance
+// hands drawIndex, the draw's DrawData entry, to the shaders
+void UDrawMesh(const GLMesh& mesh, GLuint drawIndex)
+{
+    if (mesh.nIndices > 0)
+        glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, mesh.nIndices, GL_UNSIGNED_INT, (void*)(mesh.firstIndex * sizeof(GLuint)), 1, mesh.baseVertex, drawIndex);
+    else
+        glDrawArraysInstancedBaseInstance(GL_TRIANGLES, mesh.baseVertex, mesh.nVertices, 1, drawIndex);
 }
 
-void UCreateCircleMesh(GLMesh& mesh, GLfloat radius, GLCoord center) {
-    const GLint numSegments = 60;    // The number of triangles used to draw the circle
-    const GLint floatsPerVertex = 3;
-
-    mesh.nVertices = numSegments * 3; // Each segment creates a triangle (3 vertices)
-
-    GLfloat* verts = new GLfloat[mesh.nVertices * floatsPerVertex];   // Create array to hold the vertex data
-
-    // Calculate the angle in radians between segments
-    GLfloat angleIncrement = (2.0f * PI) / static_cast<GLfloat>(numSegments);
-
-    // Create vertices for the circle
-    for (int i = 0; i < numSegments; ++i) {
-        // Calculate the current angle and the next angle (for the next segment)
-        GLfloat angle = static_cast<GLfloat>(i) * angleIncrement;
-        GLfloat nextAngle = static_cast<GLfloat>(i + 1) * angleIncrement;
-        // Find the x and y coordinates of the first vertex
-        GLfloat x = center.x + radius * cos(angle);
-        GLfloat z = center.z + radius * sin(angle);
-        // Find the x and y coordinates of the second vertex
-        GLfloat nextX = center.x + radius * cos(nextAngle);
-        GLfloat nextZ = center.z + radius * sin(nextAngle);
-
-        // Vertex positions, starting with the center of the circle
-        verts[i * 9] = center.x;
-        verts[(i * 9) + 1] = center.y;
-        verts[(i * 9) + 2] = center.z;
-        verts[(i * 9) + 3] = x;
-        verts[(i * 9) + 4] = center.y;
-        verts[(i * 9) + 5] = z;
-        verts[(i * 9) + 6] = nextX;
-        verts[(i * 9) + 7] = center.y;
-        verts[(i * 9) + 8] = nextZ;
-    }
-
-    glGenVertexArrays(1, &mesh.vao);
-    glBindVertexArray(mesh.vao);
 
-    glGenBuffers(1, &mesh.vbos[0]);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbos[0]);
-    glBufferData(GL_ARRAY_BUFFER, mesh.nVertices * floatsPerVertex * sizeof(GLfloat), verts, GL_STATIC_DRAW);
+void UDestroyMesh(GLMesh& mesh)
+{
+    if (mesh.resident)
+        gGeometry.Free(mesh.layout, mesh.baseVertex, mesh.firstIndex, mesh.nIndices > 0);
+    mesh.resident = false;
+}
 
-    GLint stride = sizeof(float) * floatsPerVertex;
 
-    // Vertex positions attribute pointer
-    glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
-    glEnableVertexAttribArray(0);
+// Render thread, with no upload in flight: packs the geometry buffers once freed meshes have splintered
+// them, and moves the meshes to their new ranges. RangeAllocatorCheck replays this remapping on the CPU
+void UCompactGeometry()
+{
+    vector<GeometryPool::Move> moves;
+    gGeometry.Compact(moves);
+    for (const GeometryPool::Move& move : moves)
+    {
+        for (GLMesh& mesh : gMeshes)
+        {
+            if (move.buffer == GeometryPool::INDEX_BUFFER && mesh.nIndices > 0 && mesh.firstIndex == move.from)
+                mesh.firstIndex = move.to;
+            else if (move.buffer == (int)mesh.layout && mesh.baseVertex == (GLint)move.from)
+                mesh.baseVertex = (GLint)move.to;
+        }
+    }
+    cout << "INFO: Geometry compacted, " << moves.size() << " range(s) moved" << endl;
+    UReportGeometryStats();
 }
 
 
-void UCreateCylinderMesh(GLMesh& mesh, GLfloat radius, GLfloat height, GLCoord center) {
-    //Create a for loop that makes a top circle, bottom circle, and planes to connect them
-    // Each iteration of for loop should make 1 pie slice from the top, one slice from the bottom,
-    //  and 2 triangles to form the plane that connects them. Then increment the angle
-
-    const GLint numSegments = 60;    // The number of triangles used to draw the circle
-    const GLint floatsPerSegment = 36;  // 4 Triangles * 3 Vertices * 3 floats (x, y, z)
-    const GLint floatsPerVertex = 3;    // 3 floats per vertex (x, y, z)
-
-    mesh.nVertices = numSegments * 12; // Each segment creates 4 triangles with 3 vertices each
-
-    GLfloat* verts = new GLfloat[numSegments * floatsPerSegment];   // Create array to hold the vertex data
-
-    // Calculate the angle in radians between segments
-    GLfloat angleIncrement = (2.0f * PI) / static_cast<GLfloat>(numSegments);
-
-    // Create vertices for each of the 4 triangles in each segment
-    for (int i = 0; i < numSegments; ++i) {
-        // Calculate the current angle and the next angle (for the next segment)
-        GLfloat angle = static_cast<GLfloat>(i) * angleIncrement;
-        GLfloat nextAngle = static_cast<GLfloat>(i + 1) * angleIncrement;
-        // Find the x and z coordinates of the first vertex of first triangle
-        GLfloat x = center.x + radius * cos(angle);
-        GLfloat z = center.z + radius * sin(angle);
-        // Find the x and z coordinates of the second vertex
-        GLfloat nextX = center.x + radius * cos(nextAngle);
-        GLfloat nextZ = center.z + radius * sin(nextAngle);
-        // Y value of top circle
-        GLfloat topY = center.y + height;
-
-        // Vertex positions, starting with the center of the bottom circle
-        //Bottom slice
-        verts[i * floatsPerSegment] = center.x;
-        verts[(i * floatsPerSegment) + 1] = center.y;
-        verts[(i * floatsPerSegment) + 2] = center.z;
-        verts[(i * floatsPerSegment) + 3] = x;
-        verts[(i * floatsPerSegment) + 4] = center.y;
-        verts[(i * floatsPerSegment) + 5] = z;
-        verts[(i * floatsPerSegment) + 6] = nextX;
-        verts[(i * floatsPerSegment) + 7] = center.y;
-        verts[(i * floatsPerSegment) + 8] = nextZ;
-        // Top slice
-        verts[(i * floatsPerSegment) + 9] = center.x;
-        verts[(i * floatsPerSegment) + 10] = topY;
-        verts[(i * floatsPerSegment) + 11] = center.z;
-        verts[(i * floatsPerSegment) + 12] = x;
-        verts[(i * floatsPerSegment) + 13] = topY;
-        verts[(i * floatsPerSegment) + 14] = z;
-        verts[(i * floatsPerSegment) + 15] = nextX;
-        verts[(i * floatsPerSegment) + 16] = topY;
-        verts[(i * floatsPerSegment) + 17] = nextZ;
-        // Side Plane, starting with top two points, then bottom current point
-        verts[(i * floatsPerSegment) + 18] = x;
-        verts[(i * floatsPerSegment) + 19] = topY;
-        verts[(i * floatsPerSegment) + 20] = z;
-        verts[(i * floatsPerSegment) + 21] = nextX;
-        verts[(i * floatsPerSegment) + 22] = topY;
-        verts[(i * floatsPerSegment) + 23] = nextZ;
-        verts[(i * floatsPerSegment) + 24] = x;
-        verts[(i * floatsPerSegment) + 25] = center.y;
-        verts[(i * floatsPerSegment) + 26] = z;
-		// Bottom points, then next top point
-        verts[(i * floatsPerSegment) + 27] = nextX;
-        verts[(i * floatsPerSegment) + 28] = center.y;
-        verts[(i * floatsPerSegment) + 29] = nextZ;
-        verts[(i * floatsPerSegment) + 30] = x;
-        verts[(i * floatsPerSegment) + 31] = center.y;
-        verts[(i * floatsPerSegment) + 32] = z;
-        verts[(i * floatsPerSegment) + 33] = nextX;
-        verts[(i * floatsPerSegment) + 34] = topY;
-        verts[(i * floatsPerSegment) + 35] = nextZ;
+void UReportGeometryStats()
+{
+    static const char* names[GeometryPool::LAYOUT_COUNT + 1] = { "position", "position/normal/uv", "index" };
+    for (int i = 0; i <= GeometryPool::INDEX_BUFFER; ++i)
+    {
+        GeometryPool::Stats stats = gGeometry.BufferStats(i);
+        cout << "INFO: Geometry " << names[i] << " buffer: " << stats.allocations << " range(s), "
+            << stats.used / 1024 << " of " << stats.capacity / 1024 << " KB used ("
+            << (stats.capacity > 0 ? 100.0 * stats.used / stats.capacity : 0.0) << "%), "
+            << stats.freeRanges << " free range(s), fragmentation " << stats.fragmentation * 100.0 << "%" << endl;
     }
+}
 
-    glGenVertexArrays(1, &mesh.vao);
-    glBindVertexArray(mesh.vao);
 
-    glGenBuffers(1, &mesh.vbos[0]);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbos[0]);
-    glBufferData(GL_ARRAY_BUFFER, numSegments * floatsPerSegment * sizeof(GLfloat), verts, GL_STATIC_DRAW);
+/*Decode an image file's contents into pixels ready for the upload. Touches no GL state, so it runs on the workers*/
+bool UDecodeImage(const FileData& file, DecodedImage& image)
+{
+    image = DecodedImage();
+    if (!file.IsValid())
+        return false;
 
-    GLint stride = sizeof(float) * floatsPerVertex;
+    image.pixels = stbi_load_from_memory(file.Data(), (int)file.Size(), &image.width, &image.height, &image.channels, 0);
+    if (image.pixels == nullptr)
+        return false;
 
-    // Vertex positions attribute pointer
-    glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
-    glEnableVertexAttribArray(0);
+    flipImageVertically(image.pixels, image.width, image.height, image.channels);
+    return true;
 }
 
 
-void UDestroyMesh(GLMesh& mesh)
+// Decodes an image file on a worker, then creates the texture on the upload thread. The render thread
+// finds it in gTextures once the GPU has the pixels
+void ULoadTexture(int textureIndex, const string& path, const shared_ptr<FileData>& file)
 {
-    glDeleteVertexArrays(1, &mesh.vao);
-    glDeleteBuffers(1, &mesh.vbos[0]);
+    gJobs.Run([textureIndex, path, file]()
+    {
+        shared_ptr<DecodedImage> image = make_shared<DecodedImage>();
+        bool decoded = UDecodeImage(*file, *image);
+        file->Reset();    // back to the pool for the next texture
+        if (!decoded)
+        {
+            cout << "Failed to load texture " << path << endl;
+            return;
+        }
+
+        shared_ptr<GLuint> textureId = make_shared<GLuint>(0);
+        gUploader.Submit([path, image, textureId]()
+        {
+            if (!UCreateTexture(path.c_str(), *image, *textureId))
+            {
+                cout << "Failed to load texture " << path << endl;
+                glDeleteTextures(1, textureId.get());
+                *textureId = 0;
+            }
+            stbi_image_free(image->pixels);
+        },
+        [textureIndex, textureId]()
+        {
+            gTextures[textureIndex] = *textureId;
+        });
+    }, &gTextureDecodes);
 }
 
 
-/*Generate and load the texture*/
-bool UCreateTexture(const char* filename, GLuint& textureId)
+/*Generate and load the texture from decoded pixels; the caller frees them*/
+bool UCreateTexture(const char* filename, const DecodedImage& image, GLuint& textureId)
 {
-    int width, height, channels;
-    unsigned char* image = stbi_load(filename, &width, &height, &channels, 0);
-    if (image)
+    int width = image.width, height = image.height, channels = image.channels;
+    if (image.pixels)
     {
-        flipImageVertically(image, width, height, channels);
-
         glGenTextures(1, &textureId);
         glBindTexture(GL_TEXTURE_2D, textureId);
 
@@ -1192,18 +1920,17 @@ bool UCreateTexture(const char* filename, GLuint& textureId)
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
         if (channels == 3)
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image.pixels);
         else if (channels == 4)
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels);
         else
         {
-            cout << "Not implemented to handle image with " << channels << " channels" << endl;
+            cout << "Not implemented to handle image with " << channels << " channels: " << filename << endl;
             return false;
         }
 
         glGenerateMipmap(GL_TEXTURE_2D);
 
-        stbi_image_free(image);
         glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture
 
         return true;
@@ -1216,69 +1943,7 @@ bool UCreateTexture(const char* filename, GLuint& textureId)
 
 void UDestroyTexture(GLuint textureId)
 {
-    glGenTextures(1, &textureId);
-}
-
-
-// Implements the UCreateShaders function
-bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId)
-{
-    // Compilation and linkage error reporting
-    int success = 0;
-    char infoLog[512];
-
-    // Create a Shader program object.
-    programId = glCreateProgram();
-
-    // Create the vertex and fragment shader objects
-    GLuint vertexShaderId = glCreateShader(GL_VERTEX_SHADER);
-    GLuint fragmentShaderId = glCreateShader(GL_FRAGMENT_SHADER);
-
-    // Retrieve the shader source
-    glShaderSource(vertexShaderId, 1, &vtxShaderSource, NULL);
-    glShaderSource(fragmentShaderId, 1, &fragShaderSource, NULL);
-
-    // Compile the vertex shader, and print compilation errors (if any)
-    glCompileShader(vertexShaderId); // compile the vertex shader
-    // check for shader compile errors
-    glGetShaderiv(vertexShaderId, GL_COMPILE_STATUS, &success);
-    if (!success)
-    {
-        glGetShaderInfoLog(vertexShaderId, 512, NULL, infoLog);
-        std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
-
-        return false;
-    }
-
-    glCompileShader(fragmentShaderId); // compile the fragment shader
-    // check for shader compile errors
-    glGetShaderiv(fragmentShaderId, GL_COMPILE_STATUS, &success);
-    if (!success)
-    {
-        glGetShaderInfoLog(fragmentShaderId, sizeof(infoLog), NULL, infoLog);
-        std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
-
-        return false;
-    }
-
-    // Attached compiled shaders to the shader program
-    glAttachShader(programId, vertexShaderId);
-    glAttachShader(programId, fragmentShaderId);
-
-    glLinkProgram(programId);   // links the shader program
-    // check for linking errors
-    glGetProgramiv(programId, GL_LINK_STATUS, &success);
-    if (!success)
-    {
-        glGetProgramInfoLog(programId, sizeof(infoLog), NULL, infoLog);
-        std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
-
-        return false;
-    }
-
-    glUseProgram(programId);    // Uses the shader program
-
-    return true;
+    glDeleteTextures(1, &textureId);
 }
 
 
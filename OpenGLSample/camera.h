@@ -23,9 +23,13 @@ const float PITCH = 0.0f;
 const float SPEED = 2.5f;
 const float SENSITIVITY = 0.1f;
 const float ZOOM = 45.0f;
+const float NEAR_PLANE = 0.1f;
+const float FAR_PLANE = 100.0f;
 
 
-// An abstract camera class that processes input and calculates the corresponding Euler Angles, Vectors and Matrices for use in OpenGL
+// An abstract camera class that processes input and calculates the corresponding Euler Angles, Vectors and Matrices for use in OpenGL.
+// The view, projection and view-projection matrices and the frustum planes are cached and only rebuilt when
+// the camera moved or its lens changed, at most once per frame however many times they are read
 class Camera
 {
 public:
@@ -43,6 +47,9 @@ public:
 	float MouseSensitivity;
 	float Zoom;
 
+	// frustum planes in world space, as (normal, distance) with the normal pointing inside
+	enum FrustumPlane { PLANE_LEFT, PLANE_RIGHT, PLANE_BOTTOM, PLANE_TOP, PLANE_NEAR, PLANE_FAR, PLANE_COUNT };
+
 	// constructor with vectors
 	Camera(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f), float yaw = YAW, float pitch = PITCH) : Front(glm::vec3(0.0f, 0.0f, -1.0f)), MovementSpeed(SPEED), MouseSensitivity(SENSITIVITY), Zoom(ZOOM)
 	{
@@ -63,9 +70,99 @@ public:
 	}
 
 	// returns the view matrix calculated using Euler Angles and the LookAt Matrix
-	glm::mat4 GetViewMatrix()
+	const glm::mat4& GetViewMatrix()
+	{
+		Update();
+		return view;
+	}
+
+	const glm::mat4& GetProjectionMatrix()
+	{
+		Update();
+		return projection;
+	}
+
+	// projection * view, for shaders and culling that want a single matrix
+	const glm::mat4& GetViewProjectionMatrix()
 	{
-		return glm::lookAt(Position, Position + Front, Up);
+		Update();
+		return viewProjection;
+	}
+
+	const glm::vec4* GetFrustumPlanes()
+	{
+		Update();
+		return frustumPlanes;
+	}
+
+	// true unless the sphere lies completely outside one of the frustum planes
+	bool IsSphereVisible(const glm::vec3& center, float radius)
+	{
+		Update();
+		for (int i = 0; i < PLANE_COUNT; ++i)
+		{
+			const glm::vec4& plane = frustumPlanes[i];
+			if (plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w < -radius)
+				return false;
+		}
+		return true;
+	}
+
+	// width / height of the framebuffer the camera renders to; call it from the resize callback
+	void SetAspectRatio(float ratio)
+	{
+		if (ratio > 0.0f && ratio != aspectRatio)
+		{
+			aspectRatio = ratio;
+			dirty = true;
+		}
+	}
+
+	void SetClipPlanes(float zNear, float zFar)
+	{
+		nearPlane = zNear;
+		farPlane = zFar;
+		dirty = true;
+	}
+
+	void SetPosition(const glm::vec3& position)
+	{
+		if (position != Position)
+		{
+			Position = position;
+			dirty = true;
+		}
+	}
+
+	void SetOrientation(float yaw, float pitch)
+	{
+		if (yaw != Yaw || pitch != Pitch)
+		{
+			Yaw = yaw;
+			Pitch = pitch;
+			updateCameraVectors();
+		}
+	}
+
+	// call after changing Position, Zoom or the Euler angles directly instead of through the Process functions
+	void Invalidate()
+	{
+		updateCameraVectors();
+	}
+
+	// rebuilds the cached matrices and frustum planes if anything changed since the last call.
+	// Returns true when they were rebuilt, so per-frame uploads can be skipped for a still camera
+	bool Update()
+	{
+		if (!dirty)
+			return false;
+
+		view = glm::lookAt(Position, Position + Front, Up);
+		projection = glm::perspective(glm::radians(Zoom), aspectRatio, nearPlane, farPlane);
+		viewProjection = projection * view;
+		updateFrustumPlanes();
+		dirty = false;
+		return true;
 	}
 
 	// processes input received from any keyboard-like input system. Accepts input parameter in the form of camera defined ENUM (to abstract it from windowing systems)
@@ -82,10 +179,14 @@ public:
 			Position += Right * velocity;
 		if (direction == UP)
 			Pitch += velocity * 8.0f;
-		updateCameraVectors();
 		if (direction == DOWN)
 			Pitch -= velocity * 8.0f;
-		updateCameraVectors();
+
+		// moving along the existing axes leaves them unchanged, only pitching needs the trig
+		if (direction == UP || direction == DOWN)
+			updateCameraVectors();
+		else
+			dirty = true;
 	}
 
 	// processes input received from a mouse input system. Expects the offset value in both the x and y direction.
@@ -118,9 +219,20 @@ public:
 			Zoom = 1.0f;
 		if (Zoom > 45.0f)
 			Zoom = 45.0f;
+		dirty = true;
 	}
 
 private:
+	float aspectRatio = 1.0f;
+	float nearPlane = NEAR_PLANE;
+	float farPlane = FAR_PLANE;
+
+	bool dirty = true;
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::mat4 viewProjection;
+	glm::vec4 frustumPlanes[PLANE_COUNT];
+
 	// calculates the front vector from the Camera's (updated) Euler Angles
 	void updateCameraVectors()
 	{
@@ -133,6 +245,29 @@ private:
 		// also re-calculate the Right and Up vector
 		Right = glm::normalize(glm::cross(Front, WorldUp));  // normalize the vectors, because their length gets closer to 0 the more you look up or down which results in slower movement.
 		Up = glm::normalize(glm::cross(Right, Front));
+		dirty = true;
+	}
+
+	// extracts the planes from the rows of the view-projection matrix (Gribb and Hartmann)
+	void updateFrustumPlanes()
+	{
+		glm::vec4 rows[4];
+		for (int r = 0; r < 4; ++r)
+			rows[r] = glm::vec4(viewProjection[0][r], viewProjection[1][r], viewProjection[2][r], viewProjection[3][r]);
+
+		frustumPlanes[PLANE_LEFT] = rows[3] + rows[0];
+		frustumPlanes[PLANE_RIGHT] = rows[3] - rows[0];
+		frustumPlanes[PLANE_BOTTOM] = rows[3] + rows[1];
+		frustumPlanes[PLANE_TOP] = rows[3] - rows[1];
+		frustumPlanes[PLANE_NEAR] = rows[3] + rows[2];
+		frustumPlanes[PLANE_FAR] = rows[3] - rows[2];
+
+		for (int i = 0; i < PLANE_COUNT; ++i)
+		{
+			glm::vec4& plane = frustumPlanes[i];
+			float length = glm::length(glm::vec3(plane.x, plane.y, plane.z));
+			plane = plane * (1.0f / length);
+		}
 	}
 };
 #endif
\ No newline at end of file
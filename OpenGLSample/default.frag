@@ -1,6 +0,0 @@
-#version 330 core
-out vec4 FragColor;
-void main()
-{
-	FragColor = vec4(0.8f, 0.3f, 0.02f, 1.0f);
-}
\ No newline at end of file
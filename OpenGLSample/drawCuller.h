@@ -0,0 +1,135 @@
+#ifndef DRAW_CULLER_H
+#define DRAW_CULLER_H
+
+// The OpenGL loader (GLEW or glad) has to be included before this header
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "hiZPyramid.h"
+
+// One draw of glMultiDrawElementsIndirect, as GL reads it from the indirect buffer
+struct DrawElementsIndirectCommand
+{
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;	// the draw's DrawData entry, read through the draw index attribute
+};
+
+// Frustum and occlusion culling of a frame's draws on the GPU, with shaders/cull.comp. The CPU lists
+// every draw it may make as a Candidate, grouped in batches that each own a range of the command
+// buffer; the compute pass tests the candidates' bounding spheres against the frustum planes in
+// FrameData and, given a Hi-Z pyramid, against the previous frame's depth, and packs the visible ones
+// at the front of their batch's range, counting with one atomic per batch. The command buffer is
+// cleared first, so the rest of a range holds empty commands and a multi-draw call over the whole
+// range draws exactly the visible objects. Nothing is read back: the CPU never learns which draws
+// survived.
+//
+// The buffers are written by the GPU only, so unlike the ring buffer they need no fences: GL orders the
+// compute pass of a frame after the draws of the previous one.
+class DrawCuller
+{
+public:
+	static const GLuint CANDIDATE_BINDING = 3;
+	static const GLuint COMMAND_BINDING = 4;
+	static const GLuint COUNTER_BINDING = 5;
+	static const GLuint GROUP_SIZE = 64;	// local_size_x of cull.comp
+
+	// std430 layout of Candidate in cull.comp
+	struct Candidate
+	{
+		glm::vec4 bounds;		// xyz = bounding sphere center in mesh space, w = radius
+		GLuint count;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint drawIndex;
+		GLuint instance;
+		GLuint batch;
+		GLuint firstCommand;
+		GLuint padding;
+	};
+
+	// sizes the command buffer for maxDraws commands and the counters for maxBatches batches. Needs a
+	// current GL 4.4 context
+	void Initialize(GLuint maxDraws, GLuint maxBatches)
+	{
+		this->maxDraws = maxDraws > 0 ? maxDraws : 1;
+		this->maxBatches = maxBatches > 0 ? maxBatches : 1;
+		commandBuffer = createBuffer(this->maxDraws * sizeof(DrawElementsIndirectCommand));
+		counterBuffer = createBuffer(this->maxBatches * sizeof(GLuint));
+	}
+
+	void Destroy()
+	{
+		glDeleteBuffers(1, &commandBuffer);
+		glDeleteBuffers(1, &counterBuffer);
+		commandBuffer = 0;
+		counterBuffer = 0;
+	}
+
+	// runs the cull pass over candidateCount candidates at offset in candidateBuffer, producing
+	// commandCount commands in batchCount batches. FrameData and Instances must be bound. occluders,
+	// when not null and valid, adds the occlusion test; it is read through texture unit 1. Returns
+	// false, without culling, when the counts exceed the buffers
+	bool Cull(GLuint programId, GLuint candidateBuffer, GLintptr offset, GLuint candidateCount, GLuint commandCount, GLuint batchCount,
+		const HiZPyramid* occluders)
+	{
+		if (candidateCount == 0 || commandCount > maxDraws || batchCount > maxBatches)
+			return false;
+
+		// empty commands and zero counters; a NULL clear value fills with zeros
+		glBindBuffer(GL_COPY_WRITE_BUFFER, commandBuffer);
+		glClearBufferSubData(GL_COPY_WRITE_BUFFER, GL_R32UI, 0, commandCount * sizeof(DrawElementsIndirectCommand), GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, counterBuffer);
+		glClearBufferSubData(GL_COPY_WRITE_BUFFER, GL_R32UI, 0, batchCount * sizeof(GLuint), GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, CANDIDATE_BINDING, candidateBuffer, offset, candidateCount * sizeof(Candidate));
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, COMMAND_BINDING, commandBuffer, 0, commandCount * sizeof(DrawElementsIndirectCommand));
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, COUNTER_BINDING, counterBuffer, 0, batchCount * sizeof(GLuint));
+
+		glUseProgram(programId);
+		glUniform1ui(glGetUniformLocation(programId, "candidateCount"), candidateCount);
+		bool occlusion = occluders != nullptr && occluders->IsValid();
+		glUniform1i(glGetUniformLocation(programId, "occlusionCulling"), occlusion ? 1 : 0);
+		if (occlusion)
+		{
+			glUniformMatrix4fv(glGetUniformLocation(programId, "previousViewProjection"), 1, GL_FALSE, glm::value_ptr(occluders->ViewProjection()));
+			glUniform1i(glGetUniformLocation(programId, "hiZLevels"), occluders->Levels());
+			glUniform2i(glGetUniformLocation(programId, "hiZFramebufferSize"), occluders->FramebufferWidth(), occluders->FramebufferHeight());
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_2D, occluders->Texture());
+			glActiveTexture(GL_TEXTURE0);
+		}
+		glDispatchCompute((candidateCount + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+
+		// the draws read the commands as indirect parameters
+		glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+		return true;
+	}
+
+	// the indirect buffer after Cull(): batch b's commands start at its firstCommand
+	GLuint CommandBuffer() const
+	{
+		return commandBuffer;
+	}
+
+private:
+	GLuint commandBuffer = 0;
+	GLuint counterBuffer = 0;
+	GLuint maxDraws = 0;
+	GLuint maxBatches = 0;
+
+	static GLuint createBuffer(GLsizeiptr size)
+	{
+		GLuint buffer = 0;
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glBufferStorage(GL_COPY_WRITE_BUFFER, size, NULL, 0);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		return buffer;
+	}
+};
+#endif
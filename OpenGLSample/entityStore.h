@@ -0,0 +1,183 @@
+#ifndef ENTITY_STORE_H
+#define ENTITY_STORE_H
+
+#include <vector>
+#include <cstdint>
+
+// Handle to an entity. The generation changes every time an index is reused, so a handle kept
+// past its entity's destruction is recognized as stale instead of aliasing the next entity
+struct Entity
+{
+	uint32_t index = UINT32_MAX;
+	uint32_t generation = 0;
+
+	bool operator==(const Entity& other) const
+	{
+		return index == other.index && generation == other.generation;
+	}
+};
+
+
+class ComponentArrayBase
+{
+public:
+	virtual ~ComponentArrayBase()
+	{
+	}
+
+	virtual void Remove(Entity entity) = 0;
+};
+
+
+// Components of one type, densely packed: systems iterate Data() and Entities() front to back with no
+// holes. A sparse index per entity slot finds an entity's component in O(1); removing swaps the last
+// component into the hole, so the array stays dense but its order is not stable
+template <typename T>
+class ComponentArray : public ComponentArrayBase
+{
+public:
+	// adds or replaces the entity's component
+	T& Add(Entity entity, const T& component)
+	{
+		if (entity.index >= sparse.size())
+			sparse.resize(entity.index + 1, NONE);
+
+		uint32_t slot = sparse[entity.index];
+		if (slot != NONE)
+		{
+			components[slot] = component;
+			return components[slot];
+		}
+
+		sparse[entity.index] = (uint32_t)components.size();
+		components.push_back(component);
+		owners.push_back(entity);
+		return components.back();
+	}
+
+	void Remove(Entity entity) override
+	{
+		if (!Has(entity))
+			return;
+
+		uint32_t slot = sparse[entity.index];
+		uint32_t last = (uint32_t)components.size() - 1;
+		if (slot != last)
+		{
+			components[slot] = components[last];
+			owners[slot] = owners[last];
+			sparse[owners[slot].index] = slot;
+		}
+		components.pop_back();
+		owners.pop_back();
+		sparse[entity.index] = NONE;
+	}
+
+	bool Has(Entity entity) const
+	{
+		return entity.index < sparse.size() && sparse[entity.index] != NONE && owners[sparse[entity.index]] == entity;
+	}
+
+	// the entity must have the component
+	T& Get(Entity entity)
+	{
+		return components[sparse[entity.index]];
+	}
+
+	const T& Get(Entity entity) const
+	{
+		return components[sparse[entity.index]];
+	}
+
+	// null when the entity does not have the component
+	T* Find(Entity entity)
+	{
+		return Has(entity) ? &components[sparse[entity.index]] : nullptr;
+	}
+
+	size_t Size() const
+	{
+		return components.size();
+	}
+
+	T* Data()
+	{
+		return components.data();
+	}
+
+	const T* Data() const
+	{
+		return components.data();
+	}
+
+	// owner of each component, parallel to Data()
+	const Entity* Entities() const
+	{
+		return owners.data();
+	}
+
+private:
+	static const uint32_t NONE = UINT32_MAX;
+
+	std::vector<T> components;
+	std::vector<Entity> owners;
+	std::vector<uint32_t> sparse;	// per entity index
+};
+
+
+// Hands out entity handles and removes a destroyed entity's components from every registered array
+class EntityStore
+{
+public:
+	// arrays whose components should go away with their entity
+	void Register(ComponentArrayBase& components)
+	{
+		arrays.push_back(&components);
+	}
+
+	Entity Create()
+	{
+		Entity entity;
+		if (!freeIndices.empty())
+		{
+			entity.index = freeIndices.back();
+			freeIndices.pop_back();
+		}
+		else
+		{
+			entity.index = (uint32_t)generations.size();
+			generations.push_back(0);
+		}
+		entity.generation = generations[entity.index];
+		++aliveCount;
+		return entity;
+	}
+
+	void Destroy(Entity entity)
+	{
+		if (!IsAlive(entity))
+			return;
+		for (ComponentArrayBase* components : arrays)
+			components->Remove(entity);
+		++generations[entity.index];
+		freeIndices.push_back(entity.index);
+		--aliveCount;
+	}
+
+	bool IsAlive(Entity entity) const
+	{
+		return entity.index < generations.size() && generations[entity.index] == entity.generation;
+	}
+
+	size_t Count() const
+	{
+		return aliveCount;
+	}
+
+private:
+	std::vector<uint32_t> generations;	// per entity index
+	std::vector<uint32_t> freeIndices;
+	std::vector<ComponentArrayBase*> arrays;
+	size_t aliveCount = 0;
+};
+#endif
@@ -0,0 +1,102 @@
+#ifndef FRAME_MAILBOX_H
+#define FRAME_MAILBOX_H
+
+#include <mutex>
+#include <condition_variable>
+#include <utility>
+
+// Triple-buffered hand-off of whole frames from a producer thread to a consumer thread. The producer
+// fills the back slot and publishes it, the consumer takes the newest published slot and reads it
+// until its next Take(); the third slot holds the published frame in between, so neither side ever
+// waits for the other to finish with a slot. A frame published before the consumer took the previous
+// one replaces it.
+//
+// Slots are reused, not reallocated: containers in T keep their capacity from frame to frame.
+//
+// With every frame it takes the consumer hands the producer a Reply for the frame the producer builds
+// next, such as memory the consumer has made ready for it; WaitForPickup() returns it. The producer's
+// first frame gets the reply given to SetFirstReply().
+template <typename T, typename Reply>
+class FrameMailbox
+{
+public:
+	FrameMailbox() = default;
+	FrameMailbox(const FrameMailbox&) = delete;
+	FrameMailbox& operator=(const FrameMailbox&) = delete;
+
+	// before the consumer starts: the reply for the producer's first frame
+	void SetFirstReply(const Reply& first)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		reply = first;
+	}
+
+	// producer: the slot to fill next. It still holds the frame published three frames ago
+	T& Back()
+	{
+		return slots[back];
+	}
+
+	// producer: hands the back slot to the consumer
+	void Publish()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			std::swap(back, ready);
+			fresh = true;
+		}
+		published.notify_one();
+	}
+
+	// consumer: blocks until a frame is published and returns it, or nullptr once the mailbox is closed.
+	// next is the reply for the frame the producer builds after it
+	const T* Take(const Reply& next)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		published.wait(lock, [this]() { return fresh || closed; });
+		if (closed)
+			return nullptr;
+
+		std::swap(front, ready);
+		fresh = false;
+		reply = next;
+		lock.unlock();
+		taken.notify_all();
+		return &slots[front];
+	}
+
+	// producer: blocks until the consumer has taken the last published frame, so the producer works at
+	// most one frame ahead of the frame being consumed, and sets next to the reply for the frame to
+	// build. Returns false once the mailbox is closed
+	bool WaitForPickup(Reply& next)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		taken.wait(lock, [this]() { return !fresh || closed; });
+		next = reply;
+		return !closed;
+	}
+
+	// wakes both sides for good; either one may close
+	void Close()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			closed = true;
+		}
+		published.notify_all();
+		taken.notify_all();
+	}
+
+private:
+	T slots[3];
+	int back = 0;
+	int ready = 1;
+	int front = 2;
+	bool fresh = false;		// ready holds a frame the consumer has not taken
+	bool closed = false;
+	Reply reply = Reply();
+	std::mutex mutex;
+	std::condition_variable published;
+	std::condition_variable taken;
+};
+#endif
@@ -0,0 +1,176 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+// The OpenGL loader (GLEW or glad) and GLFW have to be included before this header
+
+#include <iostream>
+
+// Caps how many frames the CPU may queue ahead of the GPU with one fence per frame. Without a cap
+// the driver can buffer several frames, and every buffered frame adds a frame of input latency.
+// BeginFrame() waits for the fence of the frame that last used the same slot, EndFrame() inserts one.
+//
+// The optional latency measurement timestamps each frame on the GPU right after the swap is queued
+// and compares it with the time of the oldest input event that frame consumed. The GPU timestamp is
+// the closest point to the present that core OpenGL can observe, so the result is a lower bound
+class FramePacer
+{
+public:
+	static const int MAX_FRAMES_IN_FLIGHT = 3;
+
+	FramePacer(int framesInFlight = 2)
+	{
+		SetFramesInFlight(framesInFlight);
+	}
+
+	void SetFramesInFlight(int count)
+	{
+		framesInFlight = count < 1 ? 1 : (count > MAX_FRAMES_IN_FLIGHT ? MAX_FRAMES_IN_FLIGHT : count);
+	}
+
+	int FramesInFlight() const
+	{
+		return framesInFlight;
+	}
+
+	// slot of the current frame, for per-frame resources that must not be touched while the GPU reads them
+	int FrameSlot() const
+	{
+		return slot;
+	}
+
+	// blocks until the GPU has finished the frame that used this slot last
+	void BeginFrame()
+	{
+		slot = (int)(frame % framesInFlight);
+		if (fences[slot] == 0)
+			return;
+
+		double start = glfwGetTime();
+		GLenum result;
+		do
+		{
+			result = glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000); // 1 s, in ns
+		} while (result == GL_TIMEOUT_EXPIRED);
+		waitTime += glfwGetTime() - start;
+		++waitedFrames;
+
+		glDeleteSync(fences[slot]);
+		fences[slot] = 0;
+
+		if (measuring && inputTimes[slot] >= 0.0)
+			recordLatency(slot);
+	}
+
+	// call right after glfwSwapBuffers
+	void EndFrame()
+	{
+		if (measuring)
+			glQueryCounter(queries[slot], GL_TIMESTAMP);
+		fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		++frame;
+	}
+
+	// oldest input event (glfwGetTime) the current frame is based on, negative if it consumed none
+	void SetInputTime(double time)
+	{
+		inputTimes[slot] = measuring ? time : -1.0;
+	}
+
+	void EnableLatencyMeasurement(bool enable)
+	{
+		if (enable == measuring)
+			return;
+
+		measuring = enable;
+		if (enable)
+		{
+			if (queries[0] == 0)
+				glGenQueries(MAX_FRAMES_IN_FLIGHT, queries);
+			calibrate();
+			resetStats();
+		}
+		for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+			inputTimes[i] = -1.0;
+	}
+
+	bool IsMeasuringLatency() const
+	{
+		return measuring;
+	}
+
+	void Destroy()
+	{
+		for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+		{
+			if (fences[i] != 0)
+				glDeleteSync(fences[i]);
+			fences[i] = 0;
+		}
+		if (queries[0] != 0)
+			glDeleteQueries(MAX_FRAMES_IN_FLIGHT, queries);
+		queries[0] = 0;
+	}
+
+private:
+	static const int REPORT_INTERVAL = 120; // measured frames per report
+
+	int framesInFlight = 2;
+	unsigned long long frame = 0;
+	int slot = 0;
+	GLsync fences[MAX_FRAMES_IN_FLIGHT] = {};
+	double waitTime = 0.0;
+	int waitedFrames = 0;
+
+	bool measuring = false;
+	GLuint queries[MAX_FRAMES_IN_FLIGHT] = {};
+	double inputTimes[MAX_FRAMES_IN_FLIGHT] = { -1.0, -1.0, -1.0 };
+	double gpuToCpuOffset = 0.0; // seconds to add to a GPU timestamp to get glfwGetTime()
+	int samples = 0;
+	double latencySum = 0.0;
+	double latencyMin = 0.0;
+	double latencyMax = 0.0;
+
+	// the GPU and CPU clocks drift apart slowly, so the offset is refreshed with every report
+	void calibrate()
+	{
+		GLint64 gpuTime = 0;
+		glGetInteger64v(GL_TIMESTAMP, &gpuTime);
+		gpuToCpuOffset = glfwGetTime() - gpuTime * 1e-9;
+	}
+
+	void resetStats()
+	{
+		samples = 0;
+		latencySum = 0.0;
+		latencyMin = 1e9;
+		latencyMax = 0.0;
+		waitTime = 0.0;
+		waitedFrames = 0;
+	}
+
+	// the fence has signaled, so the timestamp query of the same frame is available without stalling
+	void recordLatency(int frameSlot)
+	{
+		GLuint64 gpuTime = 0;
+		glGetQueryObjectui64v(queries[frameSlot], GL_QUERY_RESULT, &gpuTime);
+		double latency = gpuTime * 1e-9 + gpuToCpuOffset - inputTimes[frameSlot];
+		inputTimes[frameSlot] = -1.0;
+
+		++samples;
+		latencySum += latency;
+		if (latency < latencyMin)
+			latencyMin = latency;
+		if (latency > latencyMax)
+			latencyMax = latency;
+
+		if (samples == REPORT_INTERVAL)
+		{
+			std::cout << "INFO: Input-to-present latency " << latencySum / samples * 1000.0 << " ms avg ("
+				<< latencyMin * 1000.0 << " min, " << latencyMax * 1000.0 << " max, "
+				<< framesInFlight << " frames in flight, " << waitTime * 1000.0 / (waitedFrames > 0 ? waitedFrames : 1) << " ms fence wait per frame)" << std::endl;
+			calibrate();
+			resetStats();
+		}
+	}
+};
+#endif
@@ -0,0 +1,111 @@
+#ifndef G_BUFFER_H
+#define G_BUFFER_H
+
+// The OpenGL loader (GLEW or glad) has to be included before this header
+
+// Framebuffer of the deferred path's geometry pass, laid out as shaders/include/gbuffer.glsl reads it:
+// albedo and ambient strength in RGBA8, the encoded normal, specular intensity and highlight size in
+// RGBA16F, and a depth buffer. The geometry pass writes every visible surface once, then the lighting
+// passes read the textures back, so the cost of a light depends on the pixels it reaches, not on the
+// objects in the scene.
+//
+// The depth is DEPTH24_STENCIL8 like the window's, so BlitDepth() can hand it to the default
+// framebuffer for the passes that follow: the light volumes and the forward-drawn lamps test against it.
+class GBuffer
+{
+public:
+	static const GLuint ALBEDO_UNIT = 0;	// texture units of the samplers in gbuffer.glsl
+	static const GLuint NORMAL_UNIT = 1;
+	static const GLuint DEPTH_UNIT = 2;
+
+	// (re)creates the framebuffer for a viewport size; false when the driver cannot render to it
+	bool Resize(int width, int height)
+	{
+		Destroy();
+		if (width <= 0 || height <= 0)
+			return false;
+		this->width = width;
+		this->height = height;
+
+		albedo = createTexture(GL_RGBA8);
+		normal = createTexture(GL_RGBA16F);
+		depth = createTexture(GL_DEPTH24_STENCIL8);
+
+		glGenFramebuffers(1, &framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, albedo, 0);
+		glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, normal, 0);
+		glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, depth, 0);
+		const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+		glDrawBuffers(2, drawBuffers);
+		complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		return complete;
+	}
+
+	void Destroy()
+	{
+		glDeleteFramebuffers(1, &framebuffer);
+		GLuint textures[] = { albedo, normal, depth };
+		glDeleteTextures(3, textures);
+		framebuffer = 0;
+		albedo = 0;
+		normal = 0;
+		depth = 0;
+		complete = false;
+	}
+
+	bool IsComplete() const
+	{
+		return complete;
+	}
+
+	GLuint Framebuffer() const
+	{
+		return framebuffer;
+	}
+
+	// binds the textures on the units the lighting shaders read them from, and leaves unit 0 active
+	void BindTextures() const
+	{
+		glActiveTexture(GL_TEXTURE0 + ALBEDO_UNIT);
+		glBindTexture(GL_TEXTURE_2D, albedo);
+		glActiveTexture(GL_TEXTURE0 + NORMAL_UNIT);
+		glBindTexture(GL_TEXTURE_2D, normal);
+		glActiveTexture(GL_TEXTURE0 + DEPTH_UNIT);
+		glBindTexture(GL_TEXTURE_2D, depth);
+		glActiveTexture(GL_TEXTURE0);
+	}
+
+	// copies the depth into the default framebuffer, which is left bound
+	void BlitDepth() const
+	{
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+private:
+	GLuint framebuffer = 0;
+	GLuint albedo = 0;
+	GLuint normal = 0;
+	GLuint depth = 0;
+	int width = 0;
+	int height = 0;
+	bool complete = false;
+
+	// read with texelFetch only, one level
+	GLuint createTexture(GLenum format) const
+	{
+		GLuint texture = 0;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexStorage2D(GL_TEXTURE_2D, 1, format, width, height);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		return texture;
+	}
+};
+#endif
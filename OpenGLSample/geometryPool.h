@@ -0,0 +1,341 @@
+#ifndef GEOMETRY_POOL_H
+#define GEOMETRY_POOL_H
+
+// The OpenGL loader (GLEW or glad) has to be included before this header
+
+#include <vector>
+
+#include "rangeAllocator.h"
+#include "sceneFormat.h"
+
+// All mesh geometry in a few large buffers: one vertex buffer per vertex layout of the scene format,
+// and one index buffer they all share. A mesh is a range of vertices and a range of indices inside
+// them, handed out by a RangeAllocator each, and is drawn with its base vertex and first index. Every
+// mesh of a layout shares that layout's vertex array, so drawing many meshes needs no vertex array
+// switch in between, and a multi-draw call can cover them all.
+//
+// The vertex arrays also read a draw index stream, 0, 1, 2 ... one value per instance: a draw whose
+// base instance is n sees n in the draw index attribute. Every draw sets its base instance to its
+// draw data entry, so the draws of one multi-draw call each find their own entry without gl_DrawID,
+// which GL 4.4 lacks.
+//
+// Layouts with more than a position also keep their positions apart, in a position stream at the same
+// vertex numbers, and a depth vertex array that reads only that stream: a depth-only pass then fetches
+// 12 bytes a vertex instead of the whole interleaved vertex. The owner writes both copies.
+//
+// The buffers are immutable storage written with glBufferSubData, so the upload thread fills the
+// ranges in its own context. Compact() packs the live ranges into fresh buffers when freed meshes have
+// splintered the free space, and reports what moved so the owner can update its meshes; it must not
+// run while an upload into the pool is in flight.
+class GeometryPool
+{
+public:
+	static const int LAYOUT_COUNT = SceneFormat::LAYOUT_POSITION_NORMAL_UV + 1;
+	static const int INDEX_BUFFER = LAYOUT_COUNT;	// buffer number of the index buffer in Move and Stats
+	static const GLuint DRAW_INDEX_LOCATION = 3;	// DRAW_INDEX_LOCATION in shaders/include/draw_data.glsl
+	static const GLsizei POSITION_STRIDE = 3 * sizeof(float);
+
+	// where the vertex and index ranges of a mesh start
+	struct Allocation
+	{
+		GLint baseVertex;		// in the layout's vertex buffer
+		GLuint firstIndex;		// in the index buffer
+		GLintptr vertexOffset;	// in bytes, for the upload
+		GLintptr indexOffset;
+		GLintptr positionOffset;	// in the layout's position stream, if it has one
+	};
+
+	// a range Compact() moved, in vertices or indices
+	struct Move
+	{
+		int buffer;				// vertex layout, or INDEX_BUFFER
+		GLuint from;
+		GLuint to;
+	};
+
+	struct Stats
+	{
+		GLsizeiptr capacity;
+		GLsizeiptr used;
+		GLsizeiptr largestFree;
+		int freeRanges;
+		int allocations;
+		double fragmentation;
+	};
+
+	// creates the buffers and the vertex arrays, with a draw index stream for drawCapacity draws. Needs
+	// a current GL 4.4 context; vertex arrays are not shared between contexts, so it has to be the
+	// context that draws
+	void Initialize(const GLsizeiptr vertexCapacity[LAYOUT_COUNT], GLsizeiptr indexCapacity, GLuint drawCapacity)
+	{
+		std::vector<GLint> drawIndices(drawCapacity > 0 ? drawCapacity : 1);
+		for (size_t i = 0; i < drawIndices.size(); ++i)
+			drawIndices[i] = (GLint)i;
+		this->drawCapacity = (GLuint)drawIndices.size();
+		drawIndexBuffer = createBuffer((GLsizeiptr)(drawIndices.size() * sizeof(GLint)), drawIndices.data());
+
+		for (int layout = 0; layout < LAYOUT_COUNT; ++layout)
+		{
+			GLsizeiptr stride = Stride(layout);
+			GLsizeiptr capacity = (vertexCapacity[layout] + stride - 1) / stride * stride;
+			allocators[layout].Initialize((size_t)capacity);
+			buffers[layout] = createBuffer(capacity);
+
+			glGenVertexArrays(1, &vertexArrays[layout]);
+			glBindVertexArray(vertexArrays[layout]);
+			setVertexFormat((GLuint)layout);
+			glBindVertexBuffer(0, buffers[layout], 0, (GLsizei)stride);
+			glBindVertexBuffer(1, drawIndexBuffer, 0, sizeof(GLint));
+
+			// a position-only layout is its own position stream
+			depthVertexArrays[layout] = vertexArrays[layout];
+			if (!HasPositionStream((GLuint)layout))
+				continue;
+			positionBuffers[layout] = createBuffer(capacity / stride * POSITION_STRIDE);
+			glGenVertexArrays(1, &depthVertexArrays[layout]);
+			glBindVertexArray(depthVertexArrays[layout]);
+			setVertexFormat(SceneFormat::LAYOUT_POSITION);
+			glBindVertexBuffer(0, positionBuffers[layout], 0, POSITION_STRIDE);
+			glBindVertexBuffer(1, drawIndexBuffer, 0, sizeof(GLint));
+		}
+
+		allocators[INDEX_BUFFER].Initialize((size_t)indexCapacity);
+		buffers[INDEX_BUFFER] = createBuffer(indexCapacity);
+		for (int layout = 0; layout < LAYOUT_COUNT; ++layout)
+		{
+			glBindVertexArray(vertexArrays[layout]);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[INDEX_BUFFER]);
+			glBindVertexArray(depthVertexArrays[layout]);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[INDEX_BUFFER]);
+		}
+		glBindVertexArray(0);
+	}
+
+	void Destroy()
+	{
+		for (int layout = 0; layout < LAYOUT_COUNT; ++layout)
+		{
+			if (HasPositionStream((GLuint)layout))
+				glDeleteVertexArrays(1, &depthVertexArrays[layout]);
+			depthVertexArrays[layout] = 0;
+		}
+		glDeleteVertexArrays(LAYOUT_COUNT, vertexArrays);
+		glDeleteBuffers(LAYOUT_COUNT + 1, buffers);
+		glDeleteBuffers(LAYOUT_COUNT, positionBuffers);
+		glDeleteBuffers(1, &drawIndexBuffer);
+		drawIndexBuffer = 0;
+		for (int i = 0; i <= LAYOUT_COUNT; ++i)
+		{
+			buffers[i] = 0;
+			allocators[i].Initialize(0);
+		}
+		for (int layout = 0; layout < LAYOUT_COUNT; ++layout)
+		{
+			vertexArrays[layout] = 0;
+			positionBuffers[layout] = 0;
+		}
+	}
+
+	// reserves the ranges of a mesh; false when either buffer has no free range large enough
+	bool Allocate(GLuint layout, GLuint vertexCount, GLuint indexCount, Allocation& allocation)
+	{
+		if (layout >= (GLuint)LAYOUT_COUNT)
+			return false;
+
+		size_t stride = (size_t)Stride(layout);
+		size_t vertexOffset = 0;
+		size_t indexOffset = 0;
+		if (!allocators[layout].Allocate(vertexCount * stride, stride, vertexOffset))
+			return false;
+		if (indexCount > 0 && !allocators[INDEX_BUFFER].Allocate(indexCount * sizeof(GLuint), sizeof(GLuint), indexOffset))
+		{
+			allocators[layout].Free(vertexOffset);
+			return false;
+		}
+
+		allocation.baseVertex = (GLint)(vertexOffset / stride);
+		allocation.firstIndex = (GLuint)(indexOffset / sizeof(GLuint));
+		allocation.vertexOffset = (GLintptr)vertexOffset;
+		allocation.indexOffset = (GLintptr)indexOffset;
+		allocation.positionOffset = (GLintptr)allocation.baseVertex * POSITION_STRIDE;
+		return true;
+	}
+
+	// releases the ranges of a mesh, as Allocate() returned them
+	void Free(GLuint layout, GLint baseVertex, GLuint firstIndex, bool indexed)
+	{
+		if (layout >= (GLuint)LAYOUT_COUNT)
+			return;
+		allocators[layout].Free((size_t)baseVertex * (size_t)Stride(layout));
+		if (indexed)
+			allocators[INDEX_BUFFER].Free((size_t)firstIndex * sizeof(GLuint));
+		freedSinceCompact = true;
+	}
+
+	// true when meshes were freed since the last compaction and some buffer's free space is splintered
+	// beyond threshold (see RangeAllocator::Fragmentation)
+	bool NeedsCompaction(double threshold) const
+	{
+		if (!freedSinceCompact)
+			return false;
+		for (int i = 0; i <= LAYOUT_COUNT; ++i)
+		{
+			if (allocators[i].Fragmentation() > threshold)
+				return true;
+		}
+		return false;
+	}
+
+	// copies the live ranges of every buffer, packed, into a new buffer of the same size and points
+	// the vertex arrays at the new buffers. The GPU copies; the old buffers are deleted once the
+	// frames in flight are done with them. moves lists the ranges whose start changed
+	void Compact(std::vector<Move>& moves)
+	{
+		moves.clear();
+		std::vector<RangeAllocator::Move> ranges;
+		for (int i = 0; i <= LAYOUT_COUNT; ++i)
+		{
+			allocators[i].Compact(ranges);
+			size_t elementSize = i == INDEX_BUFFER ? sizeof(GLuint) : (size_t)Stride((GLuint)i);
+			buffers[i] = compactBuffer(buffers[i], (GLsizeiptr)allocators[i].Capacity(), ranges, 1, 1);
+			for (const RangeAllocator::Move& range : ranges)
+			{
+				if (range.from != range.to)
+					moves.push_back({ i, (GLuint)(range.from / elementSize), (GLuint)(range.to / elementSize) });
+			}
+
+			// the position stream moves with its vertices
+			if (i < LAYOUT_COUNT && HasPositionStream((GLuint)i))
+				positionBuffers[i] = compactBuffer(positionBuffers[i], (GLsizeiptr)(allocators[i].Capacity() / elementSize * POSITION_STRIDE),
+					ranges, POSITION_STRIDE, elementSize);
+		}
+
+		for (int layout = 0; layout < LAYOUT_COUNT; ++layout)
+		{
+			glBindVertexArray(vertexArrays[layout]);
+			glBindVertexBuffer(0, buffers[layout], 0, Stride((GLuint)layout));
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[INDEX_BUFFER]);
+			if (!HasPositionStream((GLuint)layout))
+				continue;
+			glBindVertexArray(depthVertexArrays[layout]);
+			glBindVertexBuffer(0, positionBuffers[layout], 0, POSITION_STRIDE);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[INDEX_BUFFER]);
+		}
+		glBindVertexArray(0);
+		freedSinceCompact = false;
+	}
+
+	GLuint VertexArray(GLuint layout) const
+	{
+		return vertexArrays[layout];
+	}
+
+	GLuint VertexBuffer(GLuint layout) const
+	{
+		return buffers[layout];
+	}
+
+	// the vertex array of a depth-only pass: positions and draw index only
+	GLuint DepthVertexArray(GLuint layout) const
+	{
+		return depthVertexArrays[layout];
+	}
+
+	// 0 for a layout without a position stream
+	GLuint PositionBuffer(GLuint layout) const
+	{
+		return positionBuffers[layout];
+	}
+
+	GLuint IndexBuffer() const
+	{
+		return buffers[INDEX_BUFFER];
+	}
+
+	// base instances below this have a draw index
+	GLuint DrawCapacity() const
+	{
+		return drawCapacity;
+	}
+
+	// buffer: a vertex layout, or INDEX_BUFFER
+	Stats BufferStats(int buffer) const
+	{
+		const RangeAllocator& allocator = allocators[buffer];
+		return { (GLsizeiptr)allocator.Capacity(), (GLsizeiptr)allocator.UsedBytes(), (GLsizeiptr)allocator.LargestFree(),
+			allocator.FreeRangeCount(), allocator.AllocationCount(), allocator.Fragmentation() };
+	}
+
+	static GLsizei Stride(GLuint layout)
+	{
+		return (GLsizei)(SceneFormat::FloatsPerVertex(layout) * sizeof(float));
+	}
+
+	// true for the layouts whose positions are also kept in a position stream
+	static bool HasPositionStream(GLuint layout)
+	{
+		return Stride(layout) > POSITION_STRIDE;
+	}
+
+private:
+	RangeAllocator allocators[LAYOUT_COUNT + 1];	// vertex layouts, then the index buffer
+	GLuint buffers[LAYOUT_COUNT + 1] = {};
+	GLuint vertexArrays[LAYOUT_COUNT] = {};
+	GLuint positionBuffers[LAYOUT_COUNT] = {};
+	GLuint depthVertexArrays[LAYOUT_COUNT] = {};
+	GLuint drawIndexBuffer = 0;
+	GLuint drawCapacity = 0;
+	bool freedSinceCompact = false;
+
+	static GLuint createBuffer(GLsizeiptr size, const void* data = NULL)
+	{
+		GLuint buffer = 0;
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glBufferStorage(GL_COPY_WRITE_BUFFER, size > 0 ? size : 1, data, GL_DYNAMIC_STORAGE_BIT);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		return buffer;
+	}
+
+	// copies the packed ranges of buffer into a new buffer of capacity bytes and deletes buffer. The
+	// ranges are in bytes of elements of size elementSize; in the new buffer an element takes
+	// copySize bytes, so a position stream follows the moves of its interleaved vertices
+	static GLuint compactBuffer(GLuint buffer, GLsizeiptr capacity, const std::vector<RangeAllocator::Move>& ranges, size_t copySize, size_t elementSize)
+	{
+		GLuint packed = createBuffer(capacity);
+		glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, packed);
+		for (const RangeAllocator::Move& range : ranges)
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (GLintptr)(range.from / elementSize * copySize),
+				(GLintptr)(range.to / elementSize * copySize), (GLsizeiptr)(range.size / elementSize * copySize));
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		glDeleteBuffers(1, &buffer);
+		return packed;
+	}
+
+	// attribute locations as the shaders declare them: position 0, normal 1, UV 2, all read through
+	// vertex buffer binding 0, and the draw index, read once per instance through binding 1
+	static void setVertexFormat(GLuint layout)
+	{
+		glVertexAttribIFormat(DRAW_INDEX_LOCATION, 1, GL_INT, 0);
+		glVertexAttribBinding(DRAW_INDEX_LOCATION, 1);
+		glVertexBindingDivisor(1, 1);
+		glEnableVertexAttribArray(DRAW_INDEX_LOCATION);
+
+		glVertexAttribFormat(0, 3, GL_FLOAT, GL_FALSE, 0);
+		glVertexAttribBinding(0, 0);
+		glEnableVertexAttribArray(0);
+		if (layout == SceneFormat::LAYOUT_POSITION_NORMAL_UV)
+		{
+			glVertexAttribFormat(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float));
+			glVertexAttribBinding(1, 0);
+			glEnableVertexAttribArray(1);
+
+			glVertexAttribFormat(2, 2, GL_FLOAT, GL_FALSE, 6 * sizeof(float));
+			glVertexAttribBinding(2, 0);
+			glEnableVertexAttribArray(2);
+		}
+	}
+};
+#endif
@@ -0,0 +1,155 @@
+#ifndef HI_Z_PYRAMID_H
+#define HI_Z_PYRAMID_H
+
+// The OpenGL loader (GLEW or glad) has to be included before this header
+
+#include <glm/glm.hpp>
+
+// Hierarchical depth of the last frame drawn, for occlusion culling. Build() copies the depth buffer
+// into a texture, then shaders/hiz.comp reduces it level by level into a mipmapped R32F texture whose
+// every texel holds the farthest depth of the pixels it covers: level 0 is half the framebuffer, each
+// level after it half the one before, rounded down, with the last texel of an odd row or column
+// covering three. A box whose nearest depth lies behind the farthest depth of the texels its screen
+// rectangle touches is hidden, and a rectangle of any size needs four texels of the level where it
+// spans at most two. Framebuffer pixel p lies in texel min(p >> (level + 1), level size - 1).
+//
+// The pyramid keeps the view-projection it was drawn with: the next frame projects its objects with
+// it, not with its own camera, so a camera move does not break the test. Objects that move do: an
+// occluder that moved away since the pyramid was drawn, like the orbiting key lamp, can still hide
+// what is now visible behind its old place for a frame.
+class HiZPyramid
+{
+public:
+	static const GLuint GROUP_SIZE = 8;		// local_size_x and local_size_y of hiz.comp
+
+	// (re)creates the textures for a framebuffer size. Needs a current GL 4.4 context; the pyramid is
+	// invalid until the next Build()
+	void Resize(int framebufferWidth, int framebufferHeight)
+	{
+		Destroy();
+		if (framebufferWidth <= 0 || framebufferHeight <= 0)
+			return;
+
+		this->framebufferWidth = framebufferWidth;
+		this->framebufferHeight = framebufferHeight;
+		width = framebufferWidth / 2 > 0 ? framebufferWidth / 2 : 1;
+		height = framebufferHeight / 2 > 0 ? framebufferHeight / 2 : 1;
+		levels = 1;
+		for (int size = width > height ? width : height; size > 1; size /= 2)
+			++levels;
+
+		glGenTextures(1, &depthTexture);
+		glBindTexture(GL_TEXTURE_2D, depthTexture);
+		glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT24, framebufferWidth, framebufferHeight);
+		setNearest(GL_NEAREST);
+
+		glGenTextures(1, &pyramid);
+		glBindTexture(GL_TEXTURE_2D, pyramid);
+		glTexStorage2D(GL_TEXTURE_2D, levels, GL_R32F, width, height);
+		setNearest(GL_NEAREST_MIPMAP_NEAREST);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	void Destroy()
+	{
+		glDeleteTextures(1, &depthTexture);
+		glDeleteTextures(1, &pyramid);
+		depthTexture = 0;
+		pyramid = 0;
+		valid = false;
+	}
+
+	// copies the depth of the read framebuffer, which has to match the size given to Resize(), and
+	// builds the levels. viewProjection is the camera the depth was drawn with. Uses texture unit 0
+	void Build(GLuint programId, const glm::mat4& viewProjection)
+	{
+		if (pyramid == 0)
+			return;
+
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, depthTexture);
+		glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, framebufferWidth, framebufferHeight);
+
+		glUseProgram(programId);
+		GLint sourceLevelLoc = glGetUniformLocation(programId, "sourceLevel");
+		int levelWidth = width;
+		int levelHeight = height;
+		for (int level = 0; level < levels; ++level)
+		{
+			// level 0 reduces the depth copy, every other level the one before it
+			glBindTexture(GL_TEXTURE_2D, level == 0 ? depthTexture : pyramid);
+			glUniform1i(sourceLevelLoc, level == 0 ? 0 : level - 1);
+			glBindImageTexture(0, pyramid, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+			glDispatchCompute((levelWidth + GROUP_SIZE - 1) / GROUP_SIZE, (levelHeight + GROUP_SIZE - 1) / GROUP_SIZE, 1);
+			glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+			levelWidth = levelWidth / 2 > 0 ? levelWidth / 2 : 1;
+			levelHeight = levelHeight / 2 > 0 ? levelHeight / 2 : 1;
+		}
+		glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		this->viewProjection = viewProjection;
+		valid = true;
+	}
+
+	// marks the pyramid as out of date, until the next Build()
+	void Invalidate()
+	{
+		valid = false;
+	}
+
+	// false until the first Build() after a Resize() or Invalidate()
+	bool IsValid() const
+	{
+		return valid;
+	}
+
+	GLuint Texture() const
+	{
+		return pyramid;
+	}
+
+	int Levels() const
+	{
+		return levels;
+	}
+
+	// the size given to Resize(), in pixels; the culling maps screen positions to texels with it
+	int FramebufferWidth() const
+	{
+		return framebufferWidth;
+	}
+
+	int FramebufferHeight() const
+	{
+		return framebufferHeight;
+	}
+
+	// the camera the pyramid's depth was drawn with
+	const glm::mat4& ViewProjection() const
+	{
+		return viewProjection;
+	}
+
+private:
+	GLuint depthTexture = 0;
+	GLuint pyramid = 0;
+	int framebufferWidth = 0;
+	int framebufferHeight = 0;
+	int width = 0;		// of level 0
+	int height = 0;
+	int levels = 0;
+	glm::mat4 viewProjection = glm::mat4(1.0f);
+	bool valid = false;
+
+	// the texels are read with texelFetch only, but a complete texture needs filters its levels satisfy
+	static void setNearest(GLint minFilter)
+	{
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+};
+#endif
@@ -0,0 +1,109 @@
+#ifndef INPUT_SYSTEM_H
+#define INPUT_SYSTEM_H
+
+// GLFW has to be included before this header
+
+// Collects GLFW input events between frames. Cursor motion is coalesced into one delta per frame,
+// so the camera turns once per frame no matter how many events a high-rate mouse delivers, and key
+// state is tracked from key events instead of polling glfwGetKey for every key each frame.
+// The time of the oldest unconsumed event is kept for latency measurements.
+class InputSystem
+{
+public:
+	// asks for unaccelerated, unscaled mouse motion when the cursor is disabled
+	bool EnableRawMouseMotion(GLFWwindow* window)
+	{
+		if (!glfwRawMouseMotionSupported())
+			return false;
+		glfwSetInputMode(window, GLFW_RAW_MOUSE_MOTION, GLFW_TRUE);
+		return true;
+	}
+
+	// forward from the GLFW cursor position callback
+	void OnCursorPos(double xpos, double ypos)
+	{
+		if (!hasCursor)
+		{
+			// the first event only establishes the reference position
+			lastX = xpos;
+			lastY = ypos;
+			hasCursor = true;
+			return;
+		}
+
+		deltaX += xpos - lastX;
+		deltaY += lastY - ypos; // reversed since y-coordinates go from bottom to top
+		lastX = xpos;
+		lastY = ypos;
+		noteEvent();
+	}
+
+	// forward from the GLFW key callback
+	void OnKey(int key, int action)
+	{
+		if (key < 0 || key > GLFW_KEY_LAST)
+			return;
+		if (action == GLFW_PRESS)
+		{
+			down[key] = true;
+			pressed[key] = true;
+			noteEvent();
+		}
+		else if (action == GLFW_RELEASE)
+		{
+			down[key] = false;
+			noteEvent();
+		}
+	}
+
+	bool IsKeyDown(int key) const
+	{
+		return key >= 0 && key <= GLFW_KEY_LAST && down[key];
+	}
+
+	// true once per key press, however long the key is held
+	bool WasKeyPressed(int key)
+	{
+		if (key < 0 || key > GLFW_KEY_LAST || !pressed[key])
+			return false;
+		pressed[key] = false;
+		return true;
+	}
+
+	// returns the cursor motion accumulated since the last call and resets it. False if the mouse did not move
+	bool ConsumeMouseDelta(float& xoffset, float& yoffset)
+	{
+		xoffset = (float)deltaX;
+		yoffset = (float)deltaY;
+		deltaX = 0.0;
+		deltaY = 0.0;
+		return xoffset != 0.0f || yoffset != 0.0f;
+	}
+
+	// glfwGetTime() of the oldest event since the last call, or a negative value if there was none
+	double TakeInputTime()
+	{
+		double time = firstEventTime;
+		firstEventTime = -1.0;
+		return time;
+	}
+
+private:
+	bool down[GLFW_KEY_LAST + 1] = {};
+	bool pressed[GLFW_KEY_LAST + 1] = {};
+
+	bool hasCursor = false;
+	double lastX = 0.0;
+	double lastY = 0.0;
+	double deltaX = 0.0;
+	double deltaY = 0.0;
+
+	double firstEventTime = -1.0;
+
+	void noteEvent()
+	{
+		if (firstEventTime < 0.0)
+			firstEventTime = glfwGetTime();
+	}
+};
+#endif
@@ -0,0 +1,340 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+// Work-stealing job scheduler. Each worker thread owns a deque: it pushes and pops its own jobs at the
+// back (newest first, while their data is still in cache) and, when it runs dry, steals the oldest job
+// from the front of another worker's deque. Jobs submitted from outside the workers are dealt out
+// round-robin.
+//
+// There is one worker per core minus one, the main thread's. Threads that are not workers (the main
+// and the render thread) hand work out and block in Wait() instead of running jobs, so they never get
+// stuck in a long job in the middle of a frame. A worker that waits runs other jobs meanwhile.
+//
+// Completion is tracked with Counters: Run() increments the counter it is given and the job
+// decrements it when done. A job can also be made to wait for a counter; it is queued only once that
+// counter reaches zero, which chains stages without blocking a thread.
+class JobSystem
+{
+public:
+	typedef std::function<void()> Job;
+
+	// number of unfinished jobs, plus the jobs waiting for it to reach zero
+	class Counter
+	{
+	public:
+		Counter() = default;
+		Counter(const Counter&) = delete;
+		Counter& operator=(const Counter&) = delete;
+
+		bool IsDone() const
+		{
+			return pending.load(std::memory_order_acquire) == 0;
+		}
+
+	private:
+		friend class JobSystem;
+
+		std::atomic<int> pending{ 0 };
+		std::mutex mutex;
+		std::condition_variable done;
+		std::vector<Job> continuations;
+	};
+
+	// per-worker counters since the last ResetStats()
+	struct WorkerStats
+	{
+		unsigned long long jobs;
+		unsigned long long steals;
+		double busySeconds;
+		double utilization;		// busy time over the time since the reset
+	};
+
+	JobSystem() = default;
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	~JobSystem()
+	{
+		Destroy();
+	}
+
+	// starts the workers; 0 means one per core, the main thread's core excepted
+	void Initialize(int workerCount = 0)
+	{
+		if (!workers.empty())
+			return;
+		if (workerCount <= 0)
+			workerCount = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+
+		stopping = false;
+		for (int i = 0; i < workerCount; ++i)
+			workers.push_back(std::unique_ptr<Worker>(new Worker()));
+		ResetStats();
+		for (int i = 0; i < workerCount; ++i)
+			workers[i]->thread = std::thread(&JobSystem::workerLoop, this, i);
+	}
+
+	// finishes the queued jobs and joins the workers
+	void Destroy()
+	{
+		if (workers.empty())
+			return;
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (std::unique_ptr<Worker>& worker : workers)
+			worker->thread.join();
+		workers.clear();
+	}
+
+	int WorkerCount() const
+	{
+		return (int)workers.size();
+	}
+
+	// queues job; counter, if any, counts it until it has run
+	void Run(Job job, Counter* counter = nullptr)
+	{
+		if (counter != nullptr)
+			counter->pending.fetch_add(1, std::memory_order_relaxed);
+		schedule(wrap(std::move(job), counter));
+	}
+
+	// queues job once after reaches zero, right away if it already has
+	void RunAfter(Counter& after, Job job, Counter* counter = nullptr)
+	{
+		if (counter != nullptr)
+			counter->pending.fetch_add(1, std::memory_order_relaxed);
+		Job wrapped = wrap(std::move(job), counter);
+		{
+			std::lock_guard<std::mutex> lock(after.mutex);
+			if (after.pending.load(std::memory_order_acquire) != 0)
+			{
+				after.continuations.push_back(std::move(wrapped));
+				return;
+			}
+		}
+		schedule(std::move(wrapped));
+	}
+
+	// returns when counter reaches zero. Workers run other jobs meanwhile, other threads sleep
+	void Wait(Counter& counter)
+	{
+		int self = currentWorker();
+		if (self < 0 || workers.empty())
+		{
+			std::unique_lock<std::mutex> lock(counter.mutex);
+			counter.done.wait(lock, [&]() { return counter.IsDone(); });
+			return;
+		}
+
+		while (!counter.IsDone())
+		{
+			Job job;
+			if (findJob(self, job))
+				execute(self, job);
+			else
+				std::this_thread::yield();
+		}
+		// the last job may still be inside finish(); the counter must outlive it
+		std::lock_guard<std::mutex> lock(counter.mutex);
+	}
+
+	// runs body(i) for every i in [0, count) on the workers and waits for all of them. Neighbouring
+	// indices are batched into a few jobs per worker, enough for stealing to even out uneven work
+	void ParallelFor(int count, const std::function<void(int)>& body)
+	{
+		if (count <= 0)
+			return;
+		if (workers.empty() || count == 1)
+		{
+			for (int i = 0; i < count; ++i)
+				body(i);
+			return;
+		}
+
+		int batches = std::min(count, (int)workers.size() * 4);
+		int batchSize = (count + batches - 1) / batches;
+		Counter counter;
+		for (int first = 0; first < count; first += batchSize)
+		{
+			int last = std::min(count, first + batchSize);
+			Run([&body, first, last]()
+			{
+				for (int i = first; i < last; ++i)
+					body(i);
+			}, &counter);
+		}
+		Wait(counter);
+	}
+
+	// the scheduler in the form the TransformPipeline and VirtualFileSystem batch functions take
+	std::function<void(int, const std::function<void(int)>&)> ParallelForFunction()
+	{
+		return [this](int count, const std::function<void(int)>& body) { ParallelFor(count, body); };
+	}
+
+	WorkerStats Stats(int worker) const
+	{
+		const Worker& w = *workers[worker];
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - statsStart).count();
+		double busy = w.busyNanoseconds.load(std::memory_order_relaxed) * 1e-9;
+		return { w.executed.load(std::memory_order_relaxed), w.steals.load(std::memory_order_relaxed), busy, elapsed > 0.0 ? busy / elapsed : 0.0 };
+	}
+
+	void ResetStats()
+	{
+		for (std::unique_ptr<Worker>& worker : workers)
+		{
+			worker->executed = 0;
+			worker->steals = 0;
+			worker->busyNanoseconds = 0;
+		}
+		statsStart = std::chrono::steady_clock::now();
+	}
+
+private:
+	struct Worker
+	{
+		std::thread thread;
+		std::mutex mutex;			// guards queue; the owner works at the back, thieves at the front
+		std::deque<Job> queue;
+		std::atomic<unsigned long long> executed{ 0 };
+		std::atomic<unsigned long long> steals{ 0 };
+		std::atomic<long long> busyNanoseconds{ 0 };
+	};
+
+	std::vector<std::unique_ptr<Worker>> workers;
+	std::atomic<unsigned int> nextWorker{ 0 };
+	std::atomic<int> queued{ 0 };			// jobs in all deques, so idle workers know when to sleep
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	bool stopping = false;
+	std::chrono::steady_clock::time_point statsStart;
+
+	static int& currentWorker()
+	{
+		thread_local int index = -1;
+		return index;
+	}
+
+	Job wrap(Job job, Counter* counter)
+	{
+		if (counter == nullptr)
+			return job;
+		return [this, job, counter]()
+		{
+			job();
+			finish(*counter);
+		};
+	}
+
+	// the last job of a counter releases its continuations and wakes the threads waiting for it
+	void finish(Counter& counter)
+	{
+		std::vector<Job> continuations;
+		{
+			std::lock_guard<std::mutex> lock(counter.mutex);
+			if (counter.pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+				return;
+			continuations.swap(counter.continuations);
+			counter.done.notify_all();
+		}
+		for (Job& job : continuations)
+			schedule(std::move(job));
+	}
+
+	void schedule(Job job)
+	{
+		if (workers.empty())
+		{
+			job();
+			return;
+		}
+
+		int self = currentWorker();
+		int target = self >= 0 ? self : (int)(nextWorker++ % workers.size());
+		{
+			std::lock_guard<std::mutex> lock(workers[target]->mutex);
+			workers[target]->queue.push_back(std::move(job));
+		}
+		queued.fetch_add(1, std::memory_order_release);
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+		}
+		wake.notify_one();
+	}
+
+	// own deque first (newest job), then the oldest job of the other workers in turn
+	bool findJob(int self, Job& job)
+	{
+		{
+			Worker& own = *workers[self];
+			std::lock_guard<std::mutex> lock(own.mutex);
+			if (!own.queue.empty())
+			{
+				job = std::move(own.queue.back());
+				own.queue.pop_back();
+				queued.fetch_sub(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+
+		for (size_t n = 1; n < workers.size(); ++n)
+		{
+			Worker& victim = *workers[(self + n) % workers.size()];
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			if (!victim.queue.empty())
+			{
+				job = std::move(victim.queue.front());
+				victim.queue.pop_front();
+				queued.fetch_sub(1, std::memory_order_relaxed);
+				workers[self]->steals.fetch_add(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void execute(int self, Job& job)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		job();
+		long long elapsed = (long long)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		workers[self]->busyNanoseconds.fetch_add(elapsed, std::memory_order_relaxed);
+		workers[self]->executed.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void workerLoop(int self)
+	{
+		currentWorker() = self;
+		while (true)
+		{
+			Job job;
+			if (findJob(self, job))
+			{
+				execute(self, job);
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(sleepMutex);
+			if (stopping && queued.load(std::memory_order_acquire) == 0)
+				return;
+			wake.wait(lock, [this]() { return stopping || queued.load(std::memory_order_acquire) > 0; });
+		}
+	}
+};
+#endif
@@ -0,0 +1,278 @@
+#ifndef LIGHT_GRID_H
+#define LIGHT_GRID_H
+
+// The OpenGL loader (GLEW or glad) has to be included before this header
+
+#include <cmath>
+#include <functional>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define LIGHT_GRID_SSE
+#endif
+
+// The view frustum cut into GRID_X x GRID_Y tiles on screen and GRID_Z slices in depth, with the list
+// of point lights that reach into each of these clusters, for clustered forward shading
+// (shaders/include/light_grid.glsl). The slices grow exponentially from the near plane to the far
+// plane, so the clusters keep roughly the same proportions at every depth.
+//
+// Build() runs on the CPU and touches no GL state. It moves the lights into view space, then every
+// depth slice is a task of its own: it tests the lights whose depth range touches the slice against
+// the slice's cluster boxes, four boxes per SSE instruction, and only writes its own clusters, so the
+// tasks share nothing. A serial pass packs the per-cluster lists into one index array. The cluster
+// boxes are rebuilt only when the projection changes.
+class LightGrid
+{
+public:
+	static const int GRID_X = 16;		// LIGHT_GRID_X, _Y and _Z in shaders/include/light_grid.glsl
+	static const int GRID_Y = 9;
+	static const int GRID_Z = 24;
+	static const int TILE_COUNT = GRID_X * GRID_Y;	// clusters per slice, a multiple of 4
+	static const int CLUSTER_COUNT = TILE_COUNT * GRID_Z;
+	static const size_t MAX_LIGHTS_PER_CLUSTER = 256;
+
+	// std430 layout of Cluster in light_grid.glsl: a range of the light index array
+	struct Cluster
+	{
+		GLuint offset;
+		GLuint count;
+	};
+
+	// Calls body(0) .. body(count - 1), possibly in parallel, and returns when all calls are done
+	typedef std::function<void(int count, const std::function<void(int)>& body)> ParallelFor;
+
+	// indexCapacity is the most light indices a frame keeps: past it the farthest clusters lose lights
+	void Initialize(size_t indexCapacity)
+	{
+		this->indexCapacity = indexCapacity;
+		clusters.assign(CLUSTER_COUNT, { 0, 0 });
+		lists.assign(CLUSTER_COUNT, std::vector<GLuint>());
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			boxMin[axis].assign(CLUSTER_COUNT, 0.0f);
+			boxMax[axis].assign(CLUSTER_COUNT, 0.0f);
+		}
+		indices.reserve(indexCapacity);
+		cachedProjection = glm::mat4(0.0f);
+	}
+
+	// assigns lightCount point lights to the clusters of a camera with a glm::perspective projection.
+	// Each light starts with a vec4 of its world position and radius, stride bytes after the one before.
+	// Clusters() and LightIndices() then hold the result, the indices counting lights from the first
+	void Build(const glm::mat4& view, const glm::mat4& projection, const void* lights, size_t lightCount, size_t stride,
+		const ParallelFor& parallelFor)
+	{
+		if (projection != cachedProjection)
+			buildClusterBoxes(projection);
+
+		// View-space spheres and the slices each one reaches; the camera looks down -z
+		spheres.resize(lightCount);
+		for (size_t i = 0; i < lightCount; ++i)
+		{
+			const glm::vec4& light = *(const glm::vec4*)((const char*)lights + i * stride);
+			glm::vec4 center = view * glm::vec4(light.x, light.y, light.z, 1.0f);
+			float radius = light.w;
+			float depth = -center.z;
+			Sphere& sphere = spheres[i];
+			sphere.x = center.x;
+			sphere.y = center.y;
+			sphere.z = center.z;
+			sphere.radius = radius;
+			if (depth + radius < nearPlane || depth - radius > farPlane)
+			{
+				sphere.firstSlice = 1;
+				sphere.lastSlice = 0;
+				continue;
+			}
+			sphere.firstSlice = sliceOf(depth - radius);
+			sphere.lastSlice = sliceOf(depth + radius);
+		}
+
+		parallelFor(GRID_Z, [this](int slice) { assignSlice(slice); });
+
+		// Pack the lists, nearest slices first, so a full index array cuts the far clusters
+		indices.clear();
+		dropped = 0;
+		for (int c = 0; c < CLUSTER_COUNT; ++c)
+		{
+			const std::vector<GLuint>& list = lists[c];
+			size_t count = list.size();
+			if (count > indexCapacity - indices.size())
+			{
+				dropped += count - (indexCapacity - indices.size());
+				count = indexCapacity - indices.size();
+			}
+			clusters[c] = { (GLuint)indices.size(), (GLuint)count };
+			indices.insert(indices.end(), list.begin(), list.begin() + count);
+		}
+		for (int slice = 0; slice < GRID_Z; ++slice)
+			dropped += sliceDropped[slice];
+	}
+
+	const std::vector<Cluster>& Clusters() const
+	{
+		return clusters;
+	}
+
+	const std::vector<GLuint>& LightIndices() const
+	{
+		return indices;
+	}
+
+	size_t IndexCapacity() const
+	{
+		return indexCapacity;
+	}
+
+	// light references the last Build() left out, over MAX_LIGHTS_PER_CLUSTER or the index capacity
+	size_t DroppedLights() const
+	{
+		return dropped;
+	}
+
+	// what the shaders need to find a fragment's cluster: x = near plane, y = slices per unit of
+	// log(depth), z and w = tiles per pixel across and down
+	glm::vec4 ShaderParameters(int viewportWidth, int viewportHeight) const
+	{
+		return glm::vec4(nearPlane, sliceScale, viewportWidth > 0 ? (float)GRID_X / viewportWidth : 0.0f,
+			viewportHeight > 0 ? (float)GRID_Y / viewportHeight : 0.0f);
+	}
+
+private:
+	struct Sphere
+	{
+		float x, y, z;		// view space
+		float radius;
+		int firstSlice;		// empty when firstSlice > lastSlice
+		int lastSlice;
+	};
+
+	size_t indexCapacity = 0;
+	std::vector<Cluster> clusters;
+	std::vector<GLuint> indices;
+	std::vector<std::vector<GLuint>> lists;		// per cluster; the capacity is kept from frame to frame
+	std::vector<float> boxMin[3];				// view-space cluster boxes, x, y and z in separate arrays
+	std::vector<float> boxMax[3];
+	std::vector<Sphere> spheres;
+	size_t sliceDropped[GRID_Z] = {};
+	size_t dropped = 0;
+
+	glm::mat4 cachedProjection = glm::mat4(0.0f);
+	float nearPlane = 0.1f;
+	float farPlane = 100.0f;
+	float sliceScale = 1.0f;
+
+	int sliceOf(float depth) const
+	{
+		if (depth <= nearPlane)
+			return 0;
+		int slice = (int)(std::log(depth / nearPlane) * sliceScale);
+		return slice < GRID_Z ? slice : GRID_Z - 1;
+	}
+
+	// the boxes around each cluster's piece of the frustum, between the slice's near and far depth
+	void buildClusterBoxes(const glm::mat4& projection)
+	{
+		cachedProjection = projection;
+		nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+		farPlane = projection[3][2] / (projection[2][2] + 1.0f);
+		sliceScale = GRID_Z / std::log(farPlane / nearPlane);
+
+		for (int slice = 0; slice < GRID_Z; ++slice)
+		{
+			float nearDepth = nearPlane * std::pow(farPlane / nearPlane, (float)slice / GRID_Z);
+			float farDepth = nearPlane * std::pow(farPlane / nearPlane, (float)(slice + 1) / GRID_Z);
+			for (int y = 0; y < GRID_Y; ++y)
+			{
+				for (int x = 0; x < GRID_X; ++x)
+				{
+					// a tile's edges in normalized device coordinates, scaled out to view space at both depths
+					float ndcX[2] = { -1.0f + 2.0f * x / GRID_X, -1.0f + 2.0f * (x + 1) / GRID_X };
+					float ndcY[2] = { -1.0f + 2.0f * y / GRID_Y, -1.0f + 2.0f * (y + 1) / GRID_Y };
+					float depths[2] = { nearDepth, farDepth };
+					int cluster = (slice * GRID_Y + y) * GRID_X + x;
+					boxMin[0][cluster] = boxMin[1][cluster] = 1e30f;
+					boxMax[0][cluster] = boxMax[1][cluster] = -1e30f;
+					for (float depth : depths)
+					{
+						for (int i = 0; i < 2; ++i)
+						{
+							float viewX = ndcX[i] * depth / projection[0][0];
+							float viewY = ndcY[i] * depth / projection[1][1];
+							boxMin[0][cluster] = viewX < boxMin[0][cluster] ? viewX : boxMin[0][cluster];
+							boxMax[0][cluster] = viewX > boxMax[0][cluster] ? viewX : boxMax[0][cluster];
+							boxMin[1][cluster] = viewY < boxMin[1][cluster] ? viewY : boxMin[1][cluster];
+							boxMax[1][cluster] = viewY > boxMax[1][cluster] ? viewY : boxMax[1][cluster];
+						}
+					}
+					boxMin[2][cluster] = -farDepth;
+					boxMax[2][cluster] = -nearDepth;
+				}
+			}
+		}
+	}
+
+	// one task: the lists of the slice's clusters
+	void assignSlice(int slice)
+	{
+		int first = slice * TILE_COUNT;
+		for (int c = first; c < first + TILE_COUNT; ++c)
+			lists[c].clear();
+		sliceDropped[slice] = 0;
+
+		for (size_t light = 0; light < spheres.size(); ++light)
+		{
+			const Sphere& sphere = spheres[light];
+			if (slice < sphere.firstSlice || slice > sphere.lastSlice)
+				continue;
+
+#ifdef LIGHT_GRID_SSE
+			// squared distance from the center to each box, four boxes at a time
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 x = _mm_set1_ps(sphere.x);
+			const __m128 y = _mm_set1_ps(sphere.y);
+			const __m128 z = _mm_set1_ps(sphere.z);
+			const __m128 radiusSquared = _mm_set1_ps(sphere.radius * sphere.radius);
+			for (int c = first; c < first + TILE_COUNT; c += 4)
+			{
+				__m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&boxMin[0][c]), x), _mm_sub_ps(x, _mm_loadu_ps(&boxMax[0][c]))), zero);
+				__m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&boxMin[1][c]), y), _mm_sub_ps(y, _mm_loadu_ps(&boxMax[1][c]))), zero);
+				__m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&boxMin[2][c]), z), _mm_sub_ps(z, _mm_loadu_ps(&boxMax[2][c]))), zero);
+				__m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+				int mask = _mm_movemask_ps(_mm_cmple_ps(distanceSquared, radiusSquared));
+				for (int lane = 0; lane < 4; ++lane)
+				{
+					if ((mask & (1 << lane)) != 0)
+						add(slice, c + lane, (GLuint)light);
+				}
+			}
+#else
+			for (int c = first; c < first + TILE_COUNT; ++c)
+			{
+				float center[3] = { sphere.x, sphere.y, sphere.z };
+				float distanceSquared = 0.0f;
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					float d = boxMin[axis][c] - center[axis] > 0.0f ? boxMin[axis][c] - center[axis]
+						: (center[axis] - boxMax[axis][c] > 0.0f ? center[axis] - boxMax[axis][c] : 0.0f);
+					distanceSquared += d * d;
+				}
+				if (distanceSquared <= sphere.radius * sphere.radius)
+					add(slice, c, (GLuint)light);
+			}
+#endif
+		}
+	}
+
+	void add(int slice, int cluster, GLuint light)
+	{
+		if (lists[cluster].size() < MAX_LIGHTS_PER_CLUSTER)
+			lists[cluster].push_back(light);
+		else
+			++sliceDropped[slice];
+	}
+};
+#endif
@@ -11,6 +11,32 @@
 #define LINMATH_H_FUNC static inline
 #endif
 
+/* SIMD backend, chosen at compile time from the target's instruction set:
+ *   LINMATH_AVX2  AVX2 + FMA (MSVC /arch:AVX2, gcc/clang -mavx2 -mfma), implies LINMATH_SSE
+ *   LINMATH_SSE   SSE2, always available on x64
+ *   LINMATH_NEON  NEON on AArch64
+ * mat4x4_mul, mat4x4_mul_vec4, mat4x4_invert, mat4x4_look_at and quat_mul use it when
+ * available. The portable versions stay available as the *_scalar functions, for verification
+ * and benchmarks. Define LINMATH_NO_SIMD to use them everywhere. */
+#ifndef LINMATH_NO_SIMD
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+#define LINMATH_AVX2
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LINMATH_SSE
+#elif (defined(__ARM_NEON) || defined(_M_ARM64)) && (defined(__aarch64__) || defined(_M_ARM64))
+#define LINMATH_NEON
+#endif
+#endif
+
+#if defined(LINMATH_AVX2)
+#include <immintrin.h>
+#elif defined(LINMATH_SSE)
+#include <emmintrin.h>
+#elif defined(LINMATH_NEON)
+#include <arm_neon.h>
+#endif
+
 #define LINMATH_H_DEFINE_VEC(n) \
 typedef float vec##n[n]; \
 LINMATH_H_FUNC void vec##n##_add(vec##n r, vec##n const a, vec##n const b) \
@@ -158,7 +184,7 @@ LINMATH_H_FUNC void mat4x4_scale_aniso(mat4x4 M, mat4x4 a, float x, float y, flo
 		M[3][i] = a[3][i];
 	}
 }
-LINMATH_H_FUNC void mat4x4_mul(mat4x4 M, mat4x4 a, mat4x4 b)
+LINMATH_H_FUNC void mat4x4_mul_scalar(mat4x4 M, mat4x4 a, mat4x4 b)
 {
 	mat4x4 temp;
 	int k, r, c;
@@ -169,14 +195,166 @@ LINMATH_H_FUNC void mat4x4_mul(mat4x4 M, mat4x4 a, mat4x4 b)
 	}
 	mat4x4_dup(M, temp);
 }
-LINMATH_H_FUNC void mat4x4_mul_vec4(vec4 r, mat4x4 M, vec4 v)
+LINMATH_H_FUNC void mat4x4_mul_vec4_scalar(vec4 r, mat4x4 M, vec4 v)
 {
+	vec4 temp;
 	int i, j;
 	for (j = 0; j < 4; ++j) {
-		r[j] = 0.f;
+		temp[j] = 0.f;
 		for (i = 0; i < 4; ++i)
-			r[j] += M[i][j] * v[i];
+			temp[j] += M[i][j] * v[i];
 	}
+	std::memcpy(r, temp, sizeof(temp));
+}
+
+#if defined(LINMATH_AVX2)
+/* the same four floats in both 128-bit halves; mat4x4 has no alignment guarantee */
+LINMATH_H_FUNC __m256 linmath_avx_dup(float const* p)
+{
+	__m128 v = _mm_loadu_ps(p);
+	return _mm256_insertf128_ps(_mm256_castps128_ps256(v), v, 1);
+}
+#endif
+#if defined(LINMATH_SSE)
+/* Each result column is a linear combination of a's columns weighted by one column of b.
+ * All inputs are loaded before anything is stored, so M may alias a or b. */
+LINMATH_H_FUNC __m128 linmath_sse_combine(__m128 const a[4], __m128 w)
+{
+	__m128 r = _mm_mul_ps(a[0], _mm_shuffle_ps(w, w, 0x00));
+	r = _mm_add_ps(r, _mm_mul_ps(a[1], _mm_shuffle_ps(w, w, 0x55)));
+	r = _mm_add_ps(r, _mm_mul_ps(a[2], _mm_shuffle_ps(w, w, 0xAA)));
+	return _mm_add_ps(r, _mm_mul_ps(a[3], _mm_shuffle_ps(w, w, 0xFF)));
+}
+LINMATH_H_FUNC void mat4x4_mul_simd(mat4x4 M, mat4x4 a, mat4x4 b)
+{
+#if defined(LINMATH_AVX2)
+	/* two result columns per 256-bit register */
+	__m256 a0 = linmath_avx_dup(a[0]);
+	__m256 a1 = linmath_avx_dup(a[1]);
+	__m256 a2 = linmath_avx_dup(a[2]);
+	__m256 a3 = linmath_avx_dup(a[3]);
+	__m256 b01 = _mm256_loadu_ps(b[0]);
+	__m256 b23 = _mm256_loadu_ps(b[2]);
+
+	__m256 r01 = _mm256_mul_ps(a0, _mm256_shuffle_ps(b01, b01, 0x00));
+	r01 = _mm256_fmadd_ps(a1, _mm256_shuffle_ps(b01, b01, 0x55), r01);
+	r01 = _mm256_fmadd_ps(a2, _mm256_shuffle_ps(b01, b01, 0xAA), r01);
+	r01 = _mm256_fmadd_ps(a3, _mm256_shuffle_ps(b01, b01, 0xFF), r01);
+
+	__m256 r23 = _mm256_mul_ps(a0, _mm256_shuffle_ps(b23, b23, 0x00));
+	r23 = _mm256_fmadd_ps(a1, _mm256_shuffle_ps(b23, b23, 0x55), r23);
+	r23 = _mm256_fmadd_ps(a2, _mm256_shuffle_ps(b23, b23, 0xAA), r23);
+	r23 = _mm256_fmadd_ps(a3, _mm256_shuffle_ps(b23, b23, 0xFF), r23);
+
+	_mm256_storeu_ps(M[0], r01);
+	_mm256_storeu_ps(M[2], r23);
+#else
+	__m128 const ac[4] = { _mm_loadu_ps(a[0]), _mm_loadu_ps(a[1]), _mm_loadu_ps(a[2]), _mm_loadu_ps(a[3]) };
+	__m128 b0 = _mm_loadu_ps(b[0]);
+	__m128 b1 = _mm_loadu_ps(b[1]);
+	__m128 b2 = _mm_loadu_ps(b[2]);
+	__m128 b3 = _mm_loadu_ps(b[3]);
+	_mm_storeu_ps(M[0], linmath_sse_combine(ac, b0));
+	_mm_storeu_ps(M[1], linmath_sse_combine(ac, b1));
+	_mm_storeu_ps(M[2], linmath_sse_combine(ac, b2));
+	_mm_storeu_ps(M[3], linmath_sse_combine(ac, b3));
+#endif
+}
+LINMATH_H_FUNC void mat4x4_mul_vec4_simd(vec4 r, mat4x4 M, vec4 v)
+{
+	__m128 const mc[4] = { _mm_loadu_ps(M[0]), _mm_loadu_ps(M[1]), _mm_loadu_ps(M[2]), _mm_loadu_ps(M[3]) };
+	_mm_storeu_ps(r, linmath_sse_combine(mc, _mm_loadu_ps(v)));
+}
+#elif defined(LINMATH_NEON)
+LINMATH_H_FUNC float32x4_t linmath_neon_combine(float32x4_t const a[4], float32x4_t w)
+{
+	float32x4_t r = vmulq_laneq_f32(a[0], w, 0);
+	r = vfmaq_laneq_f32(r, a[1], w, 1);
+	r = vfmaq_laneq_f32(r, a[2], w, 2);
+	return vfmaq_laneq_f32(r, a[3], w, 3);
+}
+LINMATH_H_FUNC void mat4x4_mul_simd(mat4x4 M, mat4x4 a, mat4x4 b)
+{
+	float32x4_t const ac[4] = { vld1q_f32(a[0]), vld1q_f32(a[1]), vld1q_f32(a[2]), vld1q_f32(a[3]) };
+	float32x4_t b0 = vld1q_f32(b[0]);
+	float32x4_t b1 = vld1q_f32(b[1]);
+	float32x4_t b2 = vld1q_f32(b[2]);
+	float32x4_t b3 = vld1q_f32(b[3]);
+	vst1q_f32(M[0], linmath_neon_combine(ac, b0));
+	vst1q_f32(M[1], linmath_neon_combine(ac, b1));
+	vst1q_f32(M[2], linmath_neon_combine(ac, b2));
+	vst1q_f32(M[3], linmath_neon_combine(ac, b3));
+}
+LINMATH_H_FUNC void mat4x4_mul_vec4_simd(vec4 r, mat4x4 M, vec4 v)
+{
+	float32x4_t const mc[4] = { vld1q_f32(M[0]), vld1q_f32(M[1]), vld1q_f32(M[2]), vld1q_f32(M[3]) };
+	vst1q_f32(r, linmath_neon_combine(mc, vld1q_f32(v)));
+}
+#endif
+
+LINMATH_H_FUNC void mat4x4_mul(mat4x4 M, mat4x4 a, mat4x4 b)
+{
+#if defined(LINMATH_SSE) || defined(LINMATH_NEON)
+	mat4x4_mul_simd(M, a, b);
+#else
+	mat4x4_mul_scalar(M, a, b);
+#endif
+}
+LINMATH_H_FUNC void mat4x4_mul_vec4(vec4 r, mat4x4 M, vec4 v)
+{
+#if defined(LINMATH_SSE) || defined(LINMATH_NEON)
+	mat4x4_mul_vec4_simd(r, M, v);
+#else
+	mat4x4_mul_vec4_scalar(r, M, v);
+#endif
+}
+
+/* Batch variants: R[i] = a * B[i] (e.g. view-projection times every model matrix)
+ * and r[i] = M * v[i]. The shared operand is loaded once for the whole batch. */
+LINMATH_H_FUNC void mat4x4_mul_batch(mat4x4* R, mat4x4 a, mat4x4* B, int count)
+{
+	int i = 0;
+#if defined(LINMATH_SSE)
+	__m128 const ac[4] = { _mm_loadu_ps(a[0]), _mm_loadu_ps(a[1]), _mm_loadu_ps(a[2]), _mm_loadu_ps(a[3]) };
+	for (; i < count; ++i) {
+		__m128 b0 = _mm_loadu_ps(B[i][0]);
+		__m128 b1 = _mm_loadu_ps(B[i][1]);
+		__m128 b2 = _mm_loadu_ps(B[i][2]);
+		__m128 b3 = _mm_loadu_ps(B[i][3]);
+		_mm_storeu_ps(R[i][0], linmath_sse_combine(ac, b0));
+		_mm_storeu_ps(R[i][1], linmath_sse_combine(ac, b1));
+		_mm_storeu_ps(R[i][2], linmath_sse_combine(ac, b2));
+		_mm_storeu_ps(R[i][3], linmath_sse_combine(ac, b3));
+	}
+#endif
+	for (; i < count; ++i)
+		mat4x4_mul(R[i], a, B[i]);
+}
+LINMATH_H_FUNC void mat4x4_mul_vec4_batch(vec4* r, mat4x4 M, vec4* v, int count)
+{
+	int i = 0;
+#if defined(LINMATH_AVX2)
+	/* two vectors per 256-bit register */
+	__m256 m0 = linmath_avx_dup(M[0]);
+	__m256 m1 = linmath_avx_dup(M[1]);
+	__m256 m2 = linmath_avx_dup(M[2]);
+	__m256 m3 = linmath_avx_dup(M[3]);
+	for (; i + 2 <= count; i += 2) {
+		__m256 w = _mm256_loadu_ps(v[i]);
+		__m256 t = _mm256_mul_ps(m0, _mm256_shuffle_ps(w, w, 0x00));
+		t = _mm256_fmadd_ps(m1, _mm256_shuffle_ps(w, w, 0x55), t);
+		t = _mm256_fmadd_ps(m2, _mm256_shuffle_ps(w, w, 0xAA), t);
+		t = _mm256_fmadd_ps(m3, _mm256_shuffle_ps(w, w, 0xFF), t);
+		_mm256_storeu_ps(r[i], t);
+	}
+#endif
+#if defined(LINMATH_SSE)
+	__m128 const mc[4] = { _mm_loadu_ps(M[0]), _mm_loadu_ps(M[1]), _mm_loadu_ps(M[2]), _mm_loadu_ps(M[3]) };
+	for (; i < count; ++i)
+		_mm_storeu_ps(r[i], linmath_sse_combine(mc, _mm_loadu_ps(v[i])));
+#endif
+	for (; i < count; ++i)
+		mat4x4_mul_vec4(r[i], M, v[i]);
 }
 LINMATH_H_FUNC void mat4x4_translate(mat4x4 T, float x, float y, float z)
 {
@@ -272,7 +450,7 @@ LINMATH_H_FUNC void mat4x4_rotate_Z(mat4x4 Q, mat4x4 M, float angle)
 	};
 	mat4x4_mul(Q, M, R);
 }
-LINMATH_H_FUNC void mat4x4_invert(mat4x4 T, mat4x4 M)
+LINMATH_H_FUNC void mat4x4_invert_scalar(mat4x4 T, mat4x4 M)
 {
 	float s[6];
 	float c[6];
@@ -313,6 +491,89 @@ LINMATH_H_FUNC void mat4x4_invert(mat4x4 T, mat4x4 M)
 	T[3][2] = (-M[3][0] * s[3] + M[3][1] * s[1] - M[3][2] * s[0]) * idet;
 	T[3][3] = (M[2][0] * s[3] - M[2][1] * s[1] + M[2][2] * s[0]) * idet;
 }
+#if defined(LINMATH_SSE)
+/* 2x2 blocks packed as (m00, m01, m10, m11) */
+#define LINMATH_SHUFFLE(a, b, x, y, z, w) _mm_shuffle_ps(a, b, (x) | ((y) << 2) | ((z) << 4) | ((w) << 6))
+#define LINMATH_SWIZZLE(v, x, y, z, w) LINMATH_SHUFFLE(v, v, x, y, z, w)
+/* A * B */
+LINMATH_H_FUNC __m128 linmath_mat2_mul(__m128 a, __m128 b)
+{
+	return _mm_add_ps(_mm_mul_ps(a, LINMATH_SWIZZLE(b, 0, 3, 0, 3)), _mm_mul_ps(LINMATH_SWIZZLE(a, 1, 0, 3, 2), LINMATH_SWIZZLE(b, 2, 1, 2, 1)));
+}
+/* adj(A) * B */
+LINMATH_H_FUNC __m128 linmath_mat2_adj_mul(__m128 a, __m128 b)
+{
+	return _mm_sub_ps(_mm_mul_ps(LINMATH_SWIZZLE(a, 3, 3, 0, 0), b), _mm_mul_ps(LINMATH_SWIZZLE(a, 1, 1, 2, 2), LINMATH_SWIZZLE(b, 2, 3, 0, 1)));
+}
+/* A * adj(B) */
+LINMATH_H_FUNC __m128 linmath_mat2_mul_adj(__m128 a, __m128 b)
+{
+	return _mm_sub_ps(_mm_mul_ps(a, LINMATH_SWIZZLE(b, 3, 0, 3, 0)), _mm_mul_ps(LINMATH_SWIZZLE(a, 1, 0, 3, 2), LINMATH_SWIZZLE(b, 2, 1, 2, 1)));
+}
+/* Block-wise inverse over the four 2x2 sub-matrices. It works on rows, but the inverse of the
+ * transpose is the transpose of the inverse, so feeding it columns and storing columns is the same. */
+LINMATH_H_FUNC void mat4x4_invert_simd(mat4x4 T, mat4x4 M)
+{
+	__m128 m0 = _mm_loadu_ps(M[0]);
+	__m128 m1 = _mm_loadu_ps(M[1]);
+	__m128 m2 = _mm_loadu_ps(M[2]);
+	__m128 m3 = _mm_loadu_ps(M[3]);
+
+	__m128 A = _mm_movelh_ps(m0, m1);
+	__m128 B = _mm_movehl_ps(m1, m0);
+	__m128 C = _mm_movelh_ps(m2, m3);
+	__m128 D = _mm_movehl_ps(m3, m2);
+
+	/* determinants of the four blocks */
+	__m128 detSub = _mm_sub_ps(
+		_mm_mul_ps(LINMATH_SHUFFLE(m0, m2, 0, 2, 0, 2), LINMATH_SHUFFLE(m1, m3, 1, 3, 1, 3)),
+		_mm_mul_ps(LINMATH_SHUFFLE(m0, m2, 1, 3, 1, 3), LINMATH_SHUFFLE(m1, m3, 0, 2, 0, 2)));
+	__m128 detA = LINMATH_SWIZZLE(detSub, 0, 0, 0, 0);
+	__m128 detB = LINMATH_SWIZZLE(detSub, 1, 1, 1, 1);
+	__m128 detC = LINMATH_SWIZZLE(detSub, 2, 2, 2, 2);
+	__m128 detD = LINMATH_SWIZZLE(detSub, 3, 3, 3, 3);
+
+	__m128 D_C = linmath_mat2_adj_mul(D, C);
+	__m128 A_B = linmath_mat2_adj_mul(A, B);
+	__m128 X = _mm_sub_ps(_mm_mul_ps(detD, A), linmath_mat2_mul(B, D_C));
+	__m128 W = _mm_sub_ps(_mm_mul_ps(detA, D), linmath_mat2_mul(C, A_B));
+	__m128 Y = _mm_sub_ps(_mm_mul_ps(detB, C), linmath_mat2_mul_adj(D, A_B));
+	__m128 Z = _mm_sub_ps(_mm_mul_ps(detC, B), linmath_mat2_mul_adj(A, D_C));
+
+	__m128 detM = _mm_add_ps(_mm_mul_ps(detA, detD), _mm_mul_ps(detB, detC));
+	__m128 tr = _mm_mul_ps(A_B, LINMATH_SWIZZLE(D_C, 0, 2, 1, 3));
+	tr = _mm_add_ps(tr, LINMATH_SWIZZLE(tr, 2, 3, 0, 1));
+	tr = _mm_add_ps(tr, LINMATH_SWIZZLE(tr, 1, 0, 3, 2));
+	detM = _mm_sub_ps(detM, tr);
+
+	/* Assumes it is invertible */
+	__m128 rDetM = _mm_div_ps(_mm_setr_ps(1.f, -1.f, -1.f, 1.f), detM);
+	X = _mm_mul_ps(X, rDetM);
+	Y = _mm_mul_ps(Y, rDetM);
+	Z = _mm_mul_ps(Z, rDetM);
+	W = _mm_mul_ps(W, rDetM);
+
+	_mm_storeu_ps(T[0], LINMATH_SHUFFLE(X, Y, 3, 1, 3, 1));
+	_mm_storeu_ps(T[1], LINMATH_SHUFFLE(X, Y, 2, 0, 2, 0));
+	_mm_storeu_ps(T[2], LINMATH_SHUFFLE(Z, W, 3, 1, 3, 1));
+	_mm_storeu_ps(T[3], LINMATH_SHUFFLE(Z, W, 2, 0, 2, 0));
+}
+#endif
+LINMATH_H_FUNC void mat4x4_invert(mat4x4 T, mat4x4 M)
+{
+#if defined(LINMATH_SSE)
+	mat4x4_invert_simd(T, M);
+#else
+	/* NEON keeps the scalar cofactor expansion, which the compiler vectorizes reasonably */
+	mat4x4_invert_scalar(T, M);
+#endif
+}
+LINMATH_H_FUNC void mat4x4_invert_batch(mat4x4* T, mat4x4* M, int count)
+{
+	int i;
+	for (i = 0; i < count; ++i)
+		mat4x4_invert(T[i], M[i]);
+}
 LINMATH_H_FUNC void mat4x4_orthonormalize(mat4x4 R, mat4x4 M)
 {
 	mat4x4_dup(R, M);
@@ -394,7 +655,7 @@ LINMATH_H_FUNC void mat4x4_perspective(mat4x4 m, float y_fov, float aspect, floa
 	m[3][2] = -((2.f * f * n) / (f - n));
 	m[3][3] = 0.f;
 }
-LINMATH_H_FUNC void mat4x4_look_at(mat4x4 m, vec3 eye, vec3 center, vec3 up)
+LINMATH_H_FUNC void mat4x4_look_at_scalar(mat4x4 m, vec3 eye, vec3 center, vec3 up)
 {
 	/* Adapted from Android's OpenGL Matrix.java.                        */
 	/* See the OpenGL GLUT documentation for gluLookAt for a description */
@@ -436,6 +697,59 @@ LINMATH_H_FUNC void mat4x4_look_at(mat4x4 m, vec3 eye, vec3 center, vec3 up)
 	mat4x4_translate_in_place(m, -eye[0], -eye[1], -eye[2]);
 }
 
+#if defined(LINMATH_SSE)
+LINMATH_H_FUNC __m128 linmath_sse_cross(__m128 a, __m128 b)
+{
+	__m128 a_yzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+	__m128 b_yzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+	__m128 c = _mm_sub_ps(_mm_mul_ps(a, b_yzx), _mm_mul_ps(a_yzx, b));
+	return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+}
+LINMATH_H_FUNC __m128 linmath_sse_norm3(__m128 v)
+{
+	__m128 sq = _mm_mul_ps(v, v);
+	__m128 len2 = _mm_add_ss(_mm_add_ss(sq, _mm_shuffle_ps(sq, sq, 0x55)), _mm_shuffle_ps(sq, sq, 0xAA));
+	return _mm_div_ps(v, _mm_sqrt_ps(_mm_shuffle_ps(len2, len2, 0x00)));
+}
+/* vec3 has no room for a fourth lane, so it is loaded with w = 0 */
+LINMATH_H_FUNC __m128 linmath_sse_load3(vec3 const v)
+{
+	return _mm_setr_ps(v[0], v[1], v[2], 0.f);
+}
+LINMATH_H_FUNC void mat4x4_look_at_simd(mat4x4 m, vec3 eye, vec3 center, vec3 up)
+{
+	__m128 e = linmath_sse_load3(eye);
+	__m128 f = linmath_sse_norm3(_mm_sub_ps(linmath_sse_load3(center), e));
+	__m128 s = linmath_sse_norm3(linmath_sse_cross(f, linmath_sse_load3(up)));
+	__m128 t = linmath_sse_cross(s, f);
+	__m128 nf = _mm_sub_ps(_mm_setzero_ps(), f);
+	__m128 w = _mm_setzero_ps();
+
+	/* rows s, t, -f become the columns of the rotation */
+	_MM_TRANSPOSE4_PS(s, t, nf, w);
+
+	/* translation: -(R * eye), w = 1 */
+	__m128 ne = _mm_sub_ps(_mm_setzero_ps(), e);
+	__m128 c3 = _mm_mul_ps(s, _mm_shuffle_ps(ne, ne, 0x00));
+	c3 = _mm_add_ps(c3, _mm_mul_ps(t, _mm_shuffle_ps(ne, ne, 0x55)));
+	c3 = _mm_add_ps(c3, _mm_mul_ps(nf, _mm_shuffle_ps(ne, ne, 0xAA)));
+	c3 = _mm_add_ps(c3, _mm_setr_ps(0.f, 0.f, 0.f, 1.f));
+
+	_mm_storeu_ps(m[0], s);
+	_mm_storeu_ps(m[1], t);
+	_mm_storeu_ps(m[2], nf);
+	_mm_storeu_ps(m[3], c3);
+}
+#endif
+LINMATH_H_FUNC void mat4x4_look_at(mat4x4 m, vec3 eye, vec3 center, vec3 up)
+{
+#if defined(LINMATH_SSE)
+	mat4x4_look_at_simd(m, eye, center, up);
+#else
+	mat4x4_look_at_scalar(m, eye, center, up);
+#endif
+}
+
 typedef float quat[4];
 LINMATH_H_FUNC void quat_identity(quat q)
 {
@@ -454,15 +768,65 @@ LINMATH_H_FUNC void quat_sub(quat r, quat a, quat b)
 	for (i = 0; i < 4; ++i)
 		r[i] = a[i] - b[i];
 }
-LINMATH_H_FUNC void quat_mul(quat r, quat p, quat q)
+LINMATH_H_FUNC void quat_mul_scalar(quat r, quat p, quat q)
 {
+	quat temp;
 	vec3 w;
-	vec3_mul_cross(r, p, q);
+	vec3_mul_cross(temp, p, q);
 	vec3_scale(w, p, q[3]);
-	vec3_add(r, r, w);
+	vec3_add(temp, temp, w);
 	vec3_scale(w, q, p[3]);
-	vec3_add(r, r, w);
-	r[3] = p[3] * q[3] - vec3_mul_inner(p, q);
+	vec3_add(temp, temp, w);
+	temp[3] = p[3] * q[3] - vec3_mul_inner(p, q);
+	std::memcpy(r, temp, sizeof(temp));
+}
+#if defined(LINMATH_SSE)
+/* r.xyz = p.w q.xyz + q.w p.xyz + p.xyz x q.xyz,  r.w = p.w q.w - p.xyz . q.xyz
+ * as four products of swizzled operands; the sign mask flips the w lane of two of them */
+LINMATH_H_FUNC void quat_mul_simd(quat r, quat p, quat q)
+{
+	__m128 a = _mm_loadu_ps(p);
+	__m128 b = _mm_loadu_ps(q);
+	__m128 const flipW = _mm_setr_ps(0.f, 0.f, 0.f, -0.f);
+
+	__m128 t0 = _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 3, 3)), b);
+	__m128 t1 = _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 2, 1, 0)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 3, 3, 3)));
+	__m128 t2 = _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 0, 2, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 1, 0, 2)));
+	__m128 t3 = _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 1, 0, 2)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(2, 0, 2, 1)));
+
+	__m128 result = _mm_add_ps(t0, _mm_xor_ps(_mm_add_ps(t1, t2), flipW));
+	_mm_storeu_ps(r, _mm_sub_ps(result, t3));
+}
+#elif defined(LINMATH_NEON)
+LINMATH_H_FUNC void quat_mul_simd(quat r, quat p, quat q)
+{
+	float const p1[4] = { p[0], p[1], p[2], -p[0] };
+	float const q1[4] = { q[3], q[3], q[3], q[0] };
+	float const p2[4] = { p[1], p[2], p[0], -p[1] };
+	float const q2[4] = { q[2], q[0], q[1], q[1] };
+	float const p3[4] = { p[2], p[0], p[1], p[2] };
+	float const q3[4] = { q[1], q[2], q[0], q[2] };
+
+	float32x4_t result = vmulq_n_f32(vld1q_f32(q), p[3]);
+	result = vfmaq_f32(result, vld1q_f32(p1), vld1q_f32(q1));
+	result = vfmaq_f32(result, vld1q_f32(p2), vld1q_f32(q2));
+	result = vfmsq_f32(result, vld1q_f32(p3), vld1q_f32(q3));
+	vst1q_f32(r, result);
+}
+#endif
+LINMATH_H_FUNC void quat_mul(quat r, quat p, quat q)
+{
+#if defined(LINMATH_SSE) || defined(LINMATH_NEON)
+	quat_mul_simd(r, p, q);
+#else
+	quat_mul_scalar(r, p, q);
+#endif
+}
+LINMATH_H_FUNC void quat_mul_batch(quat* r, quat* p, quat* q, int count)
+{
+	int i;
+	for (i = 0; i < count; ++i)
+		quat_mul(r[i], p[i], q[i]);
 }
 LINMATH_H_FUNC void quat_scale(quat r, quat v, float s)
 {
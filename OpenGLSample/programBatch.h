@@ -0,0 +1,240 @@
+#ifndef PROGRAM_BATCH_H
+#define PROGRAM_BATCH_H
+
+// The OpenGL loader (GLEW or glad) and GLFW have to be included before this header
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "programCache.h"
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// Submits every shader and program to the driver up front and defers all status queries,
+// so a driver with compiler threads can build them concurrently. With
+// GL_KHR_parallel_shader_compile the batch is polled without blocking and the caller can
+// render with whichever programs are already linked; without it the first Poll() blocks.
+class ProgramBatch
+{
+public:
+	ProgramBatch(ProgramCache* cache = nullptr) : cache(cache)
+	{
+	}
+
+	// asks the driver for as many compiler threads as it likes. Needs a current context
+	// and should be called once before the first Submit
+	void EnableParallelCompile()
+	{
+		typedef void (APIENTRY* MaxThreadsProc)(GLuint count);
+		MaxThreadsProc maxThreads = nullptr;
+		if (glfwExtensionSupported("GL_KHR_parallel_shader_compile"))
+			maxThreads = (MaxThreadsProc)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+		else if (glfwExtensionSupported("GL_ARB_parallel_shader_compile"))
+			maxThreads = (MaxThreadsProc)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+
+		if (maxThreads != nullptr)
+		{
+			maxThreads(0xFFFFFFFF); // let the implementation choose
+			parallel = true;
+		}
+	}
+
+	bool IsParallel() const
+	{
+		return parallel;
+	}
+
+	// queues a vertex/fragment program. programId is valid immediately, but must not be
+	// used for drawing until IsReady(programId) returns true
+	void Submit(const char* name, const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId, const std::string& defines = "")
+	{
+		Entry entry;
+		entry.name = name;
+
+		if (cache != nullptr)
+		{
+			const char* sources[] = { vtxShaderSource, fragShaderSource };
+			entry.cacheKey = cache->MakeKey(sources, 2, defines);
+			programId = cache->Load(entry.cacheKey);
+			if (programId != 0)
+			{
+				entry.programId = programId;
+				entry.state = READY;
+				entries.push_back(entry);
+				return;
+			}
+		}
+
+		programId = glCreateProgram();
+		entry.programId = programId;
+		entry.vertexShaderId = glCreateShader(GL_VERTEX_SHADER);
+		entry.fragmentShaderId = glCreateShader(GL_FRAGMENT_SHADER);
+
+		glShaderSource(entry.vertexShaderId, 1, &vtxShaderSource, NULL);
+		glShaderSource(entry.fragmentShaderId, 1, &fragShaderSource, NULL);
+		glCompileShader(entry.vertexShaderId);
+		glCompileShader(entry.fragmentShaderId);
+
+		// link straight away; a failed compile surfaces as a failed link when we finally ask
+		glAttachShader(programId, entry.vertexShaderId);
+		glAttachShader(programId, entry.fragmentShaderId);
+		if (cache != nullptr)
+			cache->PrepareForLink(programId);
+		glLinkProgram(programId);
+
+		entries.push_back(entry);
+		++pending;
+	}
+
+	// queues a compute program, like Submit()
+	void SubmitCompute(const char* name, const char* computeShaderSource, GLuint& programId, const std::string& defines = "")
+	{
+		Entry entry;
+		entry.name = name;
+
+		if (cache != nullptr)
+		{
+			const char* sources[] = { computeShaderSource };
+			entry.cacheKey = cache->MakeKey(sources, 1, defines);
+			programId = cache->Load(entry.cacheKey);
+			if (programId != 0)
+			{
+				entry.programId = programId;
+				entry.state = READY;
+				entries.push_back(entry);
+				return;
+			}
+		}
+
+		programId = glCreateProgram();
+		entry.programId = programId;
+		entry.computeShaderId = glCreateShader(GL_COMPUTE_SHADER);
+		glShaderSource(entry.computeShaderId, 1, &computeShaderSource, NULL);
+		glCompileShader(entry.computeShaderId);
+
+		glAttachShader(programId, entry.computeShaderId);
+		if (cache != nullptr)
+			cache->PrepareForLink(programId);
+		glLinkProgram(programId);
+
+		entries.push_back(entry);
+		++pending;
+	}
+
+	// finalizes every program the driver has finished with. Never blocks when the parallel
+	// compile extension is available. Returns the number of programs still compiling
+	int Poll()
+	{
+		for (Entry& entry : entries)
+		{
+			if (entry.state != PENDING)
+				continue;
+
+			if (parallel)
+			{
+				GLint completed = GL_FALSE;
+				glGetProgramiv(entry.programId, GL_COMPLETION_STATUS_KHR, &completed);
+				if (!completed)
+					continue;
+			}
+			finalize(entry);
+		}
+		return pending;
+	}
+
+	// blocks until every submitted program is linked. Returns false if any of them failed
+	bool Finish()
+	{
+		for (Entry& entry : entries)
+		{
+			if (entry.state == PENDING)
+				finalize(entry);
+		}
+		return !failed;
+	}
+
+	bool IsReady(GLuint programId) const
+	{
+		for (const Entry& entry : entries)
+		{
+			if (entry.programId == programId)
+				return entry.state == READY;
+		}
+		return false;
+	}
+
+	bool Failed() const
+	{
+		return failed;
+	}
+
+private:
+	enum State { PENDING, READY, FAILED };
+
+	struct Entry
+	{
+		std::string name;
+		GLuint programId = 0;
+		GLuint vertexShaderId = 0;
+		GLuint fragmentShaderId = 0;
+		GLuint computeShaderId = 0;
+		uint64_t cacheKey = 0;
+		State state = PENDING;
+	};
+
+	ProgramCache* cache;
+	std::vector<Entry> entries;
+	int pending = 0;
+	bool parallel = false;
+	bool failed = false;
+
+	void finalize(Entry& entry)
+	{
+		--pending;
+
+		GLint success = 0;
+		glGetProgramiv(entry.programId, GL_LINK_STATUS, &success);
+		if (success)
+		{
+			entry.state = READY;
+			if (cache != nullptr)
+				cache->Store(entry.cacheKey, entry.programId);
+		}
+		else
+		{
+			entry.state = FAILED;
+			failed = true;
+			reportShaderErrors(entry.vertexShaderId, entry.name, "VERTEX");
+			reportShaderErrors(entry.fragmentShaderId, entry.name, "FRAGMENT");
+			reportShaderErrors(entry.computeShaderId, entry.name, "COMPUTE");
+
+			char infoLog[512];
+			glGetProgramInfoLog(entry.programId, sizeof(infoLog), NULL, infoLog);
+			std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED (" << entry.name << ")\n" << infoLog << std::endl;
+		}
+
+		// the linked program owns the compiled code now
+		glDeleteShader(entry.vertexShaderId);
+		glDeleteShader(entry.fragmentShaderId);
+		glDeleteShader(entry.computeShaderId);
+	}
+
+	// shaderId 0 is a stage the program does not have
+	static void reportShaderErrors(GLuint shaderId, const std::string& name, const char* stage)
+	{
+		if (shaderId == 0)
+			return;
+		GLint success = 0;
+		glGetShaderiv(shaderId, GL_COMPILE_STATUS, &success);
+		if (!success)
+		{
+			char infoLog[512];
+			glGetShaderInfoLog(shaderId, sizeof(infoLog), NULL, infoLog);
+			std::cout << "ERROR::SHADER::" << stage << "::COMPILATION_FAILED (" << name << ")\n" << infoLog << std::endl;
+		}
+	}
+};
+#endif
@@ -0,0 +1,179 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+// The OpenGL loader (GLEW or glad) has to be included before this header
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+
+// Stores linked program binaries on disk so warm starts can skip GLSL compilation.
+// Binaries are keyed by a hash of the shader sources, the injected defines and the
+// driver identification strings, so a driver update or an edited shader simply misses.
+class ProgramCache
+{
+public:
+	// counters for the startup report
+	unsigned int Hits = 0;
+	unsigned int Misses = 0;
+
+	ProgramCache(const std::string& directory = "shadercache") : directory(directory)
+	{
+	}
+
+	// true once a context is current and the driver exposes at least one binary format
+	bool IsSupported()
+	{
+		if (supported < 0)
+		{
+			GLint formats = 0;
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+			supported = formats > 0 ? 1 : 0;
+		}
+		return supported == 1;
+	}
+
+	// builds the cache key for a set of stage sources (null entries are skipped).
+	// Needs a current context since the driver vendor, renderer and version are part of the key
+	uint64_t MakeKey(const char* const* sources, int count, const std::string& defines = "")
+	{
+		uint64_t hash = FNV_OFFSET;
+		for (int i = 0; i < count; ++i)
+		{
+			if (sources[i] != nullptr)
+				hash = hashString(hash, sources[i]);
+			hash = hashByte(hash, 0xFF); // stage separator
+		}
+		hash = hashString(hash, defines.c_str());
+		hash = hashString(hash, (const char*)glGetString(GL_VENDOR));
+		hash = hashString(hash, (const char*)glGetString(GL_RENDERER));
+		hash = hashString(hash, (const char*)glGetString(GL_VERSION));
+		return hash;
+	}
+
+	// marks a program so the driver keeps its binary retrievable; call before glLinkProgram
+	void PrepareForLink(GLuint programId)
+	{
+		if (IsSupported())
+			glProgramParameteri(programId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+
+	// creates a linked program from the stored binary. Returns 0 on a miss or when the
+	// driver rejects the binary, in which case the caller compiles from source
+	GLuint Load(uint64_t key)
+	{
+		if (!IsSupported())
+		{
+			++Misses;
+			return 0;
+		}
+
+		std::ifstream in(pathFor(key), std::ios::binary);
+		FileHeader header;
+		if (!in || !in.read((char*)&header, sizeof(header)) || header.magic != MAGIC || header.version != VERSION || header.key != key)
+		{
+			++Misses;
+			return 0;
+		}
+
+		std::vector<char> binary(header.length);
+		if (!in.read(binary.data(), binary.size()))
+		{
+			++Misses;
+			return 0;
+		}
+
+		GLuint programId = glCreateProgram();
+		glProgramBinary(programId, header.format, binary.data(), (GLsizei)binary.size());
+
+		GLint success = 0;
+		glGetProgramiv(programId, GL_LINK_STATUS, &success);
+		if (!success)
+		{
+			// stale binary (driver changed the format without changing its version string)
+			glDeleteProgram(programId);
+			in.close();
+			std::error_code ec;
+			std::filesystem::remove(pathFor(key), ec);
+			++Misses;
+			return 0;
+		}
+
+		++Hits;
+		return programId;
+	}
+
+	// reads the binary back from a successfully linked program and writes it to disk
+	void Store(uint64_t key, GLuint programId)
+	{
+		if (!IsSupported())
+			return;
+
+		GLint length = 0;
+		glGetProgramiv(programId, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0)
+			return;
+
+		std::vector<char> binary(length);
+		GLenum format = 0;
+		glGetProgramBinary(programId, length, &length, &format, binary.data());
+
+		std::error_code ec;
+		std::filesystem::create_directories(directory, ec);
+
+		FileHeader header = { MAGIC, VERSION, key, format, (uint32_t)length };
+		std::ofstream out(pathFor(key), std::ios::binary | std::ios::trunc);
+		if (!out)
+		{
+			std::cout << "WARNING::PROGRAM_CACHE::CANNOT_WRITE " << pathFor(key) << std::endl;
+			return;
+		}
+		out.write((const char*)&header, sizeof(header));
+		out.write(binary.data(), length);
+	}
+
+private:
+	static const uint32_t MAGIC = 0x42504C47; // "GLPB"
+	static const uint32_t VERSION = 1;
+	static const uint64_t FNV_OFFSET = 14695981039346656037ull;
+	static const uint64_t FNV_PRIME = 1099511628211ull;
+
+	struct FileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t key;
+		uint32_t format;
+		uint32_t length;
+	};
+
+	std::string directory;
+	int supported = -1;
+
+	std::string pathFor(uint64_t key) const
+	{
+		static const char digits[] = "0123456789abcdef";
+		std::string name(16, '0');
+		for (int i = 15; i >= 0; --i, key >>= 4)
+			name[i] = digits[key & 0xF];
+		return directory + "/" + name + ".bin";
+	}
+
+	static uint64_t hashByte(uint64_t hash, unsigned char byte)
+	{
+		return (hash ^ byte) * FNV_PRIME;
+	}
+
+	static uint64_t hashString(uint64_t hash, const char* text)
+	{
+		if (text == nullptr)
+			return hashByte(hash, 0);
+		for (; *text; ++text)
+			hash = hashByte(hash, (unsigned char)*text);
+		return hashByte(hash, 0);
+	}
+};
+#endif
@@ -0,0 +1,198 @@
+#ifndef RANGE_ALLOCATOR_H
+#define RANGE_ALLOCATOR_H
+
+#include <cstddef>
+#include <iterator>
+#include <map>
+#include <vector>
+
+// Hands out byte ranges of a fixed-size address space, such as a GPU buffer, without touching the
+// memory itself. Free ranges are kept in address order: an allocation takes the free range that
+// leaves the smallest remainder (best fit), and a freed range merges with its free neighbours, so
+// free space only splinters when live ranges sit between the gaps. Compact() then packs the live
+// ranges to the front and reports where each one went, for the owner to copy the contents.
+//
+// Not thread-safe: the owner serializes the calls.
+class RangeAllocator
+{
+public:
+	// a live range before and after Compact()
+	struct Move
+	{
+		size_t from;
+		size_t to;
+		size_t size;
+	};
+
+	void Initialize(size_t capacity)
+	{
+		this->capacity = capacity;
+		used.clear();
+		freeRanges.clear();
+		if (capacity > 0)
+			freeRanges[0] = capacity;
+		usedBytes = 0;
+	}
+
+	// takes size bytes starting on a multiple of alignment; false when no free range fits
+	bool Allocate(size_t size, size_t alignment, size_t& offset)
+	{
+		if (size == 0)
+			size = 1;
+		if (alignment == 0)
+			alignment = 1;
+
+		std::map<size_t, size_t>::iterator best = freeRanges.end();
+		size_t bestRemainder = 0;
+		for (std::map<size_t, size_t>::iterator it = freeRanges.begin(); it != freeRanges.end(); ++it)
+		{
+			size_t start = align(it->first, alignment);
+			size_t padding = start - it->first;
+			if (padding + size > it->second)
+				continue;
+			size_t remainder = it->second - padding - size;
+			if (best == freeRanges.end() || remainder < bestRemainder)
+			{
+				best = it;
+				bestRemainder = remainder;
+				if (remainder == 0)
+					break;
+			}
+		}
+		if (best == freeRanges.end())
+			return false;
+
+		size_t rangeStart = best->first;
+		offset = align(rangeStart, alignment);
+		freeRanges.erase(best);
+		// the alignment padding stays free, in front of the allocation
+		if (offset > rangeStart)
+			freeRanges[rangeStart] = offset - rangeStart;
+		if (bestRemainder > 0)
+			freeRanges[offset + size] = bestRemainder;
+
+		used[offset] = { size, alignment };
+		usedBytes += size;
+		return true;
+	}
+
+	// returns the range that starts at offset; unknown offsets are ignored
+	void Free(size_t offset)
+	{
+		std::map<size_t, Used>::iterator it = used.find(offset);
+		if (it == used.end())
+			return;
+		size_t size = it->second.size;
+		usedBytes -= size;
+		used.erase(it);
+
+		// merge with the free range behind and the one in front, if they touch
+		std::map<size_t, size_t>::iterator next = freeRanges.lower_bound(offset);
+		if (next != freeRanges.end() && offset + size == next->first)
+		{
+			size += next->second;
+			next = freeRanges.erase(next);
+		}
+		if (next != freeRanges.begin())
+		{
+			std::map<size_t, size_t>::iterator previous = std::prev(next);
+			if (previous->first + previous->second == offset)
+			{
+				previous->second += size;
+				return;
+			}
+		}
+		freeRanges[offset] = size;
+	}
+
+	// packs every live range to the front, in address order and keeping its alignment, and lists them
+	// all in moves, moved or not, so the owner can copy the contents into a fresh buffer
+	void Compact(std::vector<Move>& moves)
+	{
+		moves.clear();
+		std::map<size_t, Used> packed;
+		size_t head = 0;
+		for (const std::pair<const size_t, Used>& range : used)
+		{
+			size_t to = align(head, range.second.alignment);
+			moves.push_back({ range.first, to, range.second.size });
+			packed[to] = range.second;
+			head = to + range.second.size;
+		}
+		used.swap(packed);
+
+		// the alignment gaps between packed ranges stay free
+		freeRanges.clear();
+		size_t previousEnd = 0;
+		for (const std::pair<const size_t, Used>& range : used)
+		{
+			if (range.first > previousEnd)
+				freeRanges[previousEnd] = range.first - previousEnd;
+			previousEnd = range.first + range.second.size;
+		}
+		if (capacity > previousEnd)
+			freeRanges[previousEnd] = capacity - previousEnd;
+	}
+
+	size_t Capacity() const
+	{
+		return capacity;
+	}
+
+	size_t UsedBytes() const
+	{
+		return usedBytes;
+	}
+
+	size_t FreeBytes() const
+	{
+		return capacity - usedBytes;
+	}
+
+	size_t LargestFree() const
+	{
+		size_t largest = 0;
+		for (const std::pair<const size_t, size_t>& range : freeRanges)
+		{
+			if (range.second > largest)
+				largest = range.second;
+		}
+		return largest;
+	}
+
+	int FreeRangeCount() const
+	{
+		return (int)freeRanges.size();
+	}
+
+	int AllocationCount() const
+	{
+		return (int)used.size();
+	}
+
+	// share of the free bytes outside the largest free range: 0 when the free space is in one piece,
+	// close to 1 when it is splintered into many small ranges
+	double Fragmentation() const
+	{
+		size_t freeBytes = FreeBytes();
+		return freeBytes == 0 ? 0.0 : 1.0 - (double)LargestFree() / (double)freeBytes;
+	}
+
+private:
+	struct Used
+	{
+		size_t size;
+		size_t alignment;
+	};
+
+	size_t capacity = 0;
+	size_t usedBytes = 0;
+	std::map<size_t, Used> used;			// by offset
+	std::map<size_t, size_t> freeRanges;	// offset -> size, never two adjacent
+
+	static size_t align(size_t offset, size_t alignment)
+	{
+		return (offset + alignment - 1) / alignment * alignment;
+	}
+};
+#endif
@@ -0,0 +1,136 @@
+#ifndef RENDER_PASS_STATS_H
+#define RENDER_PASS_STATS_H
+
+// The OpenGL loader (GLEW or glad) and GLFW have to be included before this header
+
+#include <iostream>
+
+#include "framePacer.h"
+
+// GPU time of the depth pre-pass, of the shading pass and of the deferred lighting passes, and the
+// overdraw of the shading pass: the samples that passed its depth test per pixel of the viewport.
+// Every fragment that passes is shaded, so without a pre-pass the overdraw counts the hidden fragments
+// lit (or, deferred, written to the G-buffer) for nothing, and with one it should stay close to 1.
+// The queries of a frame are issued into the frame pacer's slot and read when that slot comes round
+// again, after FramePacer::BeginFrame() has waited for its fence, so reading them never stalls.
+//
+// Reports every REPORT_INTERVAL frames; switching the pre-pass or the lighting path starts a new interval.
+class RenderPassStats
+{
+public:
+	enum Query
+	{
+		PREPASS_TIME,
+		SHADING_TIME,
+		SHADED_SAMPLES,
+		LIGHTING_TIME,
+		QUERY_COUNT
+	};
+
+	// call after FramePacer::BeginFrame() with the pacer's slot: collects the results of the frame
+	// that used the slot last, then starts this frame's. lightingPathName names lightingPath in the reports
+	void BeginFrame(int frameSlot, int viewportPixels, bool depthPrepass, int lightingPath, const char* lightingPathName)
+	{
+		if (queries[0][0] == 0)
+			glGenQueries(FramePacer::MAX_FRAMES_IN_FLIGHT * QUERY_COUNT, &queries[0][0]);
+
+		slot = frameSlot;
+		if (issued[slot][SHADING_TIME])
+			collect();
+		for (int i = 0; i < QUERY_COUNT; ++i)
+			issued[slot][i] = false;
+		modes[slot] = (depthPrepass ? MODE_PREPASS : 0) | lightingPath << 1;
+		pixels[slot] = viewportPixels;
+
+		if (modes[slot] != reportedMode)
+		{
+			reportedMode = modes[slot];
+			reportedPath = lightingPathName;
+			resetStats();
+		}
+	}
+
+	// time and sample queries are of different targets, so the shading pass runs both at once
+	void Begin(Query query)
+	{
+		glBeginQuery(target(query), queries[slot][query]);
+		issued[slot][query] = true;
+	}
+
+	void End(Query query)
+	{
+		glEndQuery(target(query));
+	}
+
+	void Destroy()
+	{
+		if (queries[0][0] != 0)
+			glDeleteQueries(FramePacer::MAX_FRAMES_IN_FLIGHT * QUERY_COUNT, &queries[0][0]);
+		queries[0][0] = 0;
+	}
+
+private:
+	static const int REPORT_INTERVAL = 240; // measured frames per report
+	static const int MODE_PREPASS = 1;	// the lighting path is in the bits above
+
+	GLuint queries[FramePacer::MAX_FRAMES_IN_FLIGHT][QUERY_COUNT] = {};
+	bool issued[FramePacer::MAX_FRAMES_IN_FLIGHT][QUERY_COUNT] = {};
+	int modes[FramePacer::MAX_FRAMES_IN_FLIGHT] = {};
+	int pixels[FramePacer::MAX_FRAMES_IN_FLIGHT] = {};
+	int slot = 0;
+
+	int reportedMode = -1;	// none reported yet
+	const char* reportedPath = "";
+	int frames = 0;
+	double prepassTime = 0.0;	// seconds, summed over the interval
+	double shadingTime = 0.0;
+	double lightingTime = 0.0;
+	double overdraw = 0.0;
+
+	static GLenum target(Query query)
+	{
+		return query == SHADED_SAMPLES ? GL_SAMPLES_PASSED : GL_TIME_ELAPSED;
+	}
+
+	void resetStats()
+	{
+		frames = 0;
+		prepassTime = 0.0;
+		shadingTime = 0.0;
+		lightingTime = 0.0;
+		overdraw = 0.0;
+	}
+
+	// frames of the other mode, from before the switch, are dropped
+	void collect()
+	{
+		if (modes[slot] != reportedMode)
+			return;
+
+		GLuint64 result = 0;
+		if (issued[slot][PREPASS_TIME])
+		{
+			glGetQueryObjectui64v(queries[slot][PREPASS_TIME], GL_QUERY_RESULT, &result);
+			prepassTime += result * 1e-9;
+		}
+		if (issued[slot][LIGHTING_TIME])
+		{
+			glGetQueryObjectui64v(queries[slot][LIGHTING_TIME], GL_QUERY_RESULT, &result);
+			lightingTime += result * 1e-9;
+		}
+		glGetQueryObjectui64v(queries[slot][SHADING_TIME], GL_QUERY_RESULT, &result);
+		shadingTime += result * 1e-9;
+		glGetQueryObjectui64v(queries[slot][SHADED_SAMPLES], GL_QUERY_RESULT, &result);
+		overdraw += pixels[slot] > 0 ? (double)result / pixels[slot] : 0.0;
+
+		if (++frames == REPORT_INTERVAL)
+		{
+			std::cout << "INFO: Depth pre-pass " << ((reportedMode & MODE_PREPASS) != 0 ? "on" : "off")
+				<< ", " << reportedPath << ": "
+				<< prepassTime * 1000.0 / frames << " ms pre-pass + " << shadingTime * 1000.0 / frames << " ms shading + "
+				<< lightingTime * 1000.0 / frames << " ms lighting per frame, " << overdraw / frames << " shaded samples per pixel" << std::endl;
+			resetStats();
+		}
+	}
+};
+#endif
@@ -0,0 +1,203 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+// The OpenGL loader (GLEW or glad) has to be included before this header
+
+#include <iostream>
+
+// One persistently mapped buffer for everything the CPU writes anew each frame: uniform blocks,
+// storage blocks and streamed vertices. It is split into one region per frame in flight, and a
+// frame allocates from its region with a bump pointer, then binds the ranges it wrote
+// (glBindBufferRange, glBindVertexBuffer). The mapping is coherent, so writes need no flush.
+//
+// EndFrame() fences the region after the frame's last command; BeginFrame() waits for that fence
+// before the region is written again, three frames later, by which time it has normally signaled.
+// After Initialize() nothing is allocated, orphaned or updated through the driver, so a frame has
+// no hidden synchronization with the GPU.
+//
+// Reserve() hands out the start of a region ahead of its frame, so a thread without the GL context
+// can fill it while the frames before are drawn: the wait for the region moves to Reserve(), and the
+// frame's allocations follow the reserved bytes.
+class RingBuffer
+{
+public:
+	static const int MAX_REGIONS = 3;
+
+	struct Allocation
+	{
+		void* data;			// nullptr when the region is full
+		GLintptr offset;	// from the start of Buffer(), for the bind calls
+		GLsizeiptr size;
+	};
+
+	// creates and maps the buffer. Needs a current GL 4.4 context
+	void Initialize(GLsizeiptr regionSize, int regionCount = MAX_REGIONS)
+	{
+		GLint alignment = 256;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		uniformAlignment = alignment;
+		alignment = 256;
+		glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		storageAlignment = alignment;
+
+		// every region starts on an offset any binding accepts
+		GLsizeiptr regionAlignment = uniformAlignment > storageAlignment ? uniformAlignment : storageAlignment;
+		this->regionSize = align(regionSize, regionAlignment);
+		this->regionCount = regionCount < 1 ? 1 : (regionCount > MAX_REGIONS ? MAX_REGIONS : regionCount);
+		region = this->regionCount - 1;
+		head = 0;
+		peak = 0;
+		reservations = 0;
+
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glBufferStorage(GL_COPY_WRITE_BUFFER, this->regionSize * this->regionCount, NULL, flags);
+		mapped = (char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, this->regionSize * this->regionCount, flags);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+
+	void Destroy()
+	{
+		for (int i = 0; i < MAX_REGIONS; ++i)
+		{
+			if (fences[i] != 0)
+				glDeleteSync(fences[i]);
+			fences[i] = 0;
+		}
+		if (buffer != 0)
+		{
+			glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+			glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+			glDeleteBuffers(1, &buffer);
+		}
+		buffer = 0;
+		mapped = nullptr;
+		reservations = 0;
+	}
+
+	// moves to the next region, waiting until the GPU has finished the frame that used it last. A
+	// reserved region is free already; its frame allocates after the reserved bytes
+	void BeginFrame()
+	{
+		region = (region + 1) % regionCount;
+		head = 0;
+		if (reservations > 0)
+		{
+			--reservations;
+			head = reservedSizes[region];
+			reservedSizes[region] = 0;
+		}
+		waitForRegion(region);
+	}
+
+	// takes the first size bytes of the next region that no frame has begun or reserved yet, once the
+	// GPU has finished the frame that used it last. The data pointer may be written from any thread
+	// until the BeginFrame() that moves to the region. Needs all MAX_REGIONS regions: the GPU reads
+	// one, the current frame writes one, the reserved one is filled; at most two are reserved ahead
+	Allocation Reserve(GLsizeiptr size)
+	{
+		if (mapped == nullptr || regionCount < MAX_REGIONS || reservations >= regionCount - 1)
+			return { nullptr, 0, 0 };
+
+		int target = (region + reservations + 1) % regionCount;
+		++reservations;
+		waitForRegion(target);
+		if (size > regionSize)
+		{
+			if (!reportedFull)
+				std::cout << "ERROR::RING_BUFFER::FULL " << size << " of " << regionSize << " bytes" << std::endl;
+			reportedFull = true;
+			return { nullptr, 0, 0 };
+		}
+		reservedSizes[target] = size;
+		GLintptr offset = target * regionSize;
+		return { mapped + offset, offset, size };
+	}
+
+	// call after the last command of the frame that reads the region
+	void EndFrame()
+	{
+		fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		if (head > peak)
+			peak = head;
+	}
+
+	// takes size bytes from the current region, starting on a multiple of alignment
+	Allocation Allocate(GLsizeiptr size, GLsizeiptr alignment)
+	{
+		GLsizeiptr start = align(head, alignment);
+		if (mapped == nullptr || start + size > regionSize)
+		{
+			if (!reportedFull)
+				std::cout << "ERROR::RING_BUFFER::FULL " << start + size << " of " << regionSize << " bytes" << std::endl;
+			reportedFull = true;
+			return { nullptr, 0, 0 };
+		}
+		head = start + size;
+		GLintptr offset = region * regionSize + start;
+		return { mapped + offset, offset, size };
+	}
+
+	GLuint Buffer() const
+	{
+		return buffer;
+	}
+
+	GLsizeiptr UniformAlignment() const
+	{
+		return uniformAlignment;
+	}
+
+	GLsizeiptr StorageAlignment() const
+	{
+		return storageAlignment;
+	}
+
+	GLsizeiptr RegionSize() const
+	{
+		return regionSize;
+	}
+
+	// most bytes a frame has used so far
+	GLsizeiptr PeakUsage() const
+	{
+		return peak;
+	}
+
+private:
+	GLuint buffer = 0;
+	char* mapped = nullptr;
+	GLsizeiptr regionSize = 0;
+	int regionCount = MAX_REGIONS;
+	int region = 0;
+	GLsizeiptr head = 0;
+	GLsizeiptr peak = 0;
+	GLsizeiptr uniformAlignment = 256;
+	GLsizeiptr storageAlignment = 256;
+	GLsync fences[MAX_REGIONS] = {};
+	int reservations = 0;						// regions after the current one handed out by Reserve()
+	GLsizeiptr reservedSizes[MAX_REGIONS] = {};
+	bool reportedFull = false;
+
+	void waitForRegion(int index)
+	{
+		if (fences[index] == 0)
+			return;
+
+		GLenum result;
+		do
+		{
+			result = glClientWaitSync(fences[index], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000); // 1 s, in ns
+		} while (result == GL_TIMEOUT_EXPIRED);
+		glDeleteSync(fences[index]);
+		fences[index] = 0;
+	}
+
+	static GLsizeiptr align(GLsizeiptr offset, GLsizeiptr alignment)
+	{
+		return (offset + alignment - 1) / alignment * alignment;
+	}
+};
+#endif
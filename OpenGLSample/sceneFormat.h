@@ -0,0 +1,309 @@
+#ifndef SCENE_FORMAT_H
+#define SCENE_FORMAT_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+// Binary scene file, written by the SceneConverter tool from a JSON description and read by the
+// program straight out of a memory mapping.
+//
+// Layout: a Header, a table of contents with one ChunkEntry per chunk, then the chunks. Every chunk
+// starts on a BLOB_ALIGNMENT boundary and is an array of fixed-size little-endian records (or raw
+// bytes for STRINGS, VERTICES and INDICES), so the reader uses the mapped bytes in place: records
+// are read through typed pointers and vertex/index ranges go to glBufferData without a copy.
+//
+// Versioning: a different major version is rejected. Minor versions only add chunk types or use
+// reserved fields; chunks are found through the table of contents, so unknown ones are skipped.
+namespace SceneFormat
+{
+	const uint32_t MAGIC = 0x4E43534B;		// "KSCN"
+	const uint16_t VERSION_MAJOR = 1;
+	const uint16_t VERSION_MINOR = 0;
+	const uint64_t BLOB_ALIGNMENT = 64;
+
+	enum ChunkType : uint32_t
+	{
+		CHUNK_STRINGS = 1,		// NUL-terminated UTF-8 strings, referenced by byte offset
+		CHUNK_TEXTURES,			// TextureRecord[]
+		CHUNK_MATERIALS,		// MaterialRecord[]
+		CHUNK_MESHES,			// MeshRecord[]
+		CHUNK_NODES,			// NodeRecord[], depth-first: each subtree a contiguous range after its root
+		CHUNK_VERTICES,			// interleaved float vertices of every mesh
+		CHUNK_INDICES			// uint32_t indices of every mesh
+	};
+
+	struct Header
+	{
+		uint32_t magic;
+		uint16_t versionMajor;
+		uint16_t versionMinor;
+		uint32_t chunkCount;		// entries in the table of contents that follows the header
+		uint32_t reserved;
+		uint64_t fileSize;
+	};
+
+	struct ChunkEntry
+	{
+		uint32_t type;
+		uint32_t count;				// records in the chunk, bytes for the raw chunks
+		uint64_t offset;			// from the start of the file
+		uint64_t size;				// in bytes
+	};
+
+	struct TextureRecord
+	{
+		uint32_t path;				// string offset
+	};
+
+	enum MaterialFlags : uint32_t
+	{
+		MATERIAL_TEXTURED = 1,
+		MATERIAL_SPECULAR = 2
+	};
+
+	struct MaterialRecord
+	{
+		uint32_t flags;
+		float color[3];
+		float ambientStrength;
+		float specularIntensity;
+		float highlightSize;
+	};
+
+	enum VertexLayout : uint32_t
+	{
+		LAYOUT_POSITION = 0,			// x y z
+		LAYOUT_POSITION_NORMAL_UV = 1	// x y z, nx ny nz, u v
+	};
+
+	inline uint32_t FloatsPerVertex(uint32_t layout)
+	{
+		return layout == LAYOUT_POSITION_NORMAL_UV ? 8 : 3;
+	}
+
+	struct MeshRecord
+	{
+		uint32_t layout;
+		uint32_t vertexCount;
+		uint64_t vertexOffset;		// bytes into CHUNK_VERTICES
+		uint32_t indexCount;		// 0 for a non-indexed mesh
+		uint32_t reserved;
+		uint64_t indexOffset;		// bytes into CHUNK_INDICES
+		float boundsCenter[3];		// bounding sphere of the vertices
+		float boundsRadius;
+	};
+
+	enum NodeFlags : uint32_t
+	{
+		NODE_LIGHT = 1				// a point light at the node; lightColor is valid
+	};
+
+	// A node without mesh and light only groups its children
+	struct NodeRecord
+	{
+		uint32_t name;				// string offset
+		int32_t parent;				// node index, -1 for a root
+		int32_t mesh;				// -1 for none
+		int32_t material;			// -1 for none; a node with a material is drawn with the cube shader
+		int32_t texture;			// -1 for none
+		uint32_t flags;
+		float position[3];			// relative to the parent
+		float rotation[4];			// quaternion x y z w
+		float scale[3];
+		float uvScale[2];
+		float lightColor[3];
+	};
+
+
+	inline uint64_t Align(uint64_t offset)
+	{
+		return (offset + BLOB_ALIGNMENT - 1) & ~(BLOB_ALIGNMENT - 1);
+	}
+
+
+	// Checks a scene file in memory and gives typed access to its chunks without copying them.
+	// Open() validates every offset, index and count once, so the accessors can trust the data
+	class SceneView
+	{
+	public:
+		bool Open(const void* data, size_t size, std::string& error)
+		{
+			base = static_cast<const unsigned char*>(data);
+			fileSize = size;
+
+			if (size < sizeof(Header))
+				return fail(error, "FILE_TOO_SHORT");
+			header = reinterpret_cast<const Header*>(base);
+			if (header->magic != MAGIC)
+				return fail(error, "NOT_A_SCENE_FILE");
+			if (header->versionMajor != VERSION_MAJOR)
+				return fail(error, "UNSUPPORTED_VERSION " + std::to_string(header->versionMajor) + "." + std::to_string(header->versionMinor));
+			if (header->fileSize != size)
+				return fail(error, "TRUNCATED");
+			if (header->chunkCount > (size - sizeof(Header)) / sizeof(ChunkEntry))
+				return fail(error, "BAD_TABLE_OF_CONTENTS");
+			toc = reinterpret_cast<const ChunkEntry*>(base + sizeof(Header));
+
+			for (uint32_t i = 0; i < header->chunkCount; ++i)
+			{
+				const ChunkEntry& chunk = toc[i];
+				if (chunk.offset % BLOB_ALIGNMENT != 0 || chunk.offset > size || chunk.size > size - chunk.offset)
+					return fail(error, "BAD_CHUNK " + std::to_string(chunk.type));
+			}
+
+			if (!records(CHUNK_TEXTURES, textures, textureCount, error) || !records(CHUNK_MATERIALS, materials, materialCount, error)
+				|| !records(CHUNK_MESHES, meshes, meshCount, error) || !records(CHUNK_NODES, nodes, nodeCount, error))
+				return false;
+
+			const ChunkEntry* chunk = find(CHUNK_STRINGS);
+			strings = chunk ? reinterpret_cast<const char*>(base + chunk->offset) : nullptr;
+			stringsSize = chunk ? chunk->size : 0;
+			if (stringsSize > 0 && strings[stringsSize - 1] != '\0')
+				return fail(error, "BAD_STRINGS");
+
+			chunk = find(CHUNK_VERTICES);
+			vertices = chunk ? base + chunk->offset : nullptr;
+			verticesSize = chunk ? chunk->size : 0;
+			chunk = find(CHUNK_INDICES);
+			indices = chunk ? base + chunk->offset : nullptr;
+			indicesSize = chunk ? chunk->size : 0;
+
+			return validateReferences(error);
+		}
+
+		uint32_t TextureCount() const { return textureCount; }
+		uint32_t MaterialCount() const { return materialCount; }
+		uint32_t MeshCount() const { return meshCount; }
+		uint32_t NodeCount() const { return nodeCount; }
+
+		const TextureRecord& Texture(uint32_t i) const { return textures[i]; }
+		const MaterialRecord& Material(uint32_t i) const { return materials[i]; }
+		const MeshRecord& Mesh(uint32_t i) const { return meshes[i]; }
+		const NodeRecord& Node(uint32_t i) const { return nodes[i]; }
+
+		const char* String(uint32_t offset) const
+		{
+			return strings + offset;
+		}
+
+		// the mesh's bytes inside the file, ready for glBufferData
+		const void* Vertices(const MeshRecord& mesh) const
+		{
+			return vertices + mesh.vertexOffset;
+		}
+
+		size_t VertexBytes(const MeshRecord& mesh) const
+		{
+			return (size_t)mesh.vertexCount * FloatsPerVertex(mesh.layout) * sizeof(float);
+		}
+
+		const void* Indices(const MeshRecord& mesh) const
+		{
+			return indices + mesh.indexOffset;
+		}
+
+		size_t IndexBytes(const MeshRecord& mesh) const
+		{
+			return (size_t)mesh.indexCount * sizeof(uint32_t);
+		}
+
+	private:
+		const unsigned char* base = nullptr;
+		size_t fileSize = 0;
+		const Header* header = nullptr;
+		const ChunkEntry* toc = nullptr;
+
+		const TextureRecord* textures = nullptr;
+		const MaterialRecord* materials = nullptr;
+		const MeshRecord* meshes = nullptr;
+		const NodeRecord* nodes = nullptr;
+		uint32_t textureCount = 0;
+		uint32_t materialCount = 0;
+		uint32_t meshCount = 0;
+		uint32_t nodeCount = 0;
+
+		const char* strings = nullptr;
+		uint64_t stringsSize = 0;
+		const unsigned char* vertices = nullptr;
+		uint64_t verticesSize = 0;
+		const unsigned char* indices = nullptr;
+		uint64_t indicesSize = 0;
+
+		static bool fail(std::string& error, const std::string& message)
+		{
+			error = message;
+			return false;
+		}
+
+		const ChunkEntry* find(uint32_t type) const
+		{
+			for (uint32_t i = 0; i < header->chunkCount; ++i)
+			{
+				if (toc[i].type == type)
+					return &toc[i];
+			}
+			return nullptr;
+		}
+
+		// a missing record chunk is an empty table
+		template <typename T>
+		bool records(uint32_t type, const T*& data, uint32_t& count, std::string& error) const
+		{
+			const ChunkEntry* chunk = find(type);
+			data = chunk ? reinterpret_cast<const T*>(base + chunk->offset) : nullptr;
+			count = chunk ? chunk->count : 0;
+			if (chunk && chunk->size < (uint64_t)count * sizeof(T))
+				return fail(error, "BAD_CHUNK " + std::to_string(type));
+			return true;
+		}
+
+		bool validString(uint32_t offset) const
+		{
+			return offset < stringsSize;
+		}
+
+		bool validateReferences(std::string& error) const
+		{
+			for (uint32_t i = 0; i < textureCount; ++i)
+			{
+				if (!validString(textures[i].path))
+					return fail(error, "BAD_TEXTURE " + std::to_string(i));
+			}
+
+			for (uint32_t i = 0; i < meshCount; ++i)
+			{
+				const MeshRecord& mesh = meshes[i];
+				uint64_t vertexBytes = (uint64_t)mesh.vertexCount * FloatsPerVertex(mesh.layout) * sizeof(float);
+				uint64_t indexBytes = (uint64_t)mesh.indexCount * sizeof(uint32_t);
+				// the vertices and indices are read in place through float and uint32_t pointers
+				if (mesh.layout > LAYOUT_POSITION_NORMAL_UV || mesh.vertexOffset > verticesSize || vertexBytes > verticesSize - mesh.vertexOffset
+					|| mesh.vertexOffset % sizeof(float) != 0
+					|| mesh.indexOffset > indicesSize || indexBytes > indicesSize - mesh.indexOffset || mesh.indexOffset % sizeof(uint32_t) != 0)
+					return fail(error, "BAD_MESH " + std::to_string(i));
+
+				// an index past the vertex range would make the driver read outside the buffer
+				const uint32_t* meshIndices = reinterpret_cast<const uint32_t*>(indices + mesh.indexOffset);
+				for (uint32_t j = 0; j < mesh.indexCount; ++j)
+				{
+					if (meshIndices[j] >= mesh.vertexCount)
+						return fail(error, "BAD_MESH " + std::to_string(i));
+				}
+			}
+
+			for (uint32_t i = 0; i < nodeCount; ++i)
+			{
+				// a material is drawn with the node's mesh, so a node cannot have one without the other
+				const NodeRecord& node = nodes[i];
+				if (!validString(node.name) || node.parent >= (int32_t)i || node.parent < -1
+					|| node.mesh >= (int32_t)meshCount || node.mesh < -1
+					|| node.material >= (int32_t)materialCount || node.material < -1
+					|| node.texture >= (int32_t)textureCount || node.texture < -1
+					|| (node.material >= 0 && node.mesh < 0))
+					return fail(error, "BAD_NODE " + std::to_string(i));
+			}
+			return true;
+		}
+	};
+}
+#endif
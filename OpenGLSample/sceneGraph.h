@@ -0,0 +1,225 @@
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+
+#include <vector>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtx/transform.hpp>
+
+// Position, rotation and scale of a node, relative to its parent (local) or to the world
+struct Transform
+{
+	glm::vec3 position;
+	glm::quat rotation;
+	glm::vec3 scale;
+};
+
+
+// Transform hierarchy. Nodes are stored in one flat array in depth-first order, so every subtree is
+// a contiguous range that starts with its root and a parent always comes before its children.
+// Changing a node only marks it dirty; Update() then walks the dirty subtrees front to back, which
+// costs O(subtree) per moved node and nothing at all for parts of the scene that did not change.
+//
+// World transforms are composed as position/rotation/scale, the form TransformPipeline consumes.
+// Like most engines this treats a parent's scale as aligned with the child's axes, so a non-uniform
+// scale above a rotated child does not shear it.
+//
+// Node handles stay valid when nodes are inserted; the array slots behind them move. A node added at
+// the end of the array, as a root or under the last subtree, moves nothing: AddNodes() appends a whole
+// depth-first scene that way in one pass.
+class SceneGraph
+{
+public:
+	// adds a node under parent (-1 for a root) and returns its handle. object is a caller-defined
+	// index reported with the node, -1 for pure grouping nodes
+	int AddNode(int parent, const Transform& local, int object = -1)
+	{
+		int slot = parent < 0 ? (int)locals.size() : slotOf[parent] + subtreeSizes[slotOf[parent]];
+		int handle = (int)slotOf.size();
+
+		// everything from slot onwards moves one place back; nothing does for a slot at the end
+		if (slot < (int)locals.size())
+		{
+			for (int& s : slotOf)
+			{
+				if (s >= slot)
+					++s;
+			}
+			for (int& p : parents)
+			{
+				if (p >= slot)
+					++p;
+			}
+			for (int& d : dirtySlots)
+			{
+				if (d >= slot)
+					++d;
+			}
+		}
+		slotOf.push_back(slot);
+
+		int parentSlot = parent < 0 ? -1 : slotOf[parent];
+		for (int ancestor = parentSlot; ancestor >= 0; ancestor = parents[ancestor])
+			++subtreeSizes[ancestor];
+
+		locals.insert(locals.begin() + slot, local);
+		worlds.insert(worlds.begin() + slot, local);
+		parents.insert(parents.begin() + slot, parentSlot);
+		subtreeSizes.insert(subtreeSizes.begin() + slot, 1);
+		handles.insert(handles.begin() + slot, handle);
+		objects.insert(objects.begin() + slot, object);
+		dirty.insert(dirty.begin() + slot, false);
+
+		markDirty(slot);
+		return handle;
+	}
+
+	// adds count nodes at once and returns the handle of the first; node i gets that handle plus i.
+	// batchParents[i] is the batch index of node i's parent, which comes before it, or -1 for a root. In
+	// depth-first order the nodes are appended in one pass, in any other they are added one by one
+	int AddNodes(const int* batchParents, const Transform* batchLocals, const int* batchObjects, int count)
+	{
+		int first = (int)slotOf.size();
+
+		// subtree sizes summed back to front; in depth-first order every node lies in its parent's range
+		std::vector<int> sizes(count, 1);
+		for (int i = count - 1; i >= 0; --i)
+		{
+			if (batchParents[i] >= 0)
+				sizes[batchParents[i]] += sizes[i];
+		}
+		for (int i = 0; i < count; ++i)
+		{
+			int parent = batchParents[i];
+			if (parent >= 0 && i >= parent + sizes[parent])
+			{
+				for (int j = 0; j < count; ++j)
+					AddNode(batchParents[j] < 0 ? -1 : first + batchParents[j], batchLocals[j], batchObjects[j]);
+				return first;
+			}
+		}
+
+		int base = (int)locals.size();
+		for (int i = 0; i < count; ++i)
+		{
+			int parent = batchParents[i];
+			slotOf.push_back(base + i);
+			locals.push_back(batchLocals[i]);
+			worlds.push_back(batchLocals[i]);
+			parents.push_back(parent < 0 ? -1 : base + parent);
+			subtreeSizes.push_back(sizes[i]);
+			handles.push_back(first + i);
+			objects.push_back(batchObjects[i]);
+			dirty.push_back(false);
+			// Update() walks each root's subtree, so the roots are the only dirty nodes
+			if (parent < 0)
+				markDirty(base + i);
+		}
+		return first;
+	}
+
+	void SetLocal(int node, const Transform& local)
+	{
+		int slot = slotOf[node];
+		locals[slot] = local;
+		markDirty(slot);
+	}
+
+	void SetLocalPosition(int node, const glm::vec3& position)
+	{
+		int slot = slotOf[node];
+		if (locals[slot].position == position)
+			return;
+		locals[slot].position = position;
+		markDirty(slot);
+	}
+
+	const Transform& GetLocal(int node) const
+	{
+		return locals[slotOf[node]];
+	}
+
+	// world transform as of the last Update()
+	const Transform& GetWorld(int node) const
+	{
+		return worlds[slotOf[node]];
+	}
+
+	glm::mat4 GetWorldMatrix(int node) const
+	{
+		const Transform& world = GetWorld(node);
+		return glm::translate(world.position) * glm::mat4_cast(world.rotation) * glm::scale(world.scale);
+	}
+
+	int GetObject(int node) const
+	{
+		return objects[slotOf[node]];
+	}
+
+	int Count() const
+	{
+		return (int)locals.size();
+	}
+
+	// recomputes the world transforms of every dirty subtree and returns the handles of the nodes whose
+	// world transform was recomputed, parents before children. The list is valid until the next call
+	const std::vector<int>& Update()
+	{
+		changed.clear();
+		if (dirtySlots.empty())
+			return changed;
+
+		// in slot order a dirty node inside an already updated subtree is skipped
+		std::sort(dirtySlots.begin(), dirtySlots.end());
+		int end = 0;
+		for (int root : dirtySlots)
+		{
+			if (root < end)
+				continue;
+			end = root + subtreeSizes[root];
+			for (int slot = root; slot < end; ++slot)
+			{
+				int parent = parents[slot];
+				worlds[slot] = parent < 0 ? locals[slot] : compose(worlds[parent], locals[slot]);
+				dirty[slot] = false;
+				changed.push_back(handles[slot]);
+			}
+		}
+		dirtySlots.clear();
+		return changed;
+	}
+
+private:
+	// per slot, in depth-first order
+	std::vector<Transform> locals;
+	std::vector<Transform> worlds;
+	std::vector<int> parents;		// slot of the parent, -1 for roots
+	std::vector<int> subtreeSizes;	// the node itself plus all its descendants
+	std::vector<int> handles;
+	std::vector<int> objects;
+	std::vector<bool> dirty;
+
+	std::vector<int> slotOf;		// per handle
+	std::vector<int> dirtySlots;
+	std::vector<int> changed;
+
+	void markDirty(int slot)
+	{
+		if (dirty[slot])
+			return;
+		dirty[slot] = true;
+		dirtySlots.push_back(slot);
+	}
+
+	static Transform compose(const Transform& parent, const Transform& local)
+	{
+		Transform world;
+		world.position = parent.position + parent.rotation * (parent.scale * local.position);
+		world.rotation = parent.rotation * local.rotation;
+		world.scale = parent.scale * local.scale;
+		return world;
+	}
+};
+#endif
@@ -10,13 +10,15 @@
 #include <sstream>
 #include <iostream>
 
+#include "programCache.h"
+
 class Shader
 {
 public:
 	unsigned int ID;
-	// constructor generates the shader on the fly
+	// constructor generates the shader on the fly, or loads the linked binary from the cache if one is given
 	// ------------------------------------------------------------------------
-	Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+	Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr, ProgramCache* cache = nullptr)
 	{
 		// 1. retrieve the vertex/fragment source code from filePath
 		std::string vertexCode;
@@ -60,7 +62,17 @@ public:
 		}
 		const char* vShaderCode = vertexCode.c_str();
 		const char* fShaderCode = fragmentCode.c_str();
-		// 2. compile shaders
+		// 2. reuse a previously linked binary when the sources and driver are unchanged
+		uint64_t cacheKey = 0;
+		if (cache != nullptr)
+		{
+			const char* sources[] = { vShaderCode, fShaderCode, geometryPath != nullptr ? geometryCode.c_str() : nullptr };
+			cacheKey = cache->MakeKey(sources, 3);
+			ID = cache->Load(cacheKey);
+			if (ID != 0)
+				return;
+		}
+		// 3. compile shaders
 		unsigned int vertex, fragment;
 		// vertex shader
 		vertex = glCreateShader(GL_VERTEX_SHADER);
@@ -88,8 +100,11 @@ public:
 		glAttachShader(ID, fragment);
 		if (geometryPath != nullptr)
 			glAttachShader(ID, geometry);
+		if (cache != nullptr)
+			cache->PrepareForLink(ID);
 		glLinkProgram(ID);
-		checkCompileErrors(ID, "PROGRAM");
+		if (checkCompileErrors(ID, "PROGRAM") && cache != nullptr)
+			cache->Store(cacheKey, ID);
 		// delete the shaders as they're linked into our program now and no longer necessery
 		glDeleteShader(vertex);
 		glDeleteShader(fragment);
@@ -163,9 +178,9 @@ public:
 	}
 
 private:
-	// utility function for checking shader compilation/linking errors.
+	// utility function for checking shader compilation/linking errors. Returns true on success
 	// ------------------------------------------------------------------------
-	void checkCompileErrors(GLuint shader, std::string type)
+	bool checkCompileErrors(GLuint shader, std::string type)
 	{
 		GLint success;
 		GLchar infoLog[1024];
@@ -187,6 +202,7 @@ private:
 				std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
 			}
 		}
+		return success != 0;
 	}
 };
 #endif
@@ -0,0 +1,104 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+// The OpenGL loader (GLEW or glad) and GLFW have to be included before this header
+
+#include <map>
+#include <string>
+
+#include "programBatch.h"
+
+// Compiles permutations of one uber shader by injecting #defines after its #version line:
+//   NUM_LIGHTS    number of point lights the fragment loop runs over (1..MAX_LIGHTS)
+//   USE_TEXTURE   1 samples uTexture, 0 uses the flat objectColor
+//   USE_SPECULAR  1 adds the Phong specular term
+//   DEFERRED      1 writes the surface into the G-buffer instead of lighting it; NUM_LIGHTS is
+//                 unused then, so the deferred permutations are all kept with one light
+//   CLUSTERED     1 adds the point lights of the fragment's cluster in the light grid
+// Each permutation is compiled the first time it is asked for, then kept in memory here and
+// on disk through the batch's program cache, so every object can use the cheapest shader it needs.
+class ShaderVariants
+{
+public:
+	static const int MAX_LIGHTS = 8;
+
+	// how the point lights are shaded: DEFERRED and CLUSTERED select the matching define
+	enum Path
+	{
+		PATH_FORWARD,
+		PATH_DEFERRED,
+		PATH_CLUSTERED,
+		PATH_COUNT
+	};
+
+	static const char* PathName(Path path)
+	{
+		static const char* const names[PATH_COUNT] = { "forward", "deferred", "clustered forward" };
+		return names[path];
+	}
+
+	ShaderVariants(const char* name, const char* vertexSource, const char* fragmentSource, ProgramBatch& batch)
+		: name(name), vertexSource(vertexSource), fragmentSource(fragmentSource), batch(batch)
+	{
+	}
+
+	// returns the linked program for a permutation, or 0 while it is still compiling
+	GLuint Get(int lightCount, bool textured, bool specular, Path path = PATH_FORWARD)
+	{
+		bool deferred = path == PATH_DEFERRED;
+		bool clustered = path == PATH_CLUSTERED;
+		if (lightCount < 1 || deferred)
+			lightCount = 1;
+		if (lightCount > MAX_LIGHTS)
+			lightCount = MAX_LIGHTS;
+
+		unsigned int key = (unsigned int)lightCount | (textured ? 0x10u : 0u) | (specular ? 0x20u : 0u) | (deferred ? 0x40u : 0u) | (clustered ? 0x80u : 0u);
+		auto found = programs.find(key);
+		if (found == programs.end())
+		{
+			std::string defines = "#define NUM_LIGHTS " + std::to_string(lightCount) + "\n"
+				+ "#define USE_TEXTURE " + (textured ? "1" : "0") + "\n"
+				+ "#define USE_SPECULAR " + (specular ? "1" : "0") + "\n"
+				+ "#define DEFERRED " + (deferred ? "1" : "0") + "\n"
+				+ "#define CLUSTERED " + (clustered ? "1" : "0") + "\n";
+			std::string vertexCode = inject(vertexSource, defines);
+			std::string fragmentCode = inject(fragmentSource, defines);
+
+			GLuint programId = 0;
+			batch.Submit((name + "[" + std::to_string(key) + "]").c_str(), vertexCode.c_str(), fragmentCode.c_str(), programId, defines);
+			found = programs.emplace(key, programId).first;
+		}
+
+		return batch.IsReady(found->second) ? found->second : 0;
+	}
+
+	// number of permutations requested so far
+	size_t Count() const
+	{
+		return programs.size();
+	}
+
+	void Destroy()
+	{
+		for (auto& entry : programs)
+			glDeleteProgram(entry.second);
+		programs.clear();
+	}
+
+private:
+	std::string name;
+	std::string vertexSource;
+	std::string fragmentSource;
+	ProgramBatch& batch;
+	std::map<unsigned int, GLuint> programs;
+
+	// #version has to stay the first line, so the defines go right after it
+	static std::string inject(const std::string& source, const std::string& defines)
+	{
+		size_t lineEnd = source.find('\n');
+		if (lineEnd == std::string::npos)
+			return source + "\n" + defines;
+		return source.substr(0, lineEnd + 1) + defines + source.substr(lineEnd + 1);
+	}
+};
+#endif
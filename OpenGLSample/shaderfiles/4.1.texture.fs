@@ -1,13 +0,0 @@
-#version 330 core
-out vec4 FragColor;
-
-in vec3 ourColor;
-in vec2 TexCoord;
-
-// texture sampler
-uniform sampler2D texture1;
-
-void main()
-{
-	FragColor = texture(texture1, TexCoord);
-}
\ No newline at end of file
@@ -1,14 +0,0 @@
-#version 330 core
-in vec3 ourColor;
-in vec2 TexCoord;
-
-out vec4 color;
-
-// Texture samplers
-uniform sampler2D ourTexture1;
-
-void main()
-{
-    // Linearly interpolate between both textures (second texture is only slightly combined)
-    color = texture(ourTexture1, TexCoord);
-}
\ No newline at end of file
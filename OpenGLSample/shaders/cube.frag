@@ -0,0 +1,101 @@
+#version 440 core
+// Uber shader: ShaderVariants injects NUM_LIGHTS, USE_TEXTURE, USE_SPECULAR, DEFERRED and CLUSTERED after the #version line
+#include "include/frame_data.glsl"
+#include "include/phong.glsl"
+#include "include/draw_data.glsl"
+#include "include/gbuffer.glsl"
+#include "include/point_lights.glsl"
+#include "include/light_grid.glsl"
+
+#ifndef NUM_LIGHTS
+#define NUM_LIGHTS 1
+#endif
+#ifndef USE_TEXTURE
+#define USE_TEXTURE 1
+#endif
+#ifndef USE_SPECULAR
+#define USE_SPECULAR 1
+#endif
+#ifndef DEFERRED
+#define DEFERRED 0
+#endif
+#ifndef CLUSTERED
+#define CLUSTERED 0
+#endif
+
+in vec3 vertexNormal; // For incoming normals
+in vec3 vertexFragmentPos; // For incoming fragment position
+in vec2 vertexTextureCoordinate;
+flat in int vertexDrawIndex;
+
+#if DEFERRED
+// The surface goes into the G-buffer, the lighting passes light it later
+layout(location = 0) out vec4 albedoOutput;
+layout(location = 1) out vec4 normalOutput;
+#else
+out vec4 fragmentColor; // For outgoing cube color to the GPU
+#endif
+
+// The lights come from FrameData, the material from this draw's DrawData entry
+#if USE_TEXTURE
+layout(binding = 0) uniform sampler2D uTexture; // Texture unit 0, set in the shader so no glUniform call is needed after linking
+#endif
+
+void main()
+{
+    /*Phong lighting model calculations to generate ambient, diffuse, and specular components*/
+    DrawData draw = draws[vertexDrawIndex];
+    vec3 norm = normalize(vertexNormal); // Normalize vectors to 1 unit
+
+#if USE_TEXTURE
+    // Texture holds the color to be used for all three components
+    vec3 baseColor = texture(uTexture, vertexTextureCoordinate * draw.uvScale).xyz;
+#else
+    vec3 baseColor = draw.objectColor.rgb;
+#endif
+
+#if DEFERRED
+    albedoOutput = vec4(baseColor, draw.ambientStrength);
+#if USE_SPECULAR
+    normalOutput = vec4(EncodeNormal(norm), draw.specularIntensity, draw.highlightSize);
+#else
+    normalOutput = vec4(EncodeNormal(norm), 0.0, 1.0);
+#endif
+#else
+#if USE_SPECULAR
+    vec3 viewDir = normalize(viewPosition.xyz - vertexFragmentPos); // Calculate view direction
+#endif
+
+    // The loop count is a compile-time constant, so each variant is unrolled for exactly its lights
+    vec3 lighting = vec3(0.0);
+    for (int i = 0; i < NUM_LIGHTS; ++i)
+    {
+        lighting += PhongAmbientDiffuse(norm, vertexFragmentPos, lightPositions[i].xyz, lightColors[i].rgb, draw.ambientStrength);
+#if USE_SPECULAR
+        lighting += PhongSpecular(norm, vertexFragmentPos, viewDir, lightPositions[i].xyz, lightColors[i].rgb, draw.specularIntensity, draw.highlightSize);
+#endif
+    }
+
+#if CLUSTERED
+    // Then the point lights of this fragment's cluster only, however many the scene has
+    float viewDepth = -(view * vec4(vertexFragmentPos, 1.0)).z;
+    Cluster cluster = clusters[ClusterIndex(gl_FragCoord.xy, viewDepth)];
+    for (uint i = 0u; i < cluster.count; ++i)
+    {
+        PointLight light = pointLights[clusterLightIndices[cluster.offset + i]];
+        vec3 lightPosition = light.positionRadius.xyz;
+        float falloff = PointLightFalloff(distance(lightPosition, vertexFragmentPos), light.positionRadius.w);
+        if (falloff <= 0.0)
+            continue;
+
+        vec3 pointLighting = PhongAmbientDiffuse(norm, vertexFragmentPos, lightPosition, light.color.rgb, 0.0);
+#if USE_SPECULAR
+        pointLighting += PhongSpecular(norm, vertexFragmentPos, viewDir, lightPosition, light.color.rgb, draw.specularIntensity, draw.highlightSize);
+#endif
+        lighting += falloff * pointLighting;
+    }
+#endif
+
+    fragmentColor = vec4(lighting * baseColor, 1.0); // Send lighting results to GPU
+#endif
+}
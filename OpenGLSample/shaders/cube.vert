@@ -0,0 +1,29 @@
+#version 440 core
+#include "include/instance_data.glsl"
+#include "include/draw_data.glsl"
+
+layout(location = 0) in vec3 position; // VAP position 0 for vertex position data
+layout(location = 1) in vec3 normal; // VAP position 1 for normals
+layout(location = 2) in vec2 textureCoordinate;
+layout(location = DRAW_INDEX_LOCATION) in int drawIndex; // one value per draw
+
+out vec3 vertexNormal; // For outgoing normals to fragment shader
+out vec3 vertexFragmentPos; // For outgoing color / pixels to fragment shader
+out vec2 vertexTextureCoordinate;
+flat out int vertexDrawIndex; // For the material lookup in the fragment shader
+
+// Must match depth.vert's position bit for bit, for the GL_EQUAL depth test after the pre-pass
+invariant gl_Position;
+
+void main()
+{
+    InstanceData instance = instances[draws[drawIndex].instance];
+
+    gl_Position = instance.mvp * vec4(position, 1.0f); // Transforms vertices into clip coordinates
+
+    vertexFragmentPos = vec3(instance.model * vec4(position, 1.0f)); // Gets fragment / pixel position in world space only (exclude view and projection)
+
+    vertexNormal = instance.normalMatrix * normal; // get normal vectors in world space only and exclude normal translation properties
+    vertexTextureCoordinate = textureCoordinate;
+    vertexDrawIndex = drawIndex;
+}
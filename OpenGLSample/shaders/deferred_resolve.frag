@@ -0,0 +1,29 @@
+#version 440 core
+#define GBUFFER_SAMPLERS
+#include "include/frame_data.glsl"
+#include "include/phong.glsl"
+#include "include/gbuffer.glsl"
+
+// Deferred path, first lighting pass: the scene's lights, ambient included, over the whole G-buffer.
+// The point lights are added on top by the light volumes
+uniform int lightCount; // lights in FrameData
+
+out vec4 fragmentColor;
+
+void main()
+{
+    Surface surface;
+    if (!ReadSurface(ivec2(gl_FragCoord.xy), surface))
+        discard;
+
+    vec3 viewDir = normalize(viewPosition.xyz - surface.position); // Calculate view direction
+    vec3 lighting = vec3(0.0);
+    for (int i = 0; i < lightCount; ++i)
+    {
+        lighting += PhongAmbientDiffuse(surface.normal, surface.position, lightPositions[i].xyz, lightColors[i].rgb, surface.ambientStrength);
+        if (surface.specularIntensity > 0.0)
+            lighting += PhongSpecular(surface.normal, surface.position, viewDir, lightPositions[i].xyz, lightColors[i].rgb, surface.specularIntensity, surface.highlightSize);
+    }
+
+    fragmentColor = vec4(lighting * surface.albedo, 1.0);
+}
@@ -0,0 +1,6 @@
+#version 440 core
+
+// Depth pre-pass: the color writes are masked, only the depth test and write run
+void main()
+{
+}
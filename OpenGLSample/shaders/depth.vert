@@ -0,0 +1,16 @@
+#version 440 core
+#include "include/instance_data.glsl"
+#include "include/draw_data.glsl"
+
+// Depth pre-pass: positions only, read from GeometryPool's position stream
+layout(location = 0) in vec3 position; // VAP position 0 for vertex position data
+layout(location = DRAW_INDEX_LOCATION) in int drawIndex; // one value per draw
+
+// The shading pass tests with GL_EQUAL against this depth, so both programs have to compute the exact
+// same position; cube.vert declares it invariant as well
+invariant gl_Position;
+
+void main()
+{
+    gl_Position = instances[draws[drawIndex].instance].mvp * vec4(position, 1.0f); // Transforms vertices into clip coordinates
+}
@@ -0,0 +1,21 @@
+// Per-draw data: the object's entry in Instances and its material. The main thread writes one entry
+// per draw of the frame, the render thread binds them at binding 2. A draw finds its entry through
+// the per-instance attribute at DRAW_INDEX_LOCATION: every draw's base instance is its entry, and the
+// vertex arrays feed base instance n as the value n (GeometryPool), so the draws of one
+// glMultiDrawElementsIndirect call each read their own entry
+struct DrawData
+{
+    vec4 objectColor; // rgb, surface color of untextured variants
+    vec2 uvScale;
+    float ambientStrength; // Ambient or global lighting strength
+    float specularIntensity; // Specular light strength
+    float highlightSize; // Specular highlight size
+    int instance;
+};
+
+layout(std430, binding = 2) readonly buffer Draws
+{
+    DrawData draws[];
+};
+
+#define DRAW_INDEX_LOCATION 3 // GeometryPool::DRAW_INDEX_LOCATION
@@ -0,0 +1,16 @@
+// Per-frame data shared by every program: camera, lights and the view frustum. The render thread writes it once per frame
+// into the frame's region of the ring buffer and binds it at binding 0, instead of setting uniforms on
+// each program
+#define MAX_LIGHTS 8 // ShaderVariants::MAX_LIGHTS
+
+layout(std140, binding = 0) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    vec4 viewPosition; // xyz = camera position in world space
+    vec4 lightPositions[MAX_LIGHTS]; // xyz, world space; the variants read the first NUM_LIGHTS
+    vec4 lightColors[MAX_LIGHTS]; // rgb
+    vec4 frustumPlanes[6]; // world space: xyz = normal pointing inside, w = distance (Camera::FrustumPlane order)
+    mat4 inverseViewProjection; // from normalized device coordinates back to world space
+    vec4 clusterParameters; // LightGrid::ShaderParameters(): x = near plane, y = slices per log(depth), zw = tiles per pixel
+};
@@ -0,0 +1,63 @@
+// G-buffer of the deferred path (GBuffer): the geometry pass writes the surface seen at every pixel,
+// the lighting passes read it back with texelFetch
+//   albedo  RGBA8    rgb = base color, a = ambient strength
+//   normal  RGBA16F  rg = world-space normal, octahedral encoding, b = specular intensity, a = highlight size
+//   depth            the depth buffer, for the world position
+// A lighting pass defines GBUFFER_SAMPLERS before including this file
+
+#ifdef GBUFFER_SAMPLERS
+layout(binding = 0) uniform sampler2D gBufferAlbedo; // GBuffer::ALBEDO_UNIT
+layout(binding = 1) uniform sampler2D gBufferNormal; // GBuffer::NORMAL_UNIT
+layout(binding = 2) uniform sampler2D gBufferDepth; // GBuffer::DEPTH_UNIT
+#endif
+
+// Unit normal to two components: folded onto an octahedron, then its lower half onto the upper
+vec2 EncodeNormal(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 folded = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return n.z >= 0.0 ? n.xy : folded;
+}
+
+vec3 DecodeNormal(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+#ifdef GBUFFER_SAMPLERS
+struct Surface
+{
+    vec3 position; // world space
+    vec3 normal;
+    vec3 albedo;
+    float ambientStrength;
+    float specularIntensity;
+    float highlightSize;
+};
+
+// false where the geometry pass drew nothing
+bool ReadSurface(ivec2 pixel, out Surface surface)
+{
+    float depth = texelFetch(gBufferDepth, pixel, 0).r;
+    if (depth >= 1.0)
+        return false;
+
+    // needs FrameData; the position goes back through the inverse view-projection
+    vec2 ndc = (vec2(pixel) + 0.5) / vec2(textureSize(gBufferDepth, 0)) * 2.0 - 1.0;
+    vec4 world = inverseViewProjection * vec4(ndc, depth * 2.0 - 1.0, 1.0);
+    surface.position = world.xyz / world.w;
+
+    vec4 albedo = texelFetch(gBufferAlbedo, pixel, 0);
+    vec4 normal = texelFetch(gBufferNormal, pixel, 0);
+    surface.normal = DecodeNormal(normal.rg);
+    surface.albedo = albedo.rgb;
+    surface.ambientStrength = albedo.a;
+    surface.specularIntensity = normal.b;
+    surface.highlightSize = normal.a;
+    return true;
+}
+#endif
@@ -0,0 +1,13 @@
+// Per-object transforms. TransformPipeline computes the matrices of every object once per frame; the
+// render thread copies them into the frame's region of the ring buffer and binds them at binding 1
+struct InstanceData
+{
+    mat4 model;
+    mat4 mvp;          // projection * view * model
+    mat3 normalMatrix; // inverse transpose of the model's upper 3x3
+};
+
+layout(std430, binding = 1) readonly buffer Instances
+{
+    InstanceData instances[];
+};
@@ -0,0 +1,33 @@
+// Clustered forward path: the view frustum cut into LIGHT_GRID_X x LIGHT_GRID_Y screen tiles and
+// LIGHT_GRID_Z exponential depth slices, each cluster with the range of clusterLightIndices that lists
+// the point lights reaching into it. The main thread builds the grid (LightGrid), the render thread
+// binds it at bindings 7 and 8
+#define LIGHT_GRID_X 16 // LightGrid::GRID_X
+#define LIGHT_GRID_Y 9
+#define LIGHT_GRID_Z 24
+
+struct Cluster
+{
+    uint offset; // first entry in clusterLightIndices
+    uint count;
+};
+
+layout(std430, binding = 7) readonly buffer Clusters
+{
+    Cluster clusters[];
+};
+
+layout(std430, binding = 8) readonly buffer ClusterLights
+{
+    uint clusterLightIndices[]; // into pointLights
+};
+
+// The cluster of a fragment, from its window position and its view-space depth (distance in front of
+// the camera), with FrameData's clusterParameters
+int ClusterIndex(vec2 fragCoord, float viewDepth)
+{
+    ivec2 tile = clamp(ivec2(fragCoord * clusterParameters.zw), ivec2(0), ivec2(LIGHT_GRID_X - 1, LIGHT_GRID_Y - 1));
+    int slice = int(log(max(viewDepth / clusterParameters.x, 1.0)) * clusterParameters.y);
+    slice = clamp(slice, 0, LIGHT_GRID_Z - 1);
+    return (slice * LIGHT_GRID_Y + tile.y) * LIGHT_GRID_X + tile.x;
+}
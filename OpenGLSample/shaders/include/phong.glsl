@@ -0,0 +1,20 @@
+// Phong lighting terms for one point light
+
+// Ambient and diffuse light reaching a fragment
+vec3 PhongAmbientDiffuse(vec3 norm, vec3 fragPos, vec3 lightPosition, vec3 lightColor, float ambientStrength)
+{
+    vec3 ambient = ambientStrength * lightColor; // Generate ambient light color
+
+    vec3 lightDirection = normalize(lightPosition - fragPos); // Calculate distance (light direction) between light source and fragments/pixels
+    float impact = max(dot(norm, lightDirection), 0.0); // Calculate diffuse impact by generating dot product of normal and light
+    return ambient + impact * lightColor;
+}
+
+// Specular highlight seen from viewDir
+vec3 PhongSpecular(vec3 norm, vec3 fragPos, vec3 viewDir, vec3 lightPosition, vec3 lightColor, float specularIntensity, float highlightSize)
+{
+    vec3 lightDirection = normalize(lightPosition - fragPos);
+    vec3 reflectDir = reflect(-lightDirection, norm); // Calculate reflection vector
+    float specularComponent = pow(max(dot(viewDir, reflectDir), 0.0), highlightSize);
+    return specularIntensity * specularComponent * lightColor;
+}
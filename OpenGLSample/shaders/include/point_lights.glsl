@@ -0,0 +1,20 @@
+// Point lights with a limited range, besides the scene's lights in FrameData. The main thread writes
+// the ones that reach into the view frustum each frame, the render thread binds them at binding 6
+struct PointLight
+{
+    vec4 positionRadius; // xyz = world position, w = radius of influence
+    vec4 color; // rgb
+};
+
+layout(std430, binding = 6) readonly buffer PointLights
+{
+    PointLight pointLights[];
+};
+
+// 1 at the light, falling smoothly to 0 at its radius, so a light's volume can bound its pixels
+float PointLightFalloff(float distance, float radius)
+{
+    float ratio = distance / radius;
+    float window = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+    return window * window;
+}
@@ -0,0 +1,8 @@
+#version 440 core
+
+out vec4 fragmentColor; // For outgoing lamp color (smaller cube) to the GPU
+
+void main()
+{
+    fragmentColor = vec4(0.8f, 1.0f, 1.0f, 1.0f); // Set color and alpha of lamps
+}
@@ -0,0 +1,11 @@
+#version 440 core
+#include "include/instance_data.glsl"
+#include "include/draw_data.glsl"
+
+layout(location = 0) in vec3 position; // VAP position 0 for vertex position data
+layout(location = DRAW_INDEX_LOCATION) in int drawIndex; // one value per draw
+
+void main()
+{
+    gl_Position = instances[draws[drawIndex].instance].mvp * vec4(position, 1.0f); // Transforms vertices into clip coordinates
+}
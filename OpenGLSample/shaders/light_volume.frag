@@ -0,0 +1,36 @@
+#version 440 core
+#define GBUFFER_SAMPLERS
+#include "include/frame_data.glsl"
+#include "include/phong.glsl"
+#include "include/point_lights.glsl"
+#include "include/gbuffer.glsl"
+
+// Deferred path: one point light's diffuse and specular light on the G-buffer pixels its volume covers,
+// added to the frame with additive blending. Only the volume's back faces are drawn, where they lie
+// behind the surface, so a pixel is lit once per light whose volume contains its surface or passes in
+// front of it
+flat in int vertexLight;
+
+out vec4 fragmentColor;
+
+void main()
+{
+    Surface surface;
+    if (!ReadSurface(ivec2(gl_FragCoord.xy), surface))
+        discard;
+
+    PointLight light = pointLights[vertexLight];
+    vec3 lightPosition = light.positionRadius.xyz;
+    float falloff = PointLightFalloff(distance(lightPosition, surface.position), light.positionRadius.w);
+    if (falloff <= 0.0)
+        discard;
+
+    vec3 lighting = PhongAmbientDiffuse(surface.normal, surface.position, lightPosition, light.color.rgb, 0.0);
+    if (surface.specularIntensity > 0.0)
+    {
+        vec3 viewDir = normalize(viewPosition.xyz - surface.position);
+        lighting += PhongSpecular(surface.normal, surface.position, viewDir, lightPosition, light.color.rgb, surface.specularIntensity, surface.highlightSize);
+    }
+
+    fragmentColor = vec4(falloff * lighting * surface.albedo, 1.0);
+}
@@ -0,0 +1,21 @@
+#version 440 core
+#include "include/frame_data.glsl"
+#include "include/point_lights.glsl"
+
+// Deferred path: one cube around each point light's sphere of influence, drawn instanced, one instance
+// per light, and built from gl_VertexID so no vertex buffer is read. The faces wind outwards
+const int CUBE_CORNERS[36] = int[](
+    0, 6, 2, 0, 4, 6, 1, 3, 7, 1, 7, 5, 0, 1, 5, 0, 5, 4,
+    2, 7, 3, 2, 6, 7, 0, 3, 1, 0, 2, 3, 4, 5, 7, 4, 7, 6);
+
+flat out int vertexLight;
+
+void main()
+{
+    PointLight light = pointLights[gl_InstanceID];
+    int corner = CUBE_CORNERS[gl_VertexID];
+    vec3 offset = vec3((corner & 1) != 0 ? 1.0 : -1.0, (corner & 2) != 0 ? 1.0 : -1.0, (corner & 4) != 0 ? 1.0 : -1.0);
+
+    gl_Position = projection * view * vec4(light.positionRadius.xyz + offset * light.positionRadius.w, 1.0);
+    vertexLight = gl_InstanceID;
+}
@@ -0,0 +1,190 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+
+// Advances the simulation in fixed steps, independent of the frame rate. Each frame adds its real
+// duration to an accumulator and runs as many whole steps as fit; the remainder becomes the
+// interpolation factor between the last two simulated states. Because every step uses the same
+// dt, the same inputs always produce the same states, whatever the rendering speed.
+class FixedTimestep
+{
+public:
+	// frames longer than this (breakpoints, window drags) are clamped instead of simulated step by step
+	static constexpr double MAX_FRAME_TIME = 0.25;
+
+	FixedTimestep(double stepsPerSecond = 120.0) : step(1.0 / stepsPerSecond)
+	{
+	}
+
+	// adds a frame's real duration and returns how many steps to simulate for it
+	int Advance(double frameSeconds)
+	{
+		if (frameSeconds > MAX_FRAME_TIME)
+			frameSeconds = MAX_FRAME_TIME;
+		if (frameSeconds < 0.0)
+			frameSeconds = 0.0;
+
+		accumulator += frameSeconds;
+		int steps = (int)(accumulator / step);
+		accumulator -= steps * step;
+		stepCount += steps;
+		return steps;
+	}
+
+	// fixed duration of one step, in seconds
+	float StepSeconds() const
+	{
+		return (float)step;
+	}
+
+	// how far rendering is between the previous and the current state, 0..1
+	float Alpha() const
+	{
+		return (float)(accumulator / step);
+	}
+
+	uint64_t StepCount() const
+	{
+		return stepCount;
+	}
+
+private:
+	double step;
+	double accumulator = 0.0;
+	uint64_t stepCount = 0;
+};
+
+
+// Everything a simulation step reads from the player. Recording these per step is enough to replay a
+// session exactly, since mouse look only reaches the simulation through the camera orientation
+struct StepInput
+{
+	enum Keys : uint32_t
+	{
+		MOVE_FORWARD = 1 << 0,
+		MOVE_BACKWARD = 1 << 1,
+		MOVE_LEFT = 1 << 2,
+		MOVE_RIGHT = 1 << 3,
+		PITCH_UP = 1 << 4,
+		PITCH_DOWN = 1 << 5,
+		LAMP_RESUME = 1 << 6,
+		LAMP_PAUSE = 1 << 7
+	};
+
+	uint32_t keys;
+	float yaw;
+	float pitch;
+};
+
+
+// Records the input of every simulation step to a file, or plays one back
+class InputRecording
+{
+public:
+	bool IsRecording() const
+	{
+		return recording;
+	}
+
+	bool IsReplaying() const
+	{
+		return replaying;
+	}
+
+	void StartRecording(const std::string& filename, float seconds)
+	{
+		path = filename;
+		stepSeconds = seconds;
+		steps.clear();
+		recording = true;
+	}
+
+	void Record(const StepInput& input)
+	{
+		steps.push_back(input);
+	}
+
+	// writes the recorded steps; call once at exit
+	bool Save()
+	{
+		if (!recording)
+			return true;
+		recording = false;
+
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		FileHeader header = { MAGIC, VERSION, stepSeconds, (uint32_t)steps.size() };
+		if (!out || !out.write((const char*)&header, sizeof(header)) || !out.write((const char*)steps.data(), steps.size() * sizeof(StepInput)))
+		{
+			std::cout << "ERROR::INPUT_RECORDING::CANNOT_WRITE " << path << std::endl;
+			return false;
+		}
+		std::cout << "INFO: Recorded " << steps.size() << " simulation steps to " << path << std::endl;
+		return true;
+	}
+
+	// loads a recording made with the same step rate
+	bool StartReplay(const std::string& filename, float seconds)
+	{
+		std::ifstream in(filename, std::ios::binary);
+		FileHeader header;
+		if (!in || !in.read((char*)&header, sizeof(header)) || header.magic != MAGIC || header.version != VERSION)
+		{
+			std::cout << "ERROR::INPUT_RECORDING::CANNOT_READ " << filename << std::endl;
+			return false;
+		}
+		if (header.stepSeconds != seconds)
+		{
+			std::cout << "ERROR::INPUT_RECORDING::STEP_RATE_MISMATCH " << filename << std::endl;
+			return false;
+		}
+
+		steps.resize(header.count);
+		if (!in.read((char*)steps.data(), steps.size() * sizeof(StepInput)))
+		{
+			std::cout << "ERROR::INPUT_RECORDING::TRUNCATED " << filename << std::endl;
+			return false;
+		}
+		next = 0;
+		replaying = true;
+		return true;
+	}
+
+	// input of the next recorded step. False once the recording is exhausted
+	bool Next(StepInput& input)
+	{
+		if (!replaying || next >= steps.size())
+			return false;
+		input = steps[next++];
+		return true;
+	}
+
+	bool IsFinished() const
+	{
+		return replaying && next >= steps.size();
+	}
+
+private:
+	static const uint32_t MAGIC = 0x43524E49; // "INRC"
+	static const uint32_t VERSION = 1;
+
+	struct FileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		float stepSeconds;
+		uint32_t count;
+	};
+
+	std::string path;
+	float stepSeconds = 0.0f;
+	std::vector<StepInput> steps;
+	size_t next = 0;
+	bool recording = false;
+	bool replaying = false;
+};
+#endif
@@ -0,0 +1,309 @@
+#ifndef TRANSFORM_PIPELINE_H
+#define TRANSFORM_PIPELINE_H
+
+// The OpenGL loader (GLEW or glad) has to be included before this header
+
+#include <vector>
+#include <functional>
+#include <cstring>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "ringBuffer.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define TRANSFORM_PIPELINE_SSE
+#endif
+
+// Positions, rotations and scales of every object in structure-of-arrays form. Compute() turns them
+// into model, model-view-projection and normal matrices for the whole set in one pass, four objects
+// per SSE lane group, split into chunks that can run on several threads. It touches no GL state, so
+// it runs on any thread and writes straight into the frame's region of the ring buffer, reserved for
+// it with RingBuffer::Reserve(); Bind() then makes that range the Instances storage block
+// (shaders/include/instance_data.glsl) on the thread that draws.
+class TransformPipeline
+{
+public:
+	static const GLuint BINDING = 1;
+	static const int CHUNK_SIZE = 4096;	// objects per parallel task, a multiple of 4
+
+	// std430 layout of InstanceData: a mat3 is stored as three vec4 columns
+	struct InstanceData
+	{
+		float model[4][4];
+		float mvp[4][4];
+		float normalMatrix[3][4];
+	};
+
+	// Calls body(0) .. body(count - 1), possibly in parallel, and returns when all calls are done
+	typedef std::function<void(int count, const std::function<void(int)>& body)> ParallelFor;
+
+	// sizes the pipeline for capacity objects
+	void Initialize(int capacity)
+	{
+		this->capacity = capacity;
+
+		// SoA arrays are padded to a multiple of 4 so the SIMD loop never needs a partial load
+		size_t padded = (capacity + 3) & ~3;
+		for (int i = 0; i < COMPONENT_COUNT; ++i)
+			components[i].assign(padded, 0.0f);
+	}
+
+	int Capacity() const
+	{
+		return capacity;
+	}
+
+	// adds an object and returns its index, or -1 when the pipeline is full. rotation is a unit quaternion
+	int Add(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+	{
+		if (count >= capacity)
+			return -1;
+		int object = count++;
+		Set(object, position, rotation, scale);
+		return object;
+	}
+
+	void Set(int object, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+	{
+		SetPosition(object, position);
+		SetRotation(object, rotation);
+		SetScale(object, scale);
+	}
+
+	void SetPosition(int object, const glm::vec3& position)
+	{
+		components[POSITION_X][object] = position.x;
+		components[POSITION_Y][object] = position.y;
+		components[POSITION_Z][object] = position.z;
+	}
+
+	void SetRotation(int object, const glm::quat& rotation)
+	{
+		components[ROTATION_X][object] = rotation.x;
+		components[ROTATION_Y][object] = rotation.y;
+		components[ROTATION_Z][object] = rotation.z;
+		components[ROTATION_W][object] = rotation.w;
+	}
+
+	void SetScale(int object, const glm::vec3& scale)
+	{
+		components[SCALE_X][object] = scale.x;
+		components[SCALE_Y][object] = scale.y;
+		components[SCALE_Z][object] = scale.z;
+	}
+
+	glm::vec3 GetPosition(int object) const
+	{
+		return glm::vec3(components[POSITION_X][object], components[POSITION_Y][object], components[POSITION_Z][object]);
+	}
+
+	int Count() const
+	{
+		return count;
+	}
+
+	// computes every object's matrices into out[0 .. Count() - 1]
+	void Compute(const glm::mat4& viewProjection, InstanceData* out, const ParallelFor& parallelFor = SerialFor) const
+	{
+		if (count == 0)
+			return;
+
+		Input input;
+		for (int i = 0; i < COMPONENT_COUNT; ++i)
+			input.components[i] = components[i].data();
+		std::memcpy(input.viewProjection, &viewProjection[0][0], sizeof(input.viewProjection));
+
+		int chunks = (count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+		int total = count;
+		auto body = [&](int chunk)
+		{
+			int first = chunk * CHUNK_SIZE;
+			int n = total - first < CHUNK_SIZE ? total - first : CHUNK_SIZE;
+			ComputeInstances(input, first, n, out);
+		};
+		if (chunks == 1)
+			body(0);
+		else
+			parallelFor(chunks, body);
+	}
+
+	// bytes of the instances of a full pipeline, what a frame reserves for Compute()
+	GLsizeiptr InstanceBytes() const
+	{
+		return (GLsizeiptr)capacity * sizeof(InstanceData);
+	}
+
+	// makes instanceCount instances that Compute() wrote at offset in the ring buffer the Instances
+	// block of the next draws
+	void Bind(const RingBuffer& ring, GLintptr offset, int instanceCount) const
+	{
+		if (instanceCount > capacity)
+			instanceCount = capacity;
+		if (instanceCount > 0)
+			glBindBufferRange(GL_SHADER_STORAGE_BUFFER, BINDING, ring.Buffer(), offset, instanceCount * sizeof(InstanceData));
+	}
+
+	// SoA source arrays and the column-major view-projection matrix for ComputeInstances()
+	enum Component
+	{
+		POSITION_X, POSITION_Y, POSITION_Z,
+		ROTATION_X, ROTATION_Y, ROTATION_Z, ROTATION_W,
+		SCALE_X, SCALE_Y, SCALE_Z,
+		COMPONENT_COUNT
+	};
+	struct Input
+	{
+		const float* components[COMPONENT_COUNT];
+		float viewProjection[16];
+	};
+
+	// With the rotation R and scale S the model's upper 3x3 is R * S, and since R is orthonormal its
+	// inverse transpose is R * S^-1: the normal matrix needs a division per column, not a 3x3 inverse.
+	// Writes out[first .. first + n - 1]
+	static void ComputeInstances(const Input& in, int first, int n, InstanceData* out)
+	{
+		const float* vp = in.viewProjection;
+		int i = first;
+		int end = first + n;
+#ifdef TRANSFORM_PIPELINE_SSE
+		// streaming stores bypass the cache, which suits write-combined mapped memory
+		bool stream = (((size_t)(out + first)) & 15) == 0;
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 two = _mm_set1_ps(2.0f);
+		const __m128 zero = _mm_setzero_ps();
+		__m128 vpm[16];
+		for (int k = 0; k < 16; ++k)
+			vpm[k] = _mm_set1_ps(vp[k]);
+
+		for (; i + 4 <= end; i += 4)
+		{
+			__m128 p[3], s[3];
+			for (int k = 0; k < 3; ++k)
+			{
+				p[k] = _mm_loadu_ps(in.components[POSITION_X + k] + i);
+				s[k] = _mm_loadu_ps(in.components[SCALE_X + k] + i);
+			}
+			__m128 qx = _mm_loadu_ps(in.components[ROTATION_X] + i);
+			__m128 qy = _mm_loadu_ps(in.components[ROTATION_Y] + i);
+			__m128 qz = _mm_loadu_ps(in.components[ROTATION_Z] + i);
+			__m128 qw = _mm_loadu_ps(in.components[ROTATION_W] + i);
+
+			__m128 xx = _mm_mul_ps(qx, qx), yy = _mm_mul_ps(qy, qy), zz = _mm_mul_ps(qz, qz);
+			__m128 xy = _mm_mul_ps(qx, qy), xz = _mm_mul_ps(qx, qz), yz = _mm_mul_ps(qy, qz);
+			__m128 wx = _mm_mul_ps(qw, qx), wy = _mm_mul_ps(qw, qy), wz = _mm_mul_ps(qw, qz);
+
+			// r[c][k]: row k of rotation column c, for all four objects
+			__m128 r[3][3];
+			r[0][0] = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz)));
+			r[0][1] = _mm_mul_ps(two, _mm_add_ps(xy, wz));
+			r[0][2] = _mm_mul_ps(two, _mm_sub_ps(xz, wy));
+			r[1][0] = _mm_mul_ps(two, _mm_sub_ps(xy, wz));
+			r[1][1] = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz)));
+			r[1][2] = _mm_mul_ps(two, _mm_add_ps(yz, wx));
+			r[2][0] = _mm_mul_ps(two, _mm_add_ps(xz, wy));
+			r[2][1] = _mm_mul_ps(two, _mm_sub_ps(yz, wx));
+			r[2][2] = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy)));
+
+			InstanceData* o = out + i;
+			for (int c = 0; c < 4; ++c)
+			{
+				// one row per register for now, transposed to one column per object before the store
+				__m128 model[4], mvp[4];
+				for (int k = 0; k < 3; ++k)
+					model[k] = c < 3 ? _mm_mul_ps(r[c][k], s[c]) : p[k];
+				model[3] = c < 3 ? zero : one;
+
+				// mvp column c = VP * model column c; the model's w row is 0 except in column 3
+				for (int row = 0; row < 4; ++row)
+				{
+					__m128 sum = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vpm[row], model[0]), _mm_mul_ps(vpm[4 + row], model[1])),
+						_mm_mul_ps(vpm[8 + row], model[2]));
+					mvp[row] = c == 3 ? _mm_add_ps(sum, vpm[12 + row]) : sum;
+				}
+
+				_MM_TRANSPOSE4_PS(model[0], model[1], model[2], model[3]);
+				storeColumns(o->model[c], model, stream);
+				_MM_TRANSPOSE4_PS(mvp[0], mvp[1], mvp[2], mvp[3]);
+				storeColumns(o->mvp[c], mvp, stream);
+
+				if (c < 3)
+				{
+					__m128 invScale = _mm_div_ps(one, s[c]);
+					__m128 normal[4] = { _mm_mul_ps(r[c][0], invScale), _mm_mul_ps(r[c][1], invScale), _mm_mul_ps(r[c][2], invScale), zero };
+					_MM_TRANSPOSE4_PS(normal[0], normal[1], normal[2], normal[3]);
+					storeColumns(o->normalMatrix[c], normal, stream);
+				}
+			}
+		}
+		if (stream)
+			_mm_sfence();
+#endif
+		// scalar tail (and the whole range without SSE)
+		for (; i < end; ++i)
+		{
+			float qx = in.components[ROTATION_X][i], qy = in.components[ROTATION_Y][i];
+			float qz = in.components[ROTATION_Z][i], qw = in.components[ROTATION_W][i];
+			float r[3][3] = {
+				{ 1.0f - 2.0f * (qy * qy + qz * qz), 2.0f * (qx * qy + qw * qz), 2.0f * (qx * qz - qw * qy) },
+				{ 2.0f * (qx * qy - qw * qz), 1.0f - 2.0f * (qx * qx + qz * qz), 2.0f * (qy * qz + qw * qx) },
+				{ 2.0f * (qx * qz + qw * qy), 2.0f * (qy * qz - qw * qx), 1.0f - 2.0f * (qx * qx + qy * qy) }
+			};
+
+			InstanceData& o = out[i];
+			for (int c = 0; c < 3; ++c)
+			{
+				float scale = in.components[SCALE_X + c][i];
+				for (int k = 0; k < 3; ++k)
+				{
+					o.model[c][k] = r[c][k] * scale;
+					o.normalMatrix[c][k] = r[c][k] / scale;
+				}
+				o.model[c][3] = 0.0f;
+				o.normalMatrix[c][3] = 0.0f;
+			}
+			for (int k = 0; k < 3; ++k)
+				o.model[3][k] = in.components[POSITION_X + k][i];
+			o.model[3][3] = 1.0f;
+
+			for (int c = 0; c < 4; ++c)
+			{
+				for (int row = 0; row < 4; ++row)
+				{
+					o.mvp[c][row] = vp[row] * o.model[c][0] + vp[4 + row] * o.model[c][1] + vp[8 + row] * o.model[c][2]
+						+ vp[12 + row] * o.model[c][3];
+				}
+			}
+		}
+	}
+
+	// runs every chunk on the calling thread
+	static void SerialFor(int count, const std::function<void(int)>& body)
+	{
+		for (int i = 0; i < count; ++i)
+			body(i);
+	}
+
+private:
+	int capacity = 0;
+	int count = 0;
+	std::vector<float> components[COMPONENT_COUNT];
+
+#ifdef TRANSFORM_PIPELINE_SSE
+	// stores one vec4 column for each of four consecutive objects, starting at the first object's column
+	static void storeColumns(float* first, const __m128 columns[4], bool stream)
+	{
+		for (int k = 0; k < 4; ++k)
+		{
+			float* column = first + k * (sizeof(InstanceData) / sizeof(float));
+			if (stream)
+				_mm_stream_ps(column, columns[k]);
+			else
+				_mm_storeu_ps(column, columns[k]);
+		}
+	}
+#endif
+};
+#endif
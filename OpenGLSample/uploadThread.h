@@ -0,0 +1,175 @@
+#ifndef UPLOAD_THREAD_H
+#define UPLOAD_THREAD_H
+
+// The OpenGL loader (GLEW or glad) and GLFW have to be included before this header
+
+#include <deque>
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+// Creates and fills GL objects on a thread of its own, in a hidden context that shares its objects
+// with the window's context. Buffers and textures are shared, so glBufferData and glTexImage2D run
+// here and the render thread only adopts the finished objects: the uploads are followed by a fence,
+// and Poll() on the render thread runs their completions once the fence has signaled, without ever
+// waiting for it. Vertex arrays and framebuffers are not shared between contexts, so completions
+// create those.
+//
+// GLEW's function pointers are process-wide, so the upload context needs no glewInit of its own.
+class UploadThread
+{
+public:
+	typedef std::function<void()> Task;
+
+	UploadThread() = default;
+	UploadThread(const UploadThread&) = delete;
+	UploadThread& operator=(const UploadThread&) = delete;
+
+	~UploadThread()
+	{
+		Destroy();
+	}
+
+	// main thread: creates the upload context, sharing with window's, and starts the thread. The
+	// context hints of the window (version, profile) must still be set
+	bool Initialize(GLFWwindow* window)
+	{
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		context = glfwCreateWindow(1, 1, "upload", NULL, window);
+		glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+		if (context == NULL)
+			return false;
+
+		stopping = false;
+		thread = std::thread(&UploadThread::run, this);
+		return true;
+	}
+
+	// main thread, with the window's context current: runs the queued uploads, stops the thread and
+	// destroys its context. Completions that were not polled yet run here, after waiting for their
+	// fences, so every object the uploads created reaches its owner and can be deleted
+	void Destroy()
+	{
+		if (context == NULL)
+			return;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		thread.join();
+
+		for (Batch& batch : finished)
+		{
+			glClientWaitSync(batch.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+			glDeleteSync(batch.fence);
+			for (Task& complete : batch.completions)
+			{
+				if (complete)
+					complete();
+			}
+		}
+		finished.clear();
+		pending = 0;
+		glfwDestroyWindow(context);
+		context = NULL;
+	}
+
+	// any thread: runs upload on the upload thread, then complete on the thread that calls Poll()
+	// once the GPU has executed the upload's commands
+	void Submit(Task upload, Task complete)
+	{
+		pending.fetch_add(1, std::memory_order_relaxed);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			queue.push_back({ std::move(upload), std::move(complete) });
+		}
+		wake.notify_one();
+	}
+
+	// render thread: runs the completions of the uploads the GPU has finished, in submission order.
+	// Returns the number of uploads still queued or in flight
+	int Poll()
+	{
+		while (true)
+		{
+			Batch batch;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (finished.empty())
+					break;
+				// a zero timeout only queries the fence
+				if (glClientWaitSync(finished.front().fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+					break;
+				batch = std::move(finished.front());
+				finished.pop_front();
+			}
+
+			glDeleteSync(batch.fence);
+			for (Task& complete : batch.completions)
+			{
+				if (complete)
+					complete();
+			}
+			pending.fetch_sub((int)batch.completions.size(), std::memory_order_relaxed);
+		}
+		return pending.load(std::memory_order_relaxed);
+	}
+
+private:
+	struct Upload
+	{
+		Task upload;
+		Task complete;
+	};
+
+	// uploads run back to back share one fence
+	struct Batch
+	{
+		GLsync fence;
+		std::vector<Task> completions;
+	};
+
+	GLFWwindow* context = NULL;
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::deque<Upload> queue;
+	std::deque<Batch> finished;
+	std::atomic<int> pending{ 0 };
+	bool stopping = false;
+
+	void run()
+	{
+		glfwMakeContextCurrent(context);
+		while (true)
+		{
+			std::deque<Upload> uploads;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [this]() { return stopping || !queue.empty(); });
+				if (queue.empty())
+					break;
+				uploads.swap(queue);
+			}
+
+			Batch batch;
+			for (Upload& upload : uploads)
+			{
+				upload.upload();
+				batch.completions.push_back(std::move(upload.complete));
+			}
+			// the flush sends the fence to the GPU, otherwise the render thread could poll it forever
+			batch.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			glFlush();
+
+			std::lock_guard<std::mutex> lock(mutex);
+			finished.push_back(std::move(batch));
+		}
+		glfwMakeContextCurrent(NULL);
+	}
+};
+#endif
@@ -0,0 +1,468 @@
+#ifndef VFS_H
+#define VFS_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <unordered_map>
+#include <cstring>
+#include <cstdint>
+
+#include "mappedFile.h"
+
+// Reusable byte buffers for decompressed files. Released buffers are handed out again to any
+// request that fits, so loading many files does not allocate once per file
+class BufferPool
+{
+public:
+	std::vector<unsigned char>* Acquire(size_t size)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		size_t best = free.size();
+		for (size_t i = 0; i < free.size(); ++i)
+		{
+			if (free[i]->capacity() >= size && (best == free.size() || free[i]->capacity() < free[best]->capacity()))
+				best = i;
+		}
+
+		std::vector<unsigned char>* buffer;
+		if (best < free.size())
+		{
+			buffer = free[best];
+			free.erase(free.begin() + best);
+		}
+		else
+		{
+			buffers.push_back(std::unique_ptr<std::vector<unsigned char>>(new std::vector<unsigned char>()));
+			buffer = buffers.back().get();
+		}
+		buffer->resize(size);
+		return buffer;
+	}
+
+	void Release(std::vector<unsigned char>* buffer)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		free.push_back(buffer);
+	}
+
+private:
+	std::mutex mutex;
+	std::vector<std::unique_ptr<std::vector<unsigned char>>> buffers;
+	std::vector<std::vector<unsigned char>*> free;
+};
+
+
+// Contents of a file read through the VirtualFileSystem: a view into a mapped archive or loose file,
+// or a pooled buffer holding a decompressed entry. Valid while the FileData and the mounts live
+class FileData
+{
+public:
+	FileData() = default;
+	FileData(const FileData&) = delete;
+	FileData& operator=(const FileData&) = delete;
+
+	FileData(FileData&& other)
+	{
+		*this = std::move(other);
+	}
+
+	FileData& operator=(FileData&& other)
+	{
+		if (this != &other)
+		{
+			Reset();
+			data = other.data;
+			size = other.size;
+			buffer = other.buffer;
+			pool = other.pool;
+			mapping = std::move(other.mapping);
+			other.data = nullptr;
+			other.size = 0;
+			other.buffer = nullptr;
+			other.pool = nullptr;
+		}
+		return *this;
+	}
+
+	~FileData()
+	{
+		Reset();
+	}
+
+	void Reset()
+	{
+		if (buffer != nullptr)
+			pool->Release(buffer);
+		mapping.reset();
+		data = nullptr;
+		size = 0;
+		buffer = nullptr;
+		pool = nullptr;
+	}
+
+	const unsigned char* Data() const
+	{
+		return data;
+	}
+
+	size_t Size() const
+	{
+		return size;
+	}
+
+	bool IsValid() const
+	{
+		return data != nullptr;
+	}
+
+private:
+	friend class VirtualFileSystem;
+
+	const unsigned char* data = nullptr;
+	size_t size = 0;
+	std::vector<unsigned char>* buffer = nullptr;	// owned by pool
+	BufferPool* pool = nullptr;
+	std::unique_ptr<MappedFile> mapping;			// loose files
+};
+
+
+// Read-only file system over mounted zip archives and directories. Later mounts take precedence, so a
+// patch archive or a development directory can shadow a shipped pack.
+//
+// A zip's central directory is indexed once at mount time and the archive stays memory-mapped:
+// stored entries are served in place without a copy (unless their data is misaligned for typed
+// access), deflated entries are inflated into buffers from a pool. ReadAll() inflates a batch of
+// files in parallel. ZIP64 and encrypted archives are not supported.
+//
+// Paths are case-sensitive, use '/' and are relative to the mount; '\' and repeated separators are
+// accepted, so the paths in scene files resolve the same on every platform. Paths no mount provides
+// are opened as given, which keeps absolute paths and files next to the executable working.
+class VirtualFileSystem
+{
+public:
+	// raw deflate decoder: returns the decompressed size, or -1 on error (stbi_zlib_decode_noheader_buffer)
+	typedef int (*InflateFunction)(char* output, int outputSize, const char* input, int inputSize);
+	typedef std::function<void(int count, const std::function<void(int)>& body)> ParallelFor;
+
+	explicit VirtualFileSystem(InflateFunction inflate)
+		: inflate(inflate)
+	{
+	}
+
+	VirtualFileSystem(const VirtualFileSystem&) = delete;
+	VirtualFileSystem& operator=(const VirtualFileSystem&) = delete;
+
+	// mounts a zip archive (also the packs written by AssetPacker) or a directory. Fails with error set
+	bool Mount(const std::string& path, std::string& error)
+	{
+		std::unique_ptr<MountPoint> mount(new MountPoint());
+		mount->path = Normalize(path);
+
+		if (mount->file.Open(path.c_str()))
+		{
+			if (!indexZip(*mount, error))
+				return false;
+			// Ask the OS to read the whole archive ahead in one sequential sweep
+			mount->file.Prefetch();
+		}
+		else if (!isDirectory(path))
+		{
+			error = "NOT_FOUND";
+			return false;
+		}
+		else
+			mount->isDirectory = true;
+
+		mounts.push_back(std::move(mount));
+		return true;
+	}
+
+	// reads one file, inflating on this thread if it is compressed
+	bool Read(const std::string& path, FileData& file)
+	{
+		std::vector<std::string> paths(1, path);
+		std::vector<FileData> files;
+		ReadAll(paths, files);
+		file = std::move(files[0]);
+		return file.IsValid();
+	}
+
+	// reads a batch of files; the compressed ones are inflated through parallelFor. files[i] is
+	// invalid when paths[i] was not found or could not be decompressed
+	void ReadAll(const std::vector<std::string>& paths, std::vector<FileData>& files, const ParallelFor& parallelFor = SerialFor)
+	{
+		files.clear();
+		files.resize(paths.size());
+
+		std::vector<int> compressed;
+		std::vector<const Entry*> entries(paths.size(), nullptr);
+		for (size_t i = 0; i < paths.size(); ++i)
+		{
+			std::string name = Normalize(paths[i]);
+			const MountPoint* mount = nullptr;
+			const Entry* entry = find(name, mount);
+			if (entry == nullptr)
+			{
+				openLoose(mount != nullptr ? mount->path + "/" + name : name, files[i]);
+				continue;
+			}
+
+			const unsigned char* data = static_cast<const unsigned char*>(entry->archive->Data()) + entry->dataOffset;
+			if (entry->method == METHOD_STORED && entry->dataOffset % STORED_ALIGNMENT == 0)
+			{
+				files[i].data = data;
+				files[i].size = entry->size;
+			}
+			else if (entry->method == METHOD_STORED)
+			{
+				// Misaligned stored data would be read through typed pointers; copy it into an aligned buffer
+				files[i].buffer = pool.Acquire(entry->size);
+				files[i].pool = &pool;
+				memcpy(files[i].buffer->data(), data, entry->size);
+				files[i].data = files[i].buffer->data();
+				files[i].size = entry->size;
+			}
+			else
+			{
+				entries[i] = entry;
+				files[i].buffer = pool.Acquire(entry->size);
+				files[i].pool = &pool;
+				compressed.push_back((int)i);
+			}
+		}
+
+		parallelFor((int)compressed.size(), [&](int job)
+		{
+			int i = compressed[job];
+			const Entry& entry = *entries[i];
+			const char* input = reinterpret_cast<const char*>(entry.archive->Data()) + entry.dataOffset;
+			int inflated = inflate(reinterpret_cast<char*>(files[i].buffer->data()), (int)entry.size, input, (int)entry.compressedSize);
+			if (inflated == (int)entry.size)
+			{
+				files[i].data = files[i].buffer->data();
+				files[i].size = entry.size;
+			}
+		});
+
+		for (int i : compressed)
+		{
+			if (files[i].data == nullptr)
+				files[i].Reset();
+		}
+	}
+
+	// '/' separators, no "./" prefix and no repeated separators
+	static std::string Normalize(const std::string& path)
+	{
+		std::string result;
+		result.reserve(path.size());
+		for (size_t i = 0; i < path.size(); ++i)
+		{
+			char c = path[i] == '\\' ? '/' : path[i];
+			if (c == '/' && !result.empty() && result.back() == '/')
+				continue;
+			if (c == '.' && result.empty() && i + 1 < path.size() && (path[i + 1] == '/' || path[i + 1] == '\\'))
+			{
+				++i;
+				continue;
+			}
+			result += c;
+		}
+		return result;
+	}
+
+	static void SerialFor(int count, const std::function<void(int)>& body)
+	{
+		for (int i = 0; i < count; ++i)
+			body(i);
+	}
+
+private:
+	static const uint16_t METHOD_STORED = 0;
+	static const uint16_t METHOD_DEFLATED = 8;
+	static const size_t STORED_ALIGNMENT = 16;
+
+	struct Entry
+	{
+		const MappedFile* archive;
+		uint16_t method;
+		uint64_t dataOffset;		// from the start of the archive
+		uint32_t compressedSize;
+		uint32_t size;
+	};
+
+	struct MountPoint
+	{
+		std::string path;
+		bool isDirectory = false;
+		MappedFile file;
+		std::unordered_map<std::string, Entry> entries;
+	};
+
+	InflateFunction inflate;
+	std::vector<std::unique_ptr<MountPoint>> mounts;
+	BufferPool pool;
+
+	static uint16_t read16(const unsigned char* p)
+	{
+		return (uint16_t)(p[0] | (p[1] << 8));
+	}
+
+	static uint32_t read32(const unsigned char* p)
+	{
+		return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+	}
+
+	// the entry of the newest mount that has name; for a miss, mount is the newest directory mount
+	// that might hold it as a loose file
+	const Entry* find(const std::string& name, const MountPoint*& mount) const
+	{
+		mount = nullptr;
+		for (size_t i = mounts.size(); i-- > 0;)
+		{
+			if (mounts[i]->isDirectory)
+			{
+				if (looseFileExists(mounts[i]->path + "/" + name))
+				{
+					mount = mounts[i].get();
+					return nullptr;
+				}
+				continue;
+			}
+
+			std::unordered_map<std::string, Entry>::const_iterator found = mounts[i]->entries.find(name);
+			if (found != mounts[i]->entries.end())
+			{
+				mount = mounts[i].get();
+				return &found->second;
+			}
+		}
+		return nullptr;
+	}
+
+	// Reads the end-of-central-directory record and indexes every file entry. The local headers are
+	// only read to find where each entry's data starts, so afterwards no lookup touches the archive
+	bool indexZip(MountPoint& mount, std::string& error)
+	{
+		const unsigned char* base = static_cast<const unsigned char*>(mount.file.Data());
+		size_t size = mount.file.Size();
+		const size_t eocdSize = 22;
+		if (size < eocdSize)
+		{
+			error = "NOT_A_ZIP_ARCHIVE";
+			return false;
+		}
+
+		// The record ends the file, followed only by a comment of up to 64 KB
+		size_t eocd = size - eocdSize;
+		size_t searchEnd = size > eocdSize + 0xFFFF ? size - eocdSize - 0xFFFF : 0;
+		while (read32(base + eocd) != 0x06054b50)
+		{
+			if (eocd == searchEnd)
+			{
+				error = "NOT_A_ZIP_ARCHIVE";
+				return false;
+			}
+			--eocd;
+		}
+
+		uint16_t entryCount = read16(base + eocd + 10);
+		uint32_t directorySize = read32(base + eocd + 12);
+		uint32_t directoryOffset = read32(base + eocd + 16);
+		if (entryCount == 0xFFFF || directoryOffset == 0xFFFFFFFF)
+		{
+			error = "ZIP64_NOT_SUPPORTED";
+			return false;
+		}
+		if ((uint64_t)directoryOffset + directorySize > eocd)
+		{
+			error = "BAD_CENTRAL_DIRECTORY";
+			return false;
+		}
+
+		size_t offset = directoryOffset;
+		for (uint16_t i = 0; i < entryCount; ++i)
+		{
+			const size_t headerSize = 46;
+			if (offset + headerSize > eocd || read32(base + offset) != 0x02014b50)
+			{
+				error = "BAD_CENTRAL_DIRECTORY";
+				return false;
+			}
+			const unsigned char* header = base + offset;
+			uint16_t flags = read16(header + 8);
+			uint16_t method = read16(header + 10);
+			uint32_t compressedSize = read32(header + 20);
+			uint32_t uncompressedSize = read32(header + 24);
+			uint16_t nameLength = read16(header + 28);
+			uint16_t extraLength = read16(header + 30);
+			uint16_t commentLength = read16(header + 32);
+			uint32_t localOffset = read32(header + 42);
+			// the name, extra field and comment follow the header and have to end before the record too
+			size_t entrySize = headerSize + nameLength + extraLength + commentLength;
+			if (offset + entrySize > eocd)
+			{
+				error = "BAD_CENTRAL_DIRECTORY";
+				return false;
+			}
+			std::string name(reinterpret_cast<const char*>(header + headerSize), nameLength);
+			offset += entrySize;
+
+			// Directories and entries this reader cannot decode are left out; reading them fails as not found
+			if (name.empty() || name.back() == '/' || (flags & 1) != 0 || (method != METHOD_STORED && method != METHOD_DEFLATED))
+				continue;
+
+			const size_t localHeaderSize = 30;
+			if ((uint64_t)localOffset + localHeaderSize > size || read32(base + localOffset) != 0x04034b50)
+			{
+				error = "BAD_LOCAL_HEADER " + name;
+				return false;
+			}
+			uint64_t dataOffset = (uint64_t)localOffset + localHeaderSize + read16(base + localOffset + 26) + read16(base + localOffset + 28);
+			if (dataOffset + compressedSize > size || (method == METHOD_STORED && compressedSize != uncompressedSize))
+			{
+				error = "BAD_LOCAL_HEADER " + name;
+				return false;
+			}
+
+			mount.entries[Normalize(name)] = { &mount.file, method, dataOffset, compressedSize, uncompressedSize };
+		}
+		return true;
+	}
+
+	static bool isDirectory(const std::string& path)
+	{
+#ifdef _WIN32
+		DWORD attributes = GetFileAttributesA(path.c_str());
+		return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+#else
+		struct stat info;
+		return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+#endif
+	}
+
+	static bool looseFileExists(const std::string& path)
+	{
+#ifdef _WIN32
+		DWORD attributes = GetFileAttributesA(path.c_str());
+		return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY) == 0;
+#else
+		struct stat info;
+		return stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode);
+#endif
+	}
+
+	static void openLoose(const std::string& path, FileData& file)
+	{
+		std::unique_ptr<MappedFile> mapping(new MappedFile());
+		if (!mapping->Open(path.c_str()))
+			return;
+		file.data = static_cast<const unsigned char*>(mapping->Data());
+		file.size = mapping->Size();
+		file.mapping = std::move(mapping);
+	}
+};
+#endif
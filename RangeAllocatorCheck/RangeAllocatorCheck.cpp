@@ -0,0 +1,387 @@
+/* RangeAllocator check
+ *
+ * Exercises the RangeAllocator behind OpenGLSample's GeometryPool without a GPU. Meshes are allocated
+ * and freed at random in a vertex buffer (32-byte vertices, with a 12-byte position stream beside it)
+ * and an index buffer, as GeometryPool::Allocate() and Free() do, and after every call the allocator
+ * is compared with a byte-level model of the buffers: used bytes, free ranges (which must stay merged),
+ * the largest free range, alignment, and the best-fit choice of Allocate().
+ *
+ * Every few rounds the buffers are compacted. The move lists are replayed onto byte copies of the
+ * buffers the way GeometryPool::compactBuffer() copies them, the meshes are remapped with the loop of
+ * UCompactGeometry(), and every live mesh must then find its own bytes at its new base vertex and first
+ * index, and be freeable there.
+ *
+ * Usage: RangeAllocatorCheck [rounds] [seed]
+ */
+#include <iostream>         // cout
+#include <cstdlib>          // atoi, EXIT_FAILURE
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../OpenGLSample/rangeAllocator.h"
+
+using namespace std;
+
+namespace
+{
+    const size_t VERTEX_STRIDE = 32;        // position, normal and UV, as LAYOUT_POSITION_NORMAL_UV
+    const size_t POSITION_STRIDE = 12;      // GeometryPool::POSITION_STRIDE
+    const size_t INDEX_SIZE = 4;
+    const size_t VERTEX_CAPACITY = 1024 * VERTEX_STRIDE;
+    const size_t INDEX_CAPACITY = 4096 * INDEX_SIZE;
+    const int COMPACT_INTERVAL = 64;        // rounds between compactions
+
+    // A RangeAllocator, the bytes it hands out and, per byte, the mesh that owns it (-1 = free)
+    struct Buffer
+    {
+        RangeAllocator allocator;
+        vector<unsigned char> bytes;
+        vector<int> owners;
+        size_t elementSize = 1;
+
+        void Initialize(size_t capacity, size_t elementSize)
+        {
+            allocator.Initialize(capacity);
+            bytes.assign(capacity, 0);
+            owners.assign(capacity, -1);
+            this->elementSize = elementSize;
+        }
+    };
+
+    // A GeometryPool::Move: a range that changed place, in elements
+    struct ElementMove
+    {
+        bool indices;
+        size_t from;
+        size_t to;
+    };
+
+    struct Mesh
+    {
+        size_t baseVertex;
+        size_t vertexCount;
+        size_t firstIndex;
+        size_t indexCount;          // 0 for an unindexed mesh
+        bool live;
+    };
+
+    int gFailures = 0;
+
+    void UFail(const string& message)
+    {
+        if (gFailures < 20)
+            cout << "FAIL: " << message << endl;
+        ++gFailures;
+    }
+
+    size_t UAlign(size_t offset, size_t alignment)
+    {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+    // the byte a mesh writes at position i of a range, different for every mesh and stream
+    unsigned char UPattern(int mesh, int stream, size_t i)
+    {
+        return (unsigned char)(mesh * 131 + stream * 17 + i * 7 + 1);
+    }
+
+    // the runs of free bytes in the model, as (offset, size)
+    vector<pair<size_t, size_t>> UFreeRuns(const Buffer& buffer)
+    {
+        vector<pair<size_t, size_t>> runs;
+        for (size_t i = 0; i < buffer.owners.size(); ++i)
+        {
+            if (buffer.owners[i] != -1)
+                continue;
+            if (!runs.empty() && runs.back().first + runs.back().second == i)
+                ++runs.back().second;
+            else
+                runs.push_back({ i, 1 });
+        }
+        return runs;
+    }
+
+    // where Allocate() has to put size bytes: the free run with the smallest remainder, the first one
+    // in address order on ties. False when no run fits
+    bool UBestFit(const Buffer& buffer, size_t size, size_t alignment, size_t& offset)
+    {
+        bool found = false;
+        size_t bestRemainder = 0;
+        for (const pair<size_t, size_t>& run : UFreeRuns(buffer))
+        {
+            size_t start = UAlign(run.first, alignment);
+            if (start - run.first + size > run.second)
+                continue;
+            size_t remainder = run.second - (start - run.first) - size;
+            if (!found || remainder < bestRemainder)
+            {
+                found = true;
+                bestRemainder = remainder;
+                offset = start;
+            }
+        }
+        return found;
+    }
+
+    // the allocator's bookkeeping against the model
+    void UCheckState(const Buffer& buffer, const char* name)
+    {
+        size_t used = 0;
+        for (int owner : buffer.owners)
+            used += owner != -1 ? 1 : 0;
+        vector<pair<size_t, size_t>> runs = UFreeRuns(buffer);
+        size_t largest = 0;
+        for (const pair<size_t, size_t>& run : runs)
+            largest = run.second > largest ? run.second : largest;
+
+        const RangeAllocator& allocator = buffer.allocator;
+        if (allocator.UsedBytes() != used)
+            UFail(string(name) + ": " + to_string(allocator.UsedBytes()) + " bytes used, expected " + to_string(used));
+        if (allocator.FreeRangeCount() != (int)runs.size())
+            UFail(string(name) + ": " + to_string(allocator.FreeRangeCount()) + " free ranges, expected " + to_string(runs.size()) + " (not merged?)");
+        if (allocator.LargestFree() != largest)
+            UFail(string(name) + ": largest free range " + to_string(allocator.LargestFree()) + ", expected " + to_string(largest));
+    }
+
+    // takes a range in the allocator and the model, checking it against the best fit
+    bool UAllocate(Buffer& buffer, const char* name, int mesh, size_t size, size_t alignment, size_t& offset)
+    {
+        size_t expected = 0;
+        bool fits = UBestFit(buffer, size, alignment, expected);
+        bool allocated = buffer.allocator.Allocate(size, alignment, offset);
+        if (allocated != fits)
+        {
+            UFail(string(name) + ": Allocate(" + to_string(size) + ") returned " + (allocated ? "true" : "false"));
+            return false;
+        }
+        if (!allocated)
+            return false;
+        if (offset != expected)
+            UFail(string(name) + ": Allocate(" + to_string(size) + ") at " + to_string(offset) + ", best fit is " + to_string(expected));
+        if (offset % alignment != 0)
+            UFail(string(name) + ": offset " + to_string(offset) + " not aligned to " + to_string(alignment));
+
+        for (size_t i = 0; i < size; ++i)
+        {
+            if (buffer.owners[offset + i] != -1)
+            {
+                UFail(string(name) + ": range at " + to_string(offset) + " overlaps a live one");
+                break;
+            }
+            buffer.owners[offset + i] = mesh;
+        }
+        return true;
+    }
+
+    void UFree(Buffer& buffer, size_t offset, size_t size)
+    {
+        int before = buffer.allocator.AllocationCount();
+        buffer.allocator.Free(offset);
+        if (buffer.allocator.AllocationCount() != before - 1)
+            UFail("Free(" + to_string(offset) + ") did not find the range");
+        for (size_t i = 0; i < size; ++i)
+            buffer.owners[offset + i] = -1;
+    }
+
+    // GeometryPool::compactBuffer() on bytes: the packed ranges, in elements of elementSize bytes that
+    // take copySize bytes in the buffer being copied
+    vector<unsigned char> UCopyPacked(const vector<unsigned char>& bytes, const vector<RangeAllocator::Move>& ranges, size_t copySize, size_t elementSize)
+    {
+        vector<unsigned char> packed(bytes.size(), 0);
+        for (const RangeAllocator::Move& range : ranges)
+        {
+            size_t from = range.from / elementSize * copySize;
+            size_t to = range.to / elementSize * copySize;
+            size_t size = range.size / elementSize * copySize;
+            for (size_t i = 0; i < size; ++i)
+                packed[to + i] = bytes[from + i];
+        }
+        return packed;
+    }
+
+    // compacts a buffer, checks the move list and returns the moves in elements, as GeometryPool does
+    void UCompact(Buffer& buffer, const char* name, bool indices, vector<unsigned char>* positions, vector<ElementMove>& moves)
+    {
+        int allocations = buffer.allocator.AllocationCount();
+        size_t used = buffer.allocator.UsedBytes();
+        vector<RangeAllocator::Move> ranges;
+        buffer.allocator.Compact(ranges);
+
+        // every live range, in address order, packed to the front and keeping its alignment
+        if ((int)ranges.size() != allocations)
+            UFail(string(name) + ": " + to_string(ranges.size()) + " ranges after Compact(), expected " + to_string(allocations));
+        size_t head = 0;
+        for (size_t i = 0; i < ranges.size(); ++i)
+        {
+            const RangeAllocator::Move& range = ranges[i];
+            if (i > 0 && range.from <= ranges[i - 1].from)
+                UFail(string(name) + ": moves not in address order");
+            if (range.to != UAlign(head, buffer.elementSize) || range.to > range.from)
+                UFail(string(name) + ": range " + to_string(range.from) + " moved to " + to_string(range.to) + ", expected " + to_string(UAlign(head, buffer.elementSize)));
+            head = range.to + range.size;
+        }
+        if (buffer.allocator.UsedBytes() != used || buffer.allocator.LargestFree() < buffer.allocator.Capacity() - head)
+            UFail(string(name) + ": free space not in one piece after Compact()");
+
+        buffer.bytes = UCopyPacked(buffer.bytes, ranges, 1, 1);
+        if (positions != nullptr)
+            *positions = UCopyPacked(*positions, ranges, POSITION_STRIDE, buffer.elementSize);
+
+        vector<int> owners(buffer.owners.size(), -1);
+        for (const RangeAllocator::Move& range : ranges)
+        {
+            for (size_t i = 0; i < range.size; ++i)
+                owners[range.to + i] = buffer.owners[range.from + i];
+            if (range.from != range.to)
+                moves.push_back({ indices, range.from / buffer.elementSize, range.to / buffer.elementSize });
+        }
+        buffer.owners.swap(owners);
+        UCheckState(buffer, name);
+    }
+
+    // every live mesh finds its own bytes in all three streams
+    void UCheckContents(const vector<Mesh>& meshes, const Buffer& vertices, const vector<unsigned char>& positions, const Buffer& indices)
+    {
+        for (size_t m = 0; m < meshes.size(); ++m)
+        {
+            const Mesh& mesh = meshes[m];
+            if (!mesh.live)
+                continue;
+            bool intact = true;
+            for (size_t i = 0; i < mesh.vertexCount * VERTEX_STRIDE; ++i)
+                intact = intact && vertices.bytes[mesh.baseVertex * VERTEX_STRIDE + i] == UPattern((int)m, 0, i);
+            for (size_t i = 0; i < mesh.vertexCount * POSITION_STRIDE; ++i)
+                intact = intact && positions[mesh.baseVertex * POSITION_STRIDE + i] == UPattern((int)m, 1, i);
+            for (size_t i = 0; i < mesh.indexCount * INDEX_SIZE; ++i)
+                intact = intact && indices.bytes[mesh.firstIndex * INDEX_SIZE + i] == UPattern((int)m, 2, i);
+            if (!intact)
+                UFail("mesh " + to_string(m) + " lost its data (base vertex " + to_string(mesh.baseVertex) + ", first index " + to_string(mesh.firstIndex) + ")");
+        }
+    }
+}
+
+
+int main(int argc, char* argv[])
+{
+    int rounds = argc > 1 ? atoi(argv[1]) : 20000;
+    unsigned int seed = argc > 2 ? (unsigned int)atoi(argv[2]) : 330u;
+    mt19937 random(seed);
+
+    Buffer vertices;
+    Buffer indices;
+    vertices.Initialize(VERTEX_CAPACITY, VERTEX_STRIDE);
+    indices.Initialize(INDEX_CAPACITY, INDEX_SIZE);
+    vector<unsigned char> positions(VERTEX_CAPACITY / VERTEX_STRIDE * POSITION_STRIDE, 0);
+    vector<Mesh> meshes;
+    vector<size_t> live;
+
+    int allocations = 0;
+    int failedAllocations = 0;
+    int frees = 0;
+    int compactions = 0;
+    size_t moved = 0;
+    for (int round = 1; round <= rounds; ++round)
+    {
+        // mostly allocations while the buffers are empty, mostly frees once they fill up
+        bool allocate = live.empty() || random() % 100 < (vertices.allocator.UsedBytes() * 2 < VERTEX_CAPACITY ? 70u : 40u);
+        if (allocate)
+        {
+            Mesh mesh = { 0, 1 + random() % 96, 0, random() % 4 == 0 ? 0 : 3 + random() % 300, true };
+            int id = (int)meshes.size();
+            size_t vertexOffset = 0;
+            size_t indexOffset = 0;
+            ++allocations;
+            // both ranges or neither, like GeometryPool::Allocate()
+            if (!UAllocate(vertices, "vertices", id, mesh.vertexCount * VERTEX_STRIDE, VERTEX_STRIDE, vertexOffset))
+            {
+                ++failedAllocations;
+                continue;
+            }
+            if (mesh.indexCount > 0 && !UAllocate(indices, "indices", id, mesh.indexCount * INDEX_SIZE, INDEX_SIZE, indexOffset))
+            {
+                UFree(vertices, vertexOffset, mesh.vertexCount * VERTEX_STRIDE);
+                ++failedAllocations;
+                continue;
+            }
+            mesh.baseVertex = vertexOffset / VERTEX_STRIDE;
+            mesh.firstIndex = indexOffset / INDEX_SIZE;
+
+            // the upload: interleaved vertices, their positions and the indices
+            for (size_t i = 0; i < mesh.vertexCount * VERTEX_STRIDE; ++i)
+                vertices.bytes[vertexOffset + i] = UPattern(id, 0, i);
+            for (size_t i = 0; i < mesh.vertexCount * POSITION_STRIDE; ++i)
+                positions[mesh.baseVertex * POSITION_STRIDE + i] = UPattern(id, 1, i);
+            for (size_t i = 0; i < mesh.indexCount * INDEX_SIZE; ++i)
+                indices.bytes[indexOffset + i] = UPattern(id, 2, i);
+            meshes.push_back(mesh);
+            live.push_back(id);
+        }
+        else
+        {
+            size_t slot = random() % live.size();
+            Mesh& mesh = meshes[live[slot]];
+            UFree(vertices, mesh.baseVertex * VERTEX_STRIDE, mesh.vertexCount * VERTEX_STRIDE);
+            if (mesh.indexCount > 0)
+                UFree(indices, mesh.firstIndex * INDEX_SIZE, mesh.indexCount * INDEX_SIZE);
+            mesh.live = false;
+            live[slot] = live.back();
+            live.pop_back();
+            ++frees;
+        }
+        UCheckState(vertices, "vertices");
+        UCheckState(indices, "indices");
+
+        if (round % COMPACT_INTERVAL == 0)
+        {
+            vector<ElementMove> moves;
+            UCompact(vertices, "vertices", false, &positions, moves);
+            UCompact(indices, "indices", true, nullptr, moves);
+
+            // the remapping loop of UCompactGeometry()
+            for (const ElementMove& move : moves)
+            {
+                for (Mesh& mesh : meshes)
+                {
+                    if (!mesh.live)
+                        continue;
+                    if (move.indices && mesh.indexCount > 0 && mesh.firstIndex == move.from)
+                        mesh.firstIndex = move.to;
+                    else if (!move.indices && mesh.baseVertex == move.from)
+                        mesh.baseVertex = move.to;
+                }
+            }
+            UCheckContents(meshes, vertices, positions, indices);
+            ++compactions;
+            moved += moves.size();
+        }
+        if (gFailures > 0)
+        {
+            cout << "Stopped at round " << round << endl;
+            break;
+        }
+    }
+
+    // the meshes are freed at the offsets the compactions gave them
+    for (size_t id : live)
+    {
+        const Mesh& mesh = meshes[id];
+        UFree(vertices, mesh.baseVertex * VERTEX_STRIDE, mesh.vertexCount * VERTEX_STRIDE);
+        if (mesh.indexCount > 0)
+            UFree(indices, mesh.firstIndex * INDEX_SIZE, mesh.indexCount * INDEX_SIZE);
+    }
+    UCheckState(vertices, "vertices");
+    UCheckState(indices, "indices");
+    if (vertices.allocator.FreeRangeCount() != 1 || indices.allocator.FreeRangeCount() != 1)
+        UFail("free space not back in one piece after freeing every mesh");
+
+    cout << rounds << " rounds, seed " << seed << ": " << allocations << " allocations (" << failedAllocations << " out of space), "
+        << frees << " frees, " << compactions << " compactions moving " << moved << " ranges" << endl;
+    if (gFailures > 0)
+    {
+        cout << gFailures << " check(s) failed" << endl;
+        return EXIT_FAILURE;
+    }
+    cout << "All checks passed" << endl;
+    return 0;
+}
@@ -0,0 +1,969 @@
+/* Scene converter
+ *
+ * Build step for OpenGLSample: compiles a human-editable JSON scene description into the binary
+ * scene format of sceneFormat.h, which the program memory-maps and uploads without parsing.
+ *
+ * Usage: SceneConverter <scene.json> <output.scene>
+ *
+ * The JSON has four sections, each referring to the earlier ones by name:
+ *   "textures"   name: image path
+ *   "materials"  name: { textured, specular, color, ambientStrength, specularIntensity, highlightSize }
+ *   "meshes"     name: { type: cube | pyramid | plane | cylinder | circle, plus the shape's parameters }
+ *   "nodes"      [ { name, parent, position, rotation (Euler degrees), scale, mesh, material, texture,
+ *                    uvScale, light (color) } ], every parent listed before its children. They are
+ *                    written depth-first, each subtree after its root, so the program appends the
+ *                    whole scene graph in one pass; siblings and roots keep their listed order
+ * scale and uvScale take a single number for a uniform value.
+ *
+ * Meshes are generated here, so the program no longer carries the shape code. Identical vertices
+ * are welded and every mesh is written indexed, with its bounding sphere.
+ */
+#include <iostream>         // cout, cerr
+#include <cstdlib>          // EXIT_FAILURE, strtod
+#include <cstring>          // memcpy
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>        // min, max
+#include <filesystem>
+
+#include "../OpenGLSample/sceneFormat.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+using namespace SceneFormat;
+
+#define PI 3.14159265359
+
+namespace
+{
+    // A parsed JSON value. Object members keep their order, so the tables are written in file order
+    struct JsonValue
+    {
+        enum Type { NUL, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT };
+
+        Type type = NUL;
+        bool boolean = false;
+        double number = 0.0;
+        string text;
+        vector<JsonValue> items;
+        vector<pair<string, JsonValue>> members;
+        int line = 0;
+
+        const JsonValue* Find(const string& key) const
+        {
+            for (const pair<string, JsonValue>& member : members)
+            {
+                if (member.first == key)
+                    return &member.second;
+            }
+            return nullptr;
+        }
+    };
+
+    struct Vec3
+    {
+        float x;
+        float y;
+        float z;
+    };
+
+    // The scene as it is written, one vector per chunk
+    struct SceneTables
+    {
+        string strings;
+        map<string, uint32_t> stringOffsets;
+        vector<TextureRecord> textures;
+        vector<MaterialRecord> materials;
+        vector<MeshRecord> meshes;
+        vector<NodeRecord> nodes;
+        vector<float> vertices;
+        vector<uint32_t> indices;
+
+        map<string, int> textureIndex;
+        map<string, int> materialIndex;
+        map<string, int> meshIndex;
+        map<string, int> nodeIndex;
+    };
+
+    fs::path gInputPath;
+    int gErrorCount = 0;
+}
+
+void UError(int line, const string& message);
+bool UReadFile(const fs::path& path, string& contents);
+bool UParseJson(const string& text, JsonValue& root);
+bool UParseValue(const string& text, size_t& pos, int& line, JsonValue& value);
+void USkipWhitespace(const string& text, size_t& pos, int& line);
+bool UParseString(const string& text, size_t& pos, int& line, string& result);
+float UNumber(const JsonValue& object, const char* key, float fallback);
+void UFloats(const JsonValue& object, const char* key, float* values, int count, float fallback);
+int ULookup(const JsonValue& object, const char* key, const map<string, int>& index, const char* kind);
+uint32_t UIntern(SceneTables& tables, const string& text);
+void UConvertTextures(const JsonValue& section, SceneTables& tables);
+void UConvertMaterials(const JsonValue& section, SceneTables& tables);
+void UConvertMeshes(const JsonValue& section, SceneTables& tables);
+void UConvertNodes(const JsonValue& section, SceneTables& tables);
+void UDepthFirstOrder(vector<NodeRecord>& nodes);
+void UCubeVertices(Vec3 top, float height, float width, vector<float>& vertices);
+void UPyramidVertices(Vec3 top, float height, float width, vector<float>& vertices);
+void UPlaneVertices(Vec3 bl, Vec3 br, Vec3 fl, Vec3 fr, vector<float>& vertices);
+void UCircleVertices(float radius, Vec3 center, vector<float>& vertices);
+void UCylinderVertices(float radius, float height, Vec3 center, vector<float>& vertices);
+void UAddMesh(SceneTables& tables, uint32_t layout, const vector<float>& vertices);
+void UAppendChunk(string& file, vector<ChunkEntry>& toc, uint32_t type, uint32_t count, const void* data, size_t size);
+bool UWriteScene(const fs::path& output, const SceneTables& tables);
+
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3)
+    {
+        cerr << "usage: " << argv[0] << " <scene.json> <output.scene>" << endl;
+        return EXIT_FAILURE;
+    }
+
+    gInputPath = argv[1];
+    fs::path output = argv[2];
+
+    string text;
+    if (!UReadFile(gInputPath, text))
+    {
+        cout << gInputPath.string() << "(1): error: cannot read the scene description" << endl;
+        return EXIT_FAILURE;
+    }
+
+    JsonValue root;
+    if (!UParseJson(text, root))
+        return EXIT_FAILURE;
+    if (root.type != JsonValue::OBJECT)
+    {
+        UError(root.line, "the scene must be a JSON object");
+        return EXIT_FAILURE;
+    }
+
+    SceneTables tables;
+    UIntern(tables, "");    // offset 0 is the empty string
+    const char* const sections[] = { "textures", "materials", "meshes", "nodes" };
+    for (const char* name : sections)
+    {
+        const JsonValue* section = root.Find(name);
+        if (section == nullptr)
+            continue;
+
+        string key = name;
+        if (key == "textures")
+            UConvertTextures(*section, tables);
+        else if (key == "materials")
+            UConvertMaterials(*section, tables);
+        else if (key == "meshes")
+            UConvertMeshes(*section, tables);
+        else
+            UConvertNodes(*section, tables);
+    }
+
+    if (gErrorCount > 0)
+    {
+        cout << "SceneConverter: " << gErrorCount << " error(s)" << endl;
+        return EXIT_FAILURE;
+    }
+
+    if (!UWriteScene(output, tables))
+        return EXIT_FAILURE;
+
+    cout << "SceneConverter: " << tables.nodes.size() << " node(s), " << tables.meshes.size() << " mesh(es), "
+        << tables.vertices.size() * sizeof(float) + tables.indices.size() * sizeof(uint32_t) << " bytes of geometry" << endl;
+    return 0;
+}
+
+
+// Errors use the "file(line): error:" form so Visual Studio lists them in the Error List
+void UError(int line, const string& message)
+{
+    cout << gInputPath.string() << "(" << line << "): error: " << message << endl;
+    ++gErrorCount;
+}
+
+
+bool UReadFile(const fs::path& path, string& contents)
+{
+    ifstream in(path, ios::binary);
+    if (!in)
+        return false;
+
+    stringstream stream;
+    stream << in.rdbuf();
+    contents = stream.str();
+    return true;
+}
+
+
+bool UParseJson(const string& text, JsonValue& root)
+{
+    size_t pos = 0;
+    int line = 1;
+    if (!UParseValue(text, pos, line, root))
+        return false;
+
+    USkipWhitespace(text, pos, line);
+    if (pos != text.size())
+    {
+        UError(line, "unexpected text after the scene object");
+        return false;
+    }
+    return true;
+}
+
+
+void USkipWhitespace(const string& text, size_t& pos, int& line)
+{
+    while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\r' || text[pos] == '\n'))
+    {
+        if (text[pos] == '\n')
+            ++line;
+        ++pos;
+    }
+}
+
+
+// Strings are kept as UTF-8; of the escapes only the ASCII \u0000-\u007F range is supported
+bool UParseString(const string& text, size_t& pos, int& line, string& result)
+{
+    ++pos;  // opening quote
+    while (pos < text.size() && text[pos] != '"')
+    {
+        char c = text[pos++];
+        if (c == '\n')
+        {
+            UError(line, "unterminated string");
+            return false;
+        }
+        if (c != '\\')
+        {
+            result += c;
+            continue;
+        }
+
+        if (pos >= text.size())
+            break;
+        char escape = text[pos++];
+        switch (escape)
+        {
+        case '"': result += '"'; break;
+        case '\\': result += '\\'; break;
+        case '/': result += '/'; break;
+        case 'b': result += '\b'; break;
+        case 'f': result += '\f'; break;
+        case 'n': result += '\n'; break;
+        case 'r': result += '\r'; break;
+        case 't': result += '\t'; break;
+        case 'u':
+        {
+            unsigned long code = pos + 4 <= text.size() ? strtoul(text.substr(pos, 4).c_str(), nullptr, 16) : 0x80;
+            if (code > 0x7F)
+            {
+                UError(line, "only ASCII \\u escapes are supported");
+                return false;
+            }
+            result += (char)code;
+            pos += 4;
+            break;
+        }
+        default:
+            UError(line, string("unknown escape \\") + escape);
+            return false;
+        }
+    }
+
+    if (pos >= text.size())
+    {
+        UError(line, "unterminated string");
+        return false;
+    }
+    ++pos;  // closing quote
+    return true;
+}
+
+
+bool UParseValue(const string& text, size_t& pos, int& line, JsonValue& value)
+{
+    USkipWhitespace(text, pos, line);
+    value.line = line;
+    if (pos >= text.size())
+    {
+        UError(line, "unexpected end of file");
+        return false;
+    }
+
+    char c = text[pos];
+    if (c == '{' || c == '[')
+    {
+        bool isObject = c == '{';
+        char close = isObject ? '}' : ']';
+        value.type = isObject ? JsonValue::OBJECT : JsonValue::ARRAY;
+        ++pos;
+
+        USkipWhitespace(text, pos, line);
+        if (pos < text.size() && text[pos] == close)
+        {
+            ++pos;
+            return true;
+        }
+
+        while (true)
+        {
+            JsonValue element;
+            if (isObject)
+            {
+                USkipWhitespace(text, pos, line);
+                string key;
+                if (pos >= text.size() || text[pos] != '"' || !UParseString(text, pos, line, key))
+                {
+                    UError(line, "expected a member name");
+                    return false;
+                }
+                USkipWhitespace(text, pos, line);
+                if (pos >= text.size() || text[pos] != ':')
+                {
+                    UError(line, "expected ':' after \"" + key + "\"");
+                    return false;
+                }
+                ++pos;
+                if (!UParseValue(text, pos, line, element))
+                    return false;
+                value.members.push_back(make_pair(key, element));
+            }
+            else
+            {
+                if (!UParseValue(text, pos, line, element))
+                    return false;
+                value.items.push_back(element);
+            }
+
+            USkipWhitespace(text, pos, line);
+            if (pos < text.size() && text[pos] == ',')
+            {
+                ++pos;
+                continue;
+            }
+            if (pos < text.size() && text[pos] == close)
+            {
+                ++pos;
+                return true;
+            }
+            UError(line, string("expected ',' or '") + close + "'");
+            return false;
+        }
+    }
+
+    if (c == '"')
+    {
+        value.type = JsonValue::STRING;
+        return UParseString(text, pos, line, value.text);
+    }
+
+    const char* const literals[] = { "true", "false", "null" };
+    for (const char* literal : literals)
+    {
+        size_t length = strlen(literal);
+        if (text.compare(pos, length, literal) == 0)
+        {
+            value.type = literal[0] == 'n' ? JsonValue::NUL : JsonValue::BOOLEAN;
+            value.boolean = literal[0] == 't';
+            pos += length;
+            return true;
+        }
+    }
+
+    char* end = nullptr;
+    value.number = strtod(text.c_str() + pos, &end);
+    if (end == text.c_str() + pos)
+    {
+        UError(line, string("unexpected character '") + c + "'");
+        return false;
+    }
+    value.type = JsonValue::NUMBER;
+    pos = end - text.c_str();
+    return true;
+}
+
+
+float UNumber(const JsonValue& object, const char* key, float fallback)
+{
+    const JsonValue* value = object.Find(key);
+    if (value == nullptr)
+        return fallback;
+    if (value->type != JsonValue::NUMBER)
+    {
+        UError(value->line, string("\"") + key + "\" must be a number");
+        return fallback;
+    }
+    return (float)value->number;
+}
+
+
+// Reads a fixed-size number array; a single number fills every element
+void UFloats(const JsonValue& object, const char* key, float* values, int count, float fallback)
+{
+    for (int i = 0; i < count; ++i)
+        values[i] = fallback;
+
+    const JsonValue* value = object.Find(key);
+    if (value == nullptr)
+        return;
+    if (value->type == JsonValue::NUMBER)
+    {
+        for (int i = 0; i < count; ++i)
+            values[i] = (float)value->number;
+        return;
+    }
+
+    if (value->type != JsonValue::ARRAY || (int)value->items.size() != count)
+    {
+        UError(value->line, string("\"") + key + "\" must be an array of " + to_string(count) + " numbers");
+        return;
+    }
+    for (int i = 0; i < count; ++i)
+    {
+        if (value->items[i].type != JsonValue::NUMBER)
+        {
+            UError(value->items[i].line, string("\"") + key + "\" must be an array of " + to_string(count) + " numbers");
+            return;
+        }
+        values[i] = (float)value->items[i].number;
+    }
+}
+
+
+// Index of the named entry of an earlier section, -1 when the key is absent or unknown
+int ULookup(const JsonValue& object, const char* key, const map<string, int>& index, const char* kind)
+{
+    const JsonValue* value = object.Find(key);
+    if (value == nullptr)
+        return -1;
+    if (value->type != JsonValue::STRING)
+    {
+        UError(value->line, string("\"") + key + "\" must be the name of a " + kind);
+        return -1;
+    }
+
+    map<string, int>::const_iterator found = index.find(value->text);
+    if (found == index.end())
+    {
+        UError(value->line, string("unknown ") + kind + " \"" + value->text + "\"");
+        return -1;
+    }
+    return found->second;
+}
+
+
+uint32_t UIntern(SceneTables& tables, const string& text)
+{
+    map<string, uint32_t>::const_iterator found = tables.stringOffsets.find(text);
+    if (found != tables.stringOffsets.end())
+        return found->second;
+
+    uint32_t offset = (uint32_t)tables.strings.size();
+    tables.strings += text;
+    tables.strings += '\0';
+    tables.stringOffsets[text] = offset;
+    return offset;
+}
+
+
+void UConvertTextures(const JsonValue& section, SceneTables& tables)
+{
+    if (section.type != JsonValue::OBJECT)
+    {
+        UError(section.line, "\"textures\" must be an object of name: path");
+        return;
+    }
+
+    for (const pair<string, JsonValue>& member : section.members)
+    {
+        if (member.second.type != JsonValue::STRING)
+        {
+            UError(member.second.line, "texture \"" + member.first + "\" must be a path");
+            continue;
+        }
+        tables.textureIndex[member.first] = (int)tables.textures.size();
+        tables.textures.push_back({ UIntern(tables, member.second.text) });
+    }
+}
+
+
+void UConvertMaterials(const JsonValue& section, SceneTables& tables)
+{
+    if (section.type != JsonValue::OBJECT)
+    {
+        UError(section.line, "\"materials\" must be an object of name: material");
+        return;
+    }
+
+    for (const pair<string, JsonValue>& member : section.members)
+    {
+        const JsonValue& json = member.second;
+        MaterialRecord material = {};
+        const JsonValue* textured = json.Find("textured");
+        const JsonValue* specular = json.Find("specular");
+        if (textured != nullptr && textured->boolean)
+            material.flags |= MATERIAL_TEXTURED;
+        if (specular != nullptr && specular->boolean)
+            material.flags |= MATERIAL_SPECULAR;
+        UFloats(json, "color", material.color, 3, 1.0f);
+        material.ambientStrength = UNumber(json, "ambientStrength", 0.3f);
+        material.specularIntensity = UNumber(json, "specularIntensity", 0.0f);
+        material.highlightSize = UNumber(json, "highlightSize", 1.0f);
+
+        tables.materialIndex[member.first] = (int)tables.materials.size();
+        tables.materials.push_back(material);
+    }
+}
+
+
+void UConvertMeshes(const JsonValue& section, SceneTables& tables)
+{
+    if (section.type != JsonValue::OBJECT)
+    {
+        UError(section.line, "\"meshes\" must be an object of name: mesh");
+        return;
+    }
+
+    for (const pair<string, JsonValue>& member : section.members)
+    {
+        const JsonValue& json = member.second;
+        const JsonValue* type = json.Find("type");
+        string shape = type != nullptr ? type->text : "";
+
+        vector<float> vertices;
+        uint32_t layout = LAYOUT_POSITION_NORMAL_UV;
+        float a[3], b[3], c[3], d[3];
+        if (shape == "cube" || shape == "pyramid")
+        {
+            UFloats(json, "top", a, 3, 0.0f);
+            float height = UNumber(json, "height", 1.0f);
+            float width = UNumber(json, "width", 1.0f);
+            if (shape == "cube")
+                UCubeVertices({ a[0], a[1], a[2] }, height, width, vertices);
+            else
+                UPyramidVertices({ a[0], a[1], a[2] }, height, width, vertices);
+        }
+        else if (shape == "plane")
+        {
+            UFloats(json, "backLeft", a, 3, 0.0f);
+            UFloats(json, "backRight", b, 3, 0.0f);
+            UFloats(json, "frontLeft", c, 3, 0.0f);
+            UFloats(json, "frontRight", d, 3, 0.0f);
+            UPlaneVertices({ a[0], a[1], a[2] }, { b[0], b[1], b[2] }, { c[0], c[1], c[2] }, { d[0], d[1], d[2] }, vertices);
+        }
+        else if (shape == "circle")
+        {
+            UFloats(json, "center", a, 3, 0.0f);
+            UCircleVertices(UNumber(json, "radius", 1.0f), { a[0], a[1], a[2] }, vertices);
+            layout = LAYOUT_POSITION;
+        }
+        else if (shape == "cylinder")
+        {
+            UFloats(json, "base", a, 3, 0.0f);
+            UCylinderVertices(UNumber(json, "radius", 1.0f), UNumber(json, "height", 1.0f), { a[0], a[1], a[2] }, vertices);
+            layout = LAYOUT_POSITION;
+        }
+        else
+        {
+            UError(json.line, "mesh \"" + member.first + "\" needs a type: cube, pyramid, plane, circle or cylinder");
+            continue;
+        }
+
+        tables.meshIndex[member.first] = (int)tables.meshes.size();
+        UAddMesh(tables, layout, vertices);
+    }
+}
+
+
+void UConvertNodes(const JsonValue& section, SceneTables& tables)
+{
+    if (section.type != JsonValue::ARRAY)
+    {
+        UError(section.line, "\"nodes\" must be an array");
+        return;
+    }
+
+    for (const JsonValue& json : section.items)
+    {
+        NodeRecord node = {};
+        const JsonValue* name = json.Find("name");
+        string nodeName = name != nullptr ? name->text : "";
+        node.name = UIntern(tables, nodeName);
+
+        node.parent = ULookup(json, "parent", tables.nodeIndex, "node (parents must come first)");
+        node.mesh = ULookup(json, "mesh", tables.meshIndex, "mesh");
+        node.material = ULookup(json, "material", tables.materialIndex, "material");
+        node.texture = ULookup(json, "texture", tables.textureIndex, "texture");
+        if (node.material >= 0 && node.mesh < 0)
+            UError(json.line, "node \"" + nodeName + "\" has a material but no mesh");
+
+        UFloats(json, "position", node.position, 3, 0.0f);
+        UFloats(json, "scale", node.scale, 3, 1.0f);
+        UFloats(json, "uvScale", node.uvScale, 2, 1.0f);
+
+        // Euler angles in degrees, composed the way glm::quat(eulerAngles) does
+        float euler[3];
+        UFloats(json, "rotation", euler, 3, 0.0f);
+        float cx = cos(euler[0] * (float)PI / 360.0f), sx = sin(euler[0] * (float)PI / 360.0f);
+        float cy = cos(euler[1] * (float)PI / 360.0f), sy = sin(euler[1] * (float)PI / 360.0f);
+        float cz = cos(euler[2] * (float)PI / 360.0f), sz = sin(euler[2] * (float)PI / 360.0f);
+        node.rotation[0] = sx * cy * cz - cx * sy * sz;
+        node.rotation[1] = cx * sy * cz + sx * cy * sz;
+        node.rotation[2] = cx * cy * sz - sx * sy * cz;
+        node.rotation[3] = cx * cy * cz + sx * sy * sz;
+
+        if (json.Find("light") != nullptr)
+        {
+            node.flags |= NODE_LIGHT;
+            UFloats(json, "light", node.lightColor, 3, 1.0f);
+        }
+
+        if (!nodeName.empty())
+            tables.nodeIndex[nodeName] = (int)tables.nodes.size();
+        tables.nodes.push_back(node);
+    }
+
+    UDepthFirstOrder(tables.nodes);
+}
+
+
+// Reorders nodes, parents listed before their children, so every subtree follows its root
+void UDepthFirstOrder(vector<NodeRecord>& nodes)
+{
+    // children in listed order, as the ranges of each parent in one array
+    vector<int> childStart(nodes.size() + 1, 0);
+    for (const NodeRecord& node : nodes)
+    {
+        if (node.parent >= 0)
+            ++childStart[node.parent + 1];
+    }
+    for (size_t i = 0; i < nodes.size(); ++i)
+        childStart[i + 1] += childStart[i];
+    vector<int> children(childStart.back());
+    vector<int> filled(childStart.begin(), childStart.end() - 1);
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+        if (nodes[i].parent >= 0)
+            children[filled[nodes[i].parent]++] = (int)i;
+    }
+
+    // pre-order walk from the roots; the stack holds the children still to visit in reverse
+    vector<int> order;
+    vector<int> newIndex(nodes.size());
+    vector<int> stack;
+    order.reserve(nodes.size());
+    for (size_t root = 0; root < nodes.size(); ++root)
+    {
+        if (nodes[root].parent >= 0)
+            continue;
+        stack.push_back((int)root);
+        while (!stack.empty())
+        {
+            int node = stack.back();
+            stack.pop_back();
+            newIndex[node] = (int)order.size();
+            order.push_back(node);
+            for (int c = childStart[node + 1] - 1; c >= childStart[node]; --c)
+                stack.push_back(children[c]);
+        }
+    }
+
+    vector<NodeRecord> sorted;
+    sorted.reserve(nodes.size());
+    for (int node : order)
+    {
+        NodeRecord record = nodes[node];
+        record.parent = record.parent >= 0 ? newIndex[record.parent] : -1;
+        sorted.push_back(record);
+    }
+    nodes.swap(sorted);
+}
+
+
+void UCubeVertices(Vec3 top, float height, float width, vector<float>& vertices)
+{
+    // Position and Texture data
+    const float verts[] = {
+        // ------------------------------------------------------
+        //Back Face                                          //Negative Z Normal  Texture Coords.
+       top.x - (width / 2), top.y - height, top.z - (width/2),  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
+        top.x + (width / 2), top.y - height, top.z - (width / 2),  0.0f,  0.0f, -1.0f,  1.0f, 0.0f,
+        top.x + (width / 2),  top.y, top.z - (width / 2),  0.0f,  0.0f, -1.0f,  0.5f, 1.0f,
+        top.x + (width / 2),  top.y, top.z - (width / 2),  0.0f,  0.0f, -1.0f,  0.5f, 1.0f,
+       top.x - (width / 2),  top.y, top.z - (width / 2),  0.0f,  0.0f, -1.0f,  0.0f, 1.0f,
+       top.x - (width / 2), top.y - height, top.z - (width / 2),  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
+
+       //Front Face                                              //Positive Z Normal
+      top.x - (width / 2), top.y - height,  top.z + (width / 2),  0.0f,  0.0f,  1.0f,  0.0f, 0.0f,
+       top.x + (width / 2), top.y - height,  top.z + (width / 2),  0.0f,  0.0f,  1.0f,  1.0f, 0.0f,
+       top.x + (width / 2),  top.y,  top.z + (width / 2),  0.0f,  0.0f,  1.0f,  0.5f, 1.0f,
+       top.x + (width / 2),  top.y,  top.z + (width / 2),  0.0f,  0.0f,  1.0f,  0.5f, 1.0f,
+      top.x - (width / 2),  top.y,  top.z + (width / 2),  0.0f,  0.0f,  1.0f,  0.0f, 1.0f,
+      top.x - (width / 2), top.y - height,  top.z + (width / 2),  0.0f,  0.0f,  1.0f,  0.0f, 0.0f,
+
+      //Left Face                                                //Negative X Normal
+     top.x - (width / 2),  top.y,  top.z + (width / 2), -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+     top.x - (width / 2),  top.y, top.z - (width / 2), -1.0f,  0.0f,  0.0f,  0.5f, 1.0f,
+     top.x - (width / 2), top.y - height, top.z - (width / 2), -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+     top.x - (width / 2), top.y - height, top.z - (width / 2), -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+     top.x - (width / 2), top.y - height,  top.z + (width / 2), -1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
+     top.x - (width / 2),  top.y,  top.z + (width / 2), -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+
+     //Right Face                                              //Positive X Normal
+     top.x + (width / 2),  top.y,  top.z + (width / 2),  1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+     top.x + (width / 2),  top.y, top.z - (width / 2),  1.0f,  0.0f,  0.0f,  0.5f, 1.0f,
+     top.x + (width / 2), top.y - height, top.z - (width / 2),  1.0f,  0.0f,  0.0f,  1.0f, 0.0f,  //Bottom Front?
+     top.x + (width / 2), top.y - height, top.z - (width / 2),  1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+     top.x + (width / 2), top.y - height,  top.z + (width / 2),  1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
+     top.x + (width / 2),  top.y,  top.z + (width / 2),  1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+
+     //Bottom Face                                             //Negative Y Normal
+    top.x - (width / 2), top.y - height, top.z - (width / 2),  0.0f, -1.0f,  0.0f,  0.0f, 1.0f,
+     top.x + (width / 2), top.y - height, top.z - (width / 2),  0.0f, -1.0f,  0.0f,  1.0f, 1.0f,
+     top.x + (width / 2), top.y - height,  top.z + (width / 2),  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
+     top.x + (width / 2), top.y - height,  top.z + (width / 2),  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
+    top.x - (width / 2), top.y - height,  top.z + (width / 2),  0.0f, -1.0f,  0.0f,  0.0f, 0.0f,
+    top.x - (width / 2), top.y - height, top.z - (width / 2),  0.0f, -1.0f,  0.0f,  0.0f, 1.0f,
+
+    //Top Face                                                 //Positive Y Normal
+   top.x - (width / 2),  top.y, top.z - (width / 2),  0.0f,  1.0f,  0.0f,  0.0f, 1.0f,
+    top.x + (width / 2),  top.y, top.z - (width / 2),  0.0f,  1.0f,  0.0f,  1.0f, 1.0f,
+    top.x + (width / 2),  top.y,  top.z + (width / 2),  0.0f,  1.0f,  0.0f,  1.0f, 0.0f,
+    top.x + (width / 2),  top.y,  top.z + (width / 2),  0.0f,  1.0f,  0.0f,  1.0f, 0.0f,
+   top.x - (width / 2),  top.y,  top.z + (width / 2),  0.0f,  1.0f,  0.0f,  0.0f, 0.0f,
+   top.x - (width / 2),  top.y, top.z - (width / 2),  0.0f,  1.0f,  0.0f,  0.0f, 1.0f
+    };
+
+    vertices.assign(verts, verts + sizeof(verts) / sizeof(verts[0]));
+}
+
+
+void UPyramidVertices(Vec3 top, float height, float width, vector<float>& vertices)
+{
+    // Position and Texture data
+    const float verts[] = {
+
+        //Back Face                                              //Negative Z Normal  Texture Coords.
+       top.x - (width / 2), top.y - height, top.z - (width / 2),  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
+        top.x + (width / 2), top.y - height, top .z - (width / 2),  0.0f,  0.0f, -1.0f,  1.0f, 0.0f,
+        top.x,  top.y, top.z,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
+
+       //Front Face                                             //Positive Z Normal
+      top.x - (width / 2), top.y - height,  top.z + (width / 2),  0.0f,  0.0f,  1.0f,  0.0f, 0.0f,
+       top.x + (width / 2), top.y - height,  top.z + (width / 2),  0.0f,  0.0f,  1.0f,  1.0f, 0.0f,
+       top.x,  top.y,  top.z,  0.0f,  0.0f,  1.0f,  1.0f, 1.0f,
+
+      //Left Face                          //Negative X Normal
+     top.x,  top.y,  top.z, -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+     top.x - (width / 2),  top.y - height, top.z + (width / 2), -1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
+     top.x - (width / 2), top.y - height, top.z - (width / 2), -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+     
+     //Right Face                                           //Positive X Normal
+     top.x + (width / 2), top.y - height, top.z - (width / 2),  1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+     top.x + (width / 2), top.y - height,  top.z + (width / 2),  1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
+     top.x,  top.y,  top.z,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+
+     //Bottom Face                                          //Negative Y Normal
+    top.x - (width / 2), top.y - height, top.z - (width / 2),  0.0f, -1.0f,  0.0f,  0.0f, 1.0f,
+     top.x + (width / 2), top.y - height, top.z - (width / 2),  0.0f, -1.0f,  0.0f,  1.0f, 1.0f,
+     top.x + (width / 2), top.y - height,  top.z + (width / 2),  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
+     top.x + (width / 2), top.y - height,  top.z + (width / 2),  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
+    top.x - (width / 2), top.y - height,  top.z + (width / 2),  0.0f, -1.0f,  0.0f,  0.0f, 0.0f,
+    top.x - (width / 2), top.y - height, top.z - (width / 2),  0.0f, -1.0f,  0.0f,  0.0f, 1.0f
+    };
+
+    vertices.assign(verts, verts + sizeof(verts) / sizeof(verts[0]));
+}
+
+
+void UPlaneVertices(Vec3 bl, Vec3 br, Vec3 fl, Vec3 fr, vector<float>& vertices)
+{
+    // Position and Vertex data
+    const float verts[] = {
+       //Coordinates       // Normals         //Texture Coords.
+       bl.x, bl.y, bl.z,  0.0f, -1.0f,  0.0f,  0.0f, 1.0f,    //Back Left
+       br.x, br.y, br.z,  0.0f, -1.0f,  0.0f,  1.0f, 1.0f,    //Back Right
+       fr.x, fr.y,  fr.z,  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,	 //Front Right
+       fr.x, fr.y,  fr.z,  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,	 //Front Right
+       fl.x, fl.y,  fl.z,  0.0f, -1.0f,  0.0f,  0.0f, 0.0f,	 //Front Left
+       bl.x, bl.y, bl.z,  0.0f, -1.0f,  0.0f,  0.0f, 1.0f	 //Back Left
+    };
+
+    vertices.assign(verts, verts + sizeof(verts) / sizeof(verts[0]));
+}
+
+
+// A fan of numSegments triangles in the XZ plane
+void UCircleVertices(float radius, Vec3 center, vector<float>& vertices)
+{
+    const int numSegments = 60;    // The number of triangles used to draw the circle
+
+    // Calculate the angle in radians between segments
+    float angleIncrement = (2.0f * PI) / static_cast<float>(numSegments);
+
+    for (int i = 0; i < numSegments; ++i)
+    {
+        // Calculate the current angle and the next angle (for the next segment)
+        float angle = static_cast<float>(i) * angleIncrement;
+        float nextAngle = static_cast<float>(i + 1) * angleIncrement;
+        float x = center.x + radius * cos(angle);
+        float z = center.z + radius * sin(angle);
+        float nextX = center.x + radius * cos(nextAngle);
+        float nextZ = center.z + radius * sin(nextAngle);
+
+        // Starting with the center of the circle
+        const float triangle[] = { center.x, center.y, center.z, x, center.y, z, nextX, center.y, nextZ };
+        vertices.insert(vertices.end(), triangle, triangle + 9);
+    }
+}
+
+
+// A bottom and a top fan joined by a band of quads; every segment is 4 triangles
+void UCylinderVertices(float radius, float height, Vec3 center, vector<float>& vertices)
+{
+    const int numSegments = 60;    // The number of triangles used to draw the circle
+
+    // Calculate the angle in radians between segments
+    float angleIncrement = (2.0f * PI) / static_cast<float>(numSegments);
+
+    for (int i = 0; i < numSegments; ++i)
+    {
+        // Calculate the current angle and the next angle (for the next segment)
+        float angle = static_cast<float>(i) * angleIncrement;
+        float nextAngle = static_cast<float>(i + 1) * angleIncrement;
+        float x = center.x + radius * cos(angle);
+        float z = center.z + radius * sin(angle);
+        float nextX = center.x + radius * cos(nextAngle);
+        float nextZ = center.z + radius * sin(nextAngle);
+        // Y value of top circle
+        float topY = center.y + height;
+
+        const float segment[] = {
+            // Bottom slice
+            center.x, center.y, center.z,  x, center.y, z,  nextX, center.y, nextZ,
+            // Top slice
+            center.x, topY, center.z,  x, topY, z,  nextX, topY, nextZ,
+            // Side Plane, starting with top two points, then bottom current point
+            x, topY, z,  nextX, topY, nextZ,  x, center.y, z,
+            // Bottom points, then next top point
+            nextX, center.y, nextZ,  x, center.y, z,  nextX, topY, nextZ
+        };
+        vertices.insert(vertices.end(), segment, segment + 36);
+    }
+}
+
+
+// Welds bit-identical vertices, appends the mesh to the vertex and index blobs and records its bounds
+void UAddMesh(SceneTables& tables, uint32_t layout, const vector<float>& vertices)
+{
+    const uint32_t floatsPerVertex = FloatsPerVertex(layout);
+    const size_t vertexBytes = floatsPerVertex * sizeof(float);
+
+    MeshRecord mesh = {};
+    mesh.layout = layout;
+    mesh.vertexOffset = tables.vertices.size() * sizeof(float);
+    mesh.indexOffset = tables.indices.size() * sizeof(uint32_t);
+
+    map<string, uint32_t> unique;
+    for (size_t i = 0; i + floatsPerVertex <= vertices.size(); i += floatsPerVertex)
+    {
+        string key(reinterpret_cast<const char*>(&vertices[i]), vertexBytes);
+        map<string, uint32_t>::const_iterator found = unique.find(key);
+        if (found != unique.end())
+        {
+            tables.indices.push_back(found->second);
+            continue;
+        }
+
+        unique[key] = mesh.vertexCount;
+        tables.indices.push_back(mesh.vertexCount++);
+        tables.vertices.insert(tables.vertices.end(), vertices.begin() + i, vertices.begin() + i + floatsPerVertex);
+    }
+    mesh.indexCount = (uint32_t)(tables.indices.size() - mesh.indexOffset / sizeof(uint32_t));
+
+    // Bounding sphere: the center of the bounding box and the farthest vertex from it
+    const float* first = &tables.vertices[mesh.vertexOffset / sizeof(float)];
+    float minCorner[3] = { first[0], first[1], first[2] };
+    float maxCorner[3] = { first[0], first[1], first[2] };
+    for (uint32_t v = 0; v < mesh.vertexCount; ++v)
+    {
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            minCorner[axis] = min(minCorner[axis], first[v * floatsPerVertex + axis]);
+            maxCorner[axis] = max(maxCorner[axis], first[v * floatsPerVertex + axis]);
+        }
+    }
+    for (int axis = 0; axis < 3; ++axis)
+        mesh.boundsCenter[axis] = (minCorner[axis] + maxCorner[axis]) * 0.5f;
+    for (uint32_t v = 0; v < mesh.vertexCount; ++v)
+    {
+        const float* position = first + v * floatsPerVertex;
+        float dx = position[0] - mesh.boundsCenter[0];
+        float dy = position[1] - mesh.boundsCenter[1];
+        float dz = position[2] - mesh.boundsCenter[2];
+        mesh.boundsRadius = max(mesh.boundsRadius, sqrt(dx * dx + dy * dy + dz * dz));
+    }
+
+    tables.meshes.push_back(mesh);
+}
+
+
+// Appends a chunk at the next aligned offset and records it in the table of contents
+void UAppendChunk(string& file, vector<ChunkEntry>& toc, uint32_t type, uint32_t count, const void* data, size_t size)
+{
+    file.resize(Align(file.size()), '\0');
+    toc.push_back({ type, count, file.size(), size });
+    file.append(static_cast<const char*>(data), size);
+}
+
+
+bool UWriteScene(const fs::path& output, const SceneTables& tables)
+{
+    const uint32_t chunkCount = 7;
+    string file(sizeof(Header) + chunkCount * sizeof(ChunkEntry), '\0');
+    vector<ChunkEntry> toc;
+
+    UAppendChunk(file, toc, CHUNK_STRINGS, (uint32_t)tables.strings.size(), tables.strings.data(), tables.strings.size());
+    UAppendChunk(file, toc, CHUNK_TEXTURES, (uint32_t)tables.textures.size(), tables.textures.data(), tables.textures.size() * sizeof(TextureRecord));
+    UAppendChunk(file, toc, CHUNK_MATERIALS, (uint32_t)tables.materials.size(), tables.materials.data(), tables.materials.size() * sizeof(MaterialRecord));
+    UAppendChunk(file, toc, CHUNK_MESHES, (uint32_t)tables.meshes.size(), tables.meshes.data(), tables.meshes.size() * sizeof(MeshRecord));
+    UAppendChunk(file, toc, CHUNK_NODES, (uint32_t)tables.nodes.size(), tables.nodes.data(), tables.nodes.size() * sizeof(NodeRecord));
+    UAppendChunk(file, toc, CHUNK_VERTICES, (uint32_t)(tables.vertices.size() * sizeof(float)), tables.vertices.data(), tables.vertices.size() * sizeof(float));
+    UAppendChunk(file, toc, CHUNK_INDICES, (uint32_t)(tables.indices.size() * sizeof(uint32_t)), tables.indices.data(), tables.indices.size() * sizeof(uint32_t));
+    file.resize(Align(file.size()), '\0');
+
+    Header header = { MAGIC, VERSION_MAJOR, VERSION_MINOR, chunkCount, 0, file.size() };
+    memcpy(&file[0], &header, sizeof(header));
+    memcpy(&file[sizeof(header)], toc.data(), toc.size() * sizeof(ChunkEntry));
+
+    // Check the result the way the program will read it
+    SceneView view;
+    string error;
+    if (!view.Open(file.data(), file.size(), error))
+    {
+        cout << gInputPath.string() << "(1): error: generated scene is invalid: " << error << endl;
+        return false;
+    }
+
+    // Leave the file untouched when nothing changed so its timestamp does not trigger rebuilds
+    string existing;
+    if (UReadFile(output, existing) && existing == file)
+        return true;
+
+    ofstream out(output, ios::binary | ios::trunc);
+    if (!out)
+    {
+        cout << output.string() << "(1): error: cannot write the scene file" << endl;
+        return false;
+    }
+    out.write(file.data(), file.size());
+    return true;
+}
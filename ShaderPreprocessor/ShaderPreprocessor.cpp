@@ -0,0 +1,449 @@
+/* Shader preprocessor
+ *
+ * Build step for OpenGLSample: resolves #include directives in the GLSL sources under
+ * OpenGLSample/shaders, validates every shader without needing a GPU, and writes the expanded
+ * sources into a header as string constants, so the program embeds them instead of reading files.
+ *
+ * Usage: ShaderPreprocessor <output header> <shader dir> [--check <file or dir>]... [--validator <exe>]
+ *
+ *   <shader dir>   stage files (.vert, .frag, .geom, .comp) are expanded and embedded.
+ *                  Files under include/ are only pulled in through #include.
+ *   --check        extra shaders to validate without embedding (shaders that are not embedded)
+ *   --validator    reference compiler used for the full parse, normally glslangValidator.
+ *                  When it cannot be started only the built-in checks run
+ *
+ * Each file is included at most once per shader, so shared blocks like the FrameData uniform
+ * block can be pulled in by several includes without being defined twice. #line directives
+ * keep driver error messages pointing at the original file and line.
+ */
+#include <iostream>         // cout, cerr
+#include <cstdlib>          // EXIT_FAILURE, system
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <set>
+#include <filesystem>
+#include <algorithm>        // sort
+#include <cctype>           // isalnum
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace
+{
+    // A shader after include expansion
+    struct ExpandedShader
+    {
+        fs::path path;
+        string stage;               // glslang stage name: vert, frag, geom, comp
+        string source;
+        vector<fs::path> files;     // source-string numbers used in the #line directives
+    };
+
+    int gErrorCount = 0;
+    int gWarningCount = 0;
+}
+
+void UError(const fs::path& file, int line, const string& message);
+void UWarning(const fs::path& file, int line, const string& message);
+string UStageFor(const fs::path& path);
+bool UReadFile(const fs::path& path, string& contents);
+bool UExpand(const fs::path& path, ExpandedShader& shader, set<fs::path>& included, vector<fs::path>& stack);
+void UCheckStructure(const ExpandedShader& shader);
+bool URunValidator(const string& validator, const ExpandedShader& shader);
+void UCollect(const fs::path& path, vector<fs::path>& shaders);
+bool UWriteHeader(const fs::path& output, const fs::path& shaderDir, const vector<ExpandedShader>& shaders);
+
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        cerr << "usage: " << argv[0] << " <output header> <shader dir> [--check <file or dir>]... [--validator <exe>]" << endl;
+        return EXIT_FAILURE;
+    }
+
+    fs::path output = argv[1];
+    fs::path shaderDir = argv[2];
+    vector<fs::path> checkOnly;
+    string validator;
+
+    for (int i = 3; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if (arg == "--check" && i + 1 < argc)
+            UCollect(argv[++i], checkOnly);
+        else if (arg == "--validator" && i + 1 < argc)
+            validator = argv[++i];
+        else
+        {
+            cerr << "ERROR: unknown argument " << arg << endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    vector<fs::path> embedded;
+    UCollect(shaderDir, embedded);
+
+    // Probe the validator once so a missing tool does not fail every shader
+    if (!validator.empty())
+    {
+#ifdef _WIN32
+        string probe = "\"" + validator + "\" --version > NUL 2>&1";
+#else
+        string probe = "\"" + validator + "\" --version > /dev/null 2>&1";
+#endif
+        if (system(probe.c_str()) != 0)
+        {
+            cout << "WARNING: " << validator << " not found, only the built-in checks will run" << endl;
+            validator.clear();
+        }
+    }
+
+    vector<ExpandedShader> shaders;
+    for (size_t i = 0; i < embedded.size() + checkOnly.size(); ++i)
+    {
+        bool embed = i < embedded.size();
+        const fs::path& path = embed ? embedded[i] : checkOnly[i - embedded.size()];
+
+        ExpandedShader shader;
+        shader.path = path;
+        shader.stage = UStageFor(path);
+
+        set<fs::path> included;
+        vector<fs::path> stack;
+        if (!UExpand(path, shader, included, stack))
+            continue;
+
+        UCheckStructure(shader);
+        if (!validator.empty())
+            URunValidator(validator, shader);
+
+        if (embed)
+            shaders.push_back(shader);
+    }
+
+    if (gErrorCount > 0)
+    {
+        cout << "ShaderPreprocessor: " << gErrorCount << " error(s), " << gWarningCount << " warning(s)" << endl;
+        return EXIT_FAILURE;
+    }
+
+    if (!UWriteHeader(output, shaderDir, shaders))
+        return EXIT_FAILURE;
+
+    cout << "ShaderPreprocessor: embedded " << shaders.size() << " shader(s), validated " << embedded.size() + checkOnly.size()
+        << (gWarningCount > 0 ? ", " + to_string(gWarningCount) + " warning(s)" : string()) << endl;
+    return 0;
+}
+
+
+// Errors and warnings use the "file(line): error:" form so Visual Studio lists them in the Error List
+void UError(const fs::path& file, int line, const string& message)
+{
+    cout << file.string() << "(" << line << "): error: " << message << endl;
+    ++gErrorCount;
+}
+
+
+void UWarning(const fs::path& file, int line, const string& message)
+{
+    cout << file.string() << "(" << line << "): warning: " << message << endl;
+    ++gWarningCount;
+}
+
+
+// Maps both the new (.vert/.frag) and the tutorial (.vs/.fs/.vertexshader) extensions to a stage
+string UStageFor(const fs::path& path)
+{
+    string ext = path.extension().string();
+    if (ext == ".vert" || ext == ".vs" || ext == ".vertexshader")
+        return "vert";
+    if (ext == ".frag" || ext == ".fs" || ext == ".fragmentshader")
+        return "frag";
+    if (ext == ".geom" || ext == ".gs")
+        return "geom";
+    if (ext == ".comp")
+        return "comp";
+    return "";
+}
+
+
+bool UReadFile(const fs::path& path, string& contents)
+{
+    ifstream in(path, ios::binary);
+    if (!in)
+        return false;
+
+    stringstream stream;
+    stream << in.rdbuf();
+    contents = stream.str();
+
+    // Normalize line endings so the embedded strings are identical on every platform
+    string normalized;
+    normalized.reserve(contents.size());
+    for (char c : contents)
+    {
+        if (c != '\r')
+            normalized += c;
+    }
+    contents = normalized;
+    return true;
+}
+
+
+// Appends path to the shader, replacing every #include "file" with the file's expanded contents.
+// Includes resolve relative to the including file, then to the directory of the top-level shader
+bool UExpand(const fs::path& path, ExpandedShader& shader, set<fs::path>& included, vector<fs::path>& stack)
+{
+    fs::path canonical = fs::weakly_canonical(path);
+    for (const fs::path& open : stack)
+    {
+        if (open == canonical)
+        {
+            UError(stack.back(), 1, "include cycle through " + path.string());
+            return false;
+        }
+    }
+    // Already pulled in by another include: shared blocks are emitted only once
+    if (!included.insert(canonical).second)
+        return true;
+
+    string contents;
+    if (!UReadFile(path, contents))
+    {
+        UError(stack.empty() ? path : stack.back(), 1, "cannot read " + path.string());
+        return false;
+    }
+
+    int fileIndex = (int)shader.files.size();
+    shader.files.push_back(path);
+    stack.push_back(canonical);
+
+    istringstream lines(contents);
+    string line;
+    int lineNumber = 0;
+    bool ok = true;
+    while (getline(lines, line))
+    {
+        ++lineNumber;
+
+        size_t first = line.find_first_not_of(" \t");
+        bool isDirective = first != string::npos && line[first] == '#';
+        string directive = isDirective ? line.substr(first + 1) : "";
+        directive.erase(0, directive.find_first_not_of(" \t"));
+
+        if (isDirective && directive.compare(0, 7, "version") == 0)
+        {
+            if (stack.size() > 1)
+            {
+                UError(path, lineNumber, "#version is only allowed in the top-level shader");
+                ok = false;
+                continue;
+            }
+            // #version stays the first line, numbering restarts after it. ShaderVariants inserts
+            // its defines right after this line, so they land before the #line directive
+            shader.source += line + "\n";
+            shader.source += "#line " + to_string(lineNumber + 1) + " " + to_string(fileIndex) + "\n";
+            continue;
+        }
+
+        if (isDirective && directive.compare(0, 7, "include") == 0)
+        {
+            size_t open = directive.find('"');
+            size_t close = open == string::npos ? string::npos : directive.find('"', open + 1);
+            if (close == string::npos)
+            {
+                UError(path, lineNumber, "malformed #include, expected #include \"file\"");
+                ok = false;
+                continue;
+            }
+
+            string name = directive.substr(open + 1, close - open - 1);
+            fs::path target = path.parent_path() / name;
+            if (!fs::exists(target))
+                target = shader.path.parent_path() / name;
+            if (!fs::exists(target))
+            {
+                UError(path, lineNumber, "cannot find include \"" + name + "\"");
+                ok = false;
+                continue;
+            }
+
+            int includeIndex = (int)shader.files.size();
+            if (included.count(fs::weakly_canonical(target)) == 0)
+                shader.source += "#line 1 " + to_string(includeIndex) + "\n";
+            ok = UExpand(target, shader, included, stack) && ok;
+            shader.source += "#line " + to_string(lineNumber + 1) + " " + to_string(fileIndex) + "\n";
+            continue;
+        }
+
+        shader.source += line + "\n";
+    }
+
+    stack.pop_back();
+    return ok;
+}
+
+
+// Checks that do not need a GLSL front end: #version first, balanced brackets, an entry point,
+// plus warnings for patterns that are known to be slow
+void UCheckStructure(const ExpandedShader& shader)
+{
+    const string& src = shader.source;
+
+    if (src.compare(0, 8, "#version") != 0)
+        UError(shader.path, 1, "the first line must be a #version directive");
+
+    if (shader.stage.empty())
+        UWarning(shader.path, 1, "unknown shader stage, only structural checks were run");
+
+    // Strip comments so brackets inside them do not count
+    string code;
+    code.reserve(src.size());
+    for (size_t i = 0; i < src.size(); ++i)
+    {
+        if (src.compare(i, 2, "//") == 0)
+        {
+            while (i < src.size() && src[i] != '\n')
+                ++i;
+        }
+        else if (src.compare(i, 2, "/*") == 0)
+        {
+            size_t end = src.find("*/", i + 2);
+            if (end == string::npos)
+            {
+                UError(shader.path, 1, "unterminated block comment");
+                return;
+            }
+            i = end + 1;
+            continue;
+        }
+        if (i < src.size())
+            code += src[i];
+    }
+
+    int depth[3] = { 0, 0, 0 };
+    const char* opening = "({[";
+    const char* closing = ")}]";
+    for (char c : code)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            if (c == opening[k])
+                ++depth[k];
+            else if (c == closing[k] && --depth[k] < 0)
+            {
+                UError(shader.path, 1, string("unmatched '") + closing[k] + "'");
+                return;
+            }
+        }
+    }
+    for (int k = 0; k < 3; ++k)
+    {
+        if (depth[k] != 0)
+            UError(shader.path, 1, string("unclosed '") + opening[k] + "'");
+    }
+
+    if (code.find("void main") == string::npos)
+        UError(shader.path, 1, "no main() entry point");
+
+    // Per-vertex matrix inversion is a full 4x4 inverse for every vertex; do it on the CPU instead
+    if (shader.stage == "vert" && code.find("inverse(") != string::npos)
+        UWarning(shader.path, 1, "inverse() in a vertex shader runs once per vertex, precompute it per object");
+}
+
+
+// Runs the reference compiler on the expanded source. It checks the full grammar and semantics
+// entirely on the CPU, so this works on build machines without a GPU
+bool URunValidator(const string& validator, const ExpandedShader& shader)
+{
+    if (shader.stage.empty())
+        return true;
+
+    fs::path tempDir = fs::temp_directory_path() / "ShaderPreprocessor";
+    error_code ec;
+    fs::create_directories(tempDir, ec);
+    fs::path expanded = tempDir / (shader.path.stem().string() + "." + shader.stage);
+    {
+        ofstream out(expanded, ios::binary | ios::trunc);
+        out << shader.source;
+    }
+
+    string command = "\"" + validator + "\" -S " + shader.stage + " \"" + expanded.string() + "\"";
+#ifdef _WIN32
+    command = "\"" + command + "\""; // cmd.exe strips the outer quotes
+#endif
+    if (system(command.c_str()) != 0)
+    {
+        string files;
+        for (size_t i = 0; i < shader.files.size(); ++i)
+            files += " " + to_string(i) + "=" + shader.files[i].filename().string();
+        UError(shader.path, 1, "rejected by " + validator + " (source-string numbers:" + files + ")");
+        return false;
+    }
+    return true;
+}
+
+
+// Adds a single shader file, or every stage file in a directory (include/ is skipped)
+void UCollect(const fs::path& path, vector<fs::path>& shaders)
+{
+    if (!fs::is_directory(path))
+    {
+        shaders.push_back(path);
+        return;
+    }
+
+    vector<fs::path> found;
+    for (const fs::directory_entry& entry : fs::directory_iterator(path))
+    {
+        if (entry.is_regular_file() && !UStageFor(entry.path()).empty())
+            found.push_back(entry.path());
+    }
+    // directory order is unspecified; sort so the generated header is stable
+    sort(found.begin(), found.end());
+    shaders.insert(shaders.end(), found.begin(), found.end());
+}
+
+
+// Writes each expanded shader as a raw string constant named after its file (cube.frag -> cube_frag).
+// Long sources are split into several literals, since MSVC limits the length of a single one
+bool UWriteHeader(const fs::path& output, const fs::path& shaderDir, const vector<ExpandedShader>& shaders)
+{
+    const size_t maxChunk = 8000;
+
+    string header;
+    header += "// Generated by ShaderPreprocessor from " + shaderDir.filename().string() + "/ - do not edit, edit the .vert/.frag files instead\n";
+    header += "#ifndef EMBEDDED_SHADERS_H\n#define EMBEDDED_SHADERS_H\n\nnamespace EmbeddedShaders\n{\n";
+    for (const ExpandedShader& shader : shaders)
+    {
+        string name = shader.path.filename().string();
+        for (char& c : name)
+        {
+            if (!isalnum((unsigned char)c))
+                c = '_';
+        }
+
+        header += "    const char* const " + name + " =\n";
+        for (size_t offset = 0; offset < shader.source.size(); offset += maxChunk)
+            header += "R\"glsl(" + shader.source.substr(offset, maxChunk) + ")glsl\"\n";
+        header += "    ;\n\n";
+    }
+    header += "}\n#endif\n";
+
+    // Leave the header untouched when nothing changed so dependent files are not rebuilt
+    string existing;
+    if (UReadFile(output, existing) && existing == header)
+        return true;
+
+    ofstream out(output, ios::binary | ios::trunc);
+    if (!out)
+    {
+        cout << output.string() << "(1): error: cannot write the generated header" << endl;
+        return false;
+    }
+    out << header;
+    return true;
+}